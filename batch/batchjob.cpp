@@ -0,0 +1,564 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * batchjob.cpp is part of 3D Meta-Object-based Modelling System             *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <time.h>
+
+#include <QByteArray>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QList>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#include <QDebug>
+
+#include "batchjob.h"
+#include "documentfile.h"
+#include "field.h"
+#include "grid.h"
+#include "kernelpool.h"
+#include "meshexport.h"
+
+const char *const kBatchStageNames[] =
+{
+    "Loading",
+    "Evaluation",
+    "Poligonization",
+    "Export"
+};
+
+namespace Timing
+{
+    double secondsPassed()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return 0.000000001 * ts.tv_nsec + ts.tv_sec;
+    }
+}
+
+namespace Boxes
+{
+    inline bool isEmpty(const GridBox &box)
+    {
+        return box.xMin > box.xMax || box.yMin > box.yMax ||
+                    box.zMin > box.zMax;
+    }
+
+    // Returns box which holds both of boxes.
+    GridBox united(const GridBox &box, const GridBox &otherBox)
+    {
+        if (isEmpty(box))
+        {
+            return otherBox;
+        }
+        if (isEmpty(otherBox))
+        {
+            return box;
+        }
+        GridBox result = {
+            qMin(box.xMin, otherBox.xMin), qMax(box.xMax, otherBox.xMax),
+            qMin(box.yMin, otherBox.yMin), qMax(box.yMax, otherBox.yMax),
+            qMin(box.zMin, otherBox.zMin), qMax(box.zMax, otherBox.zMax) };
+        return result;
+    }
+}
+
+namespace Jobs
+{
+    void run(BatchJob &job)
+    {
+        job.run();
+    }
+}
+
+namespace Export
+{
+    // Returns 0 if file suffix is not one of supported mesh formats.
+    MeshExport::Writer writerForFile(const QString &fileName)
+    {
+        QString suffix = QFileInfo(fileName).suffix().toLower();
+        if (suffix == "obj")
+        {
+            return MeshExport::writeWavefront;
+        }
+        if (suffix == "ply")
+        {
+            return MeshExport::writePly;
+        }
+        if (suffix == "stl")
+        {
+            return MeshExport::writeStl;
+        }
+        return 0;
+    }
+}
+
+BatchJob::BatchJob(const QString &inputFileName,
+            const QString &outputFileName) : fInputFileName(inputFileName),
+            fOutputFileName(outputFileName), fXDim(kDim), fYDim(kDim),
+            fZDim(kDim), fIsoLevel(2.0), fViewIsoLevel(8),
+            fViewIsoLevelMultiplier(0.25), fGridFitted(false),
+            fNormalMode(FLAT), fExtractionMode(MARCHING_CUBES),
+            fOctreeDepth(7), fGridKind(DENSE_GRID), fGridDimSet(false),
+            fIsoLevelSet(false), fNormalModeSet(false),
+            fExtractionModeSet(false), fOctreeDepthSet(false),
+            fGridKindSet(false), fSweepFirstValue(0.0),
+            fSweepLastValue(0.0), fSweepStepCount(1), fKernelPool(0),
+            fTriangleCount(0), fSucceeded(false)
+{
+    for (int i = 0; i < BATCH_STAGE_COUNT; i++)
+    {
+        fStageSeconds[i] = 0.0;
+    }
+}
+
+void BatchJob::setGridSidesDimention(unsigned int gridDim)
+{
+    fXDim = gridDim;
+    fYDim = gridDim;
+    fZDim = gridDim;
+    fGridDimSet = true;
+}
+
+void BatchJob::setIsoLevel(float isoLevel)
+{
+    fIsoLevel = isoLevel;
+    fIsoLevelSet = true;
+}
+
+void BatchJob::setNormalMode(NormalMode normalMode)
+{
+    fNormalMode = normalMode;
+    fNormalModeSet = true;
+}
+
+void BatchJob::setExtractionMode(ExtractionMode extractionMode)
+{
+    fExtractionMode = extractionMode;
+    fExtractionModeSet = true;
+}
+
+void BatchJob::setOctreeDepth(unsigned int octreeDepth)
+{
+    fOctreeDepth = octreeDepth;
+    fOctreeDepthSet = true;
+}
+
+void BatchJob::setGridKind(GridKind gridKind)
+{
+    fGridKind = gridKind;
+    fGridKindSet = true;
+}
+
+void BatchJob::setSweep(const QString &variableName, double firstValue,
+            double lastValue, int stepCount)
+{
+    fSweepVariableName = variableName;
+    fSweepFirstValue = firstValue;
+    fSweepLastValue = lastValue;
+    fSweepStepCount = stepCount;
+}
+
+bool BatchJob::run()
+{
+    fSucceeded = false;
+    if (!Export::writerForFile(fOutputFileName))
+    {
+        qWarning() << "Unknown mesh format of" << fOutputFileName;
+        return false;
+    }
+
+    double seconds = Timing::secondsPassed();
+
+    QByteArray fieldXMLData;
+    DocumentFile document;
+    if (!readDocument(&fieldXMLData, &document))
+    {
+        qWarning() << "Can not open document" << fInputFileName;
+        return false;
+    }
+    // embedded grids are evaluated with document values of variables
+    const DocumentFile *documentPtr = (document.fileName().isEmpty() ||
+                !fSweepVariableName.isEmpty()) ? 0 : &document;
+
+    double now = Timing::secondsPassed();
+    fStageSeconds[LOADING_STAGE] = now - seconds;
+    seconds = now;
+
+    // fitting needs coarse field first, it is refined afterwards. Octree
+    // samples the field itself, so its grid is kept coarse then
+    bool octreeUsed = (fExtractionMode == DUAL_MARCHING_CUBES);
+    QBuffer fieldXMLBuffer(&fieldXMLData);
+    Field field(fXDim, fYDim, fZDim, &fieldXMLBuffer,
+                fGridFitted || octreeUsed, FieldCache(), documentPtr,
+                fGridKind, fKernelPool);
+    field.setSparseBand(fIsoLevel);
+    if (fGridFitted && !field.grid()->data()->hasExplicitBounds())
+    {
+        field.fitGridBounds(fIsoLevel);
+    }
+    while (!octreeUsed && field.refine())
+    {
+    }
+
+    QList<QSharedPointer<MetaObject> > sweptMetaObjects;
+    QList<QSharedPointer<MetaObject> > metaObjects(field.metaObjects());
+    for (int i = 0; i < metaObjects.count(); i++)
+    {
+        if (!fSweepVariableName.isEmpty() && metaObjects[i]->
+                    variablesManager().containsVariable(fSweepVariableName))
+        {
+            sweptMetaObjects.append(metaObjects[i]);
+        }
+    }
+    if (!fSweepVariableName.isEmpty() && sweptMetaObjects.isEmpty())
+    {
+        qWarning() << "No meta-object of" << fInputFileName <<
+                    "has variable" << fSweepVariableName;
+        return false;
+    }
+
+    now = Timing::secondsPassed();
+    fStageSeconds[EVALUATION_STAGE] = now - seconds;
+    seconds = now;
+
+    Poligonizator poligonizator(&field, fIsoLevel, fNormalMode,
+                fExtractionMode, fOctreeDepth);
+
+    now = Timing::secondsPassed();
+    fStageSeconds[POLIGONIZATION_STAGE] = now - seconds;
+    seconds = now;
+
+    int stepCount = fSweepVariableName.isEmpty() ? 1 : fSweepStepCount;
+    for (int step = 0; step < stepCount; step++)
+    {
+        if (step > 0)
+        {
+            // only swept meta-objects are reevaluated, and only blocks
+            // where field has changed are poligonized again
+            GridBox changedCellsBox = { 0, -1, 0, -1, 0, -1 };
+            for (int i = 0; i < sweptMetaObjects.count(); i++)
+            {
+                sweptMetaObjects[i]->variablesManager().setVariableValue(
+                            fSweepVariableName, sweepValue(step));
+                changedCellsBox = Boxes::united(changedCellsBox,
+                            field.updateMetaObject(sweptMetaObjects[i]));
+            }
+
+            now = Timing::secondsPassed();
+            fStageSeconds[EVALUATION_STAGE] += now - seconds;
+            seconds = now;
+
+            poligonizator.recalculateTriangles(changedCellsBox);
+
+            now = Timing::secondsPassed();
+            fStageSeconds[POLIGONIZATION_STAGE] += now - seconds;
+            seconds = now;
+        }
+
+        QSharedPointer<const QVector<TriangleN> > trianglesPtr(
+                    poligonizator.trianglesPtr());
+        fTriangleCount = trianglesPtr->count();
+        QString fileName = fSweepVariableName.isEmpty() ? fOutputFileName :
+                    outputFileName(fOutputFileName, QString::number(step));
+        if (!exportTriangles(*trianglesPtr, fileName))
+        {
+            qWarning() << "Can not export surface to" << fileName;
+            return false;
+        }
+
+        now = Timing::secondsPassed();
+        fStageSeconds[EXPORT_STAGE] += now - seconds;
+        seconds = now;
+    }
+
+    fSucceeded = true;
+    return true;
+}
+
+bool BatchJob::runConcurrently(QList<BatchJob> *jobs)
+{
+    // documents of a family differ by variable values mostly, so their
+    // expressions are parsed once for all jobs
+    KernelPool kernels;
+    int i;
+    for (i = 0; i < jobs->count(); i++)
+    {
+        (*jobs)[i].setKernelPool(&kernels);
+    }
+
+    if (jobs->count() < 2 ||
+                QThreadPool::globalInstance()->maxThreadCount() < 2)
+    {
+        for (i = 0; i < jobs->count(); i++)
+        {
+            Jobs::run((*jobs)[i]);
+        }
+    }
+    else
+    {
+        QtConcurrent::blockingMap(*jobs, Jobs::run);
+    }
+
+    bool result = true;
+    for (i = 0; i < jobs->count(); i++)
+    {
+        result = result && jobs->at(i).succeeded();
+        (*jobs)[i].setKernelPool(0);
+    }
+    return result;
+}
+
+QString BatchJob::outputFileName(const QString &fileName, const QString &tag)
+{
+    QFileInfo fileInfo(fileName);
+    QString suffix = fileInfo.suffix();
+    if (suffix.isEmpty())
+    {
+        return fileName + "-" + tag;
+    }
+    return fileName.left(fileName.length() - suffix.length() - 1) + "-" +
+                tag + "." + suffix;
+}
+
+QString BatchJob::timingReport() const
+{
+    QString report;
+    if (!fSweepVariableName.isEmpty())
+    {
+        report += QString("Sweep of %1 from %2 to %3 in %4 steps\n")
+                    .arg(fSweepVariableName).arg(fSweepFirstValue)
+                    .arg(fSweepLastValue).arg(fSweepStepCount);
+    }
+    double totalSeconds = 0.0;
+    for (int i = 0; i < BATCH_STAGE_COUNT; i++)
+    {
+        report += QString("%1: %2 s\n").arg(kBatchStageNames[i])
+                    .arg(fStageSeconds[i], 0, 'f', 3);
+        totalSeconds += fStageSeconds[i];
+    }
+    report += QString("Total: %1 s, %2 triangles\n")
+                .arg(totalSeconds, 0, 'f', 3).arg(fTriangleCount);
+    return report;
+}
+
+bool BatchJob::readDocument(QByteArray *fieldXMLData, DocumentFile *document)
+{
+    if (fInputFileName.endsWith(".mob"))
+    {
+        if (!document->open(fInputFileName))
+        {
+            return false;
+        }
+        QByteArray viewXMLData(document->section(VIEW_SECTION));
+        QBuffer viewXMLBuffer(&viewXMLData);
+        readXMLDocument(&viewXMLBuffer, fieldXMLData);
+
+        QByteArray documentFieldXMLData(document->section(FIELD_SECTION));
+        QBuffer documentFieldXMLBuffer(&documentFieldXMLData);
+        readXMLDocument(&documentFieldXMLBuffer, fieldXMLData);
+    }
+    else
+    {
+        QFile file(fInputFileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+        readXMLDocument(&file, fieldXMLData);
+        file.close();
+    }
+
+    if (!fIsoLevelSet)
+    {
+        fIsoLevel = fViewIsoLevel * fViewIsoLevelMultiplier;
+    }
+    return true;
+}
+
+bool BatchJob::exportTriangles(const QVector<TriangleN> &triangles,
+            const QString &fileName)
+{
+    QFile file(fileName);
+    bool result = file.open(QIODevice::WriteOnly) &&
+                Export::writerForFile(fileName)(triangles, &file);
+    file.close();
+    return result;
+}
+
+double BatchJob::sweepValue(int step) const
+{
+    if (fSweepStepCount < 2)
+    {
+        return fSweepFirstValue;
+    }
+    return fSweepFirstValue + (fSweepLastValue - fSweepFirstValue) * step /
+                (fSweepStepCount - 1);
+}
+
+void BatchJob::readXMLDocument(QIODevice *xmlData, QByteArray *fieldXMLData)
+{
+    QBuffer fieldXMLBuffer(fieldXMLData);
+    fieldXMLBuffer.open(QIODevice::WriteOnly);
+    QXmlStreamWriter writer(&fieldXMLBuffer);
+
+    // field element is copied token by token, so document is read in one
+    // pass
+    xmlData->open(QIODevice::ReadOnly);
+    QXmlStreamReader reader(xmlData);
+    int fieldDepth = 0;
+    bool inView = false;
+    while (!reader.atEnd())
+    {
+        reader.readNext();
+        if (fieldDepth == 0 && reader.isStartElement())
+        {
+            if (reader.name() == QLatin1String("field"))
+            {
+                fieldDepth = 1;
+                writer.writeCurrentToken(reader);
+            }
+            else if (reader.name() == QLatin1String("view"))
+            {
+                inView = true;
+            }
+            else if (inView)
+            {
+                readViewElement(reader.name().toString(),
+                            reader.attributes());
+            }
+            continue;
+        }
+        if (fieldDepth == 0)
+        {
+            if (reader.isEndElement() &&
+                        reader.name() == QLatin1String("view"))
+            {
+                inView = false;
+            }
+            continue;
+        }
+
+        if (reader.isStartElement() && !fSweepVariableName.isEmpty() &&
+                    reader.name() == QLatin1String("var") &&
+                    reader.attributes().value("name") == fSweepVariableName)
+        {
+            writer.writeStartElement(reader.qualifiedName().toString());
+            QXmlStreamAttributes attributes(reader.attributes());
+            for (int i = 0; i < attributes.count(); i++)
+            {
+                if (attributes[i].name() == QLatin1String("value"))
+                {
+                    writer.writeAttribute("value",
+                                QString::number(fSweepFirstValue, 'g', 17));
+                }
+                else
+                {
+                    writer.writeAttribute(attributes[i]);
+                }
+            }
+        }
+        else
+        {
+            writer.writeCurrentToken(reader);
+        }
+        if (reader.isStartElement())
+        {
+            fieldDepth++;
+        }
+        else if (reader.isEndElement())
+        {
+            fieldDepth--;
+        }
+    }
+    if (reader.hasError())
+    {
+        qWarning() << "Document XML error at line" << reader.lineNumber() <<
+                    ":" << reader.errorString();
+    }
+    xmlData->close();
+    fieldXMLBuffer.close();
+}
+
+void BatchJob::readViewElement(const QString &name,
+            const QXmlStreamAttributes &attributes)
+{
+    if (name == "grid")
+    {
+        if (!fGridDimSet && attributes.hasAttribute("dimX"))
+        {
+            fXDim = attributes.value("dimX").toString().toUInt();
+            fYDim = attributes.value("dimY").toString().toUInt();
+            fZDim = attributes.value("dimZ").toString().toUInt();
+        }
+        if (attributes.hasAttribute("iso"))
+        {
+            fViewIsoLevel = attributes.value("iso").toString().toInt();
+        }
+        if (attributes.hasAttribute("isoMult"))
+        {
+            fViewIsoLevelMultiplier =
+                        attributes.value("isoMult").toString().toFloat();
+        }
+        if (attributes.hasAttribute("fit"))
+        {
+            fGridFitted = attributes.value("fit") == QLatin1String("true");
+        }
+        if (!fGridKindSet && attributes.hasAttribute("kind"))
+        {
+            fGridKind = (attributes.value("kind") ==
+                        QLatin1String("sparse")) ? SPARSE_GRID : DENSE_GRID;
+        }
+    }
+    else if (name == "display")
+    {
+        QStringRef normalMode = attributes.value("normalMode");
+        if (!fNormalModeSet && !normalMode.isEmpty())
+        {
+            fNormalMode = (normalMode == QLatin1String("smooth")) ? SMOOTH :
+                        (normalMode == QLatin1String("gradient")) ?
+                        GRADIENT : FLAT;
+        }
+        QStringRef extractionMode = attributes.value("extractionMode");
+        if (!fExtractionModeSet && !extractionMode.isEmpty())
+        {
+            fExtractionMode = (extractionMode == QLatin1String("nets")) ?
+                        SURFACE_NETS :
+                        (extractionMode == QLatin1String("tetrahedrons")) ?
+                        MARCHING_TETRAHEDRONS :
+                        (extractionMode == QLatin1String("octree")) ?
+                        DUAL_MARCHING_CUBES : MARCHING_CUBES;
+        }
+        QStringRef octreeDepth = attributes.value("octreeDepth");
+        if (!fOctreeDepthSet && !octreeDepth.isEmpty())
+        {
+            unsigned int depth = octreeDepth.toString().toUInt();
+            if (depth > 0)
+            {
+                fOctreeDepth = depth;
+            }
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * batchjob.h is part of 3D Meta-Object-based Modelling System               *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BATCHJOB_H
+#define BATCHJOB_H
+
+#include <QString>
+#include <QList>
+
+#include "poligonizator.h"
+#include "fieldobject.h"
+
+class QByteArray;
+class QIODevice;
+class QXmlStreamAttributes;
+class DocumentFile;
+class KernelPool;
+
+typedef enum
+{
+    LOADING_STAGE = 0, // reading of document file.
+    EVALUATION_STAGE, // parsing and evaluation of meta-objects.
+    POLIGONIZATION_STAGE,
+    EXPORT_STAGE,
+    BATCH_STAGE_COUNT
+} BatchStage;
+
+// Represents headless processing of one document: its field is evaluated at
+// full resolution, poligonized and surface is exported to a mesh file, which
+// format is chosen by file suffix (obj, ply or stl). Both XML and binary
+// documents are read. Settings which are not set explicitly are taken from
+// document view, like it is done when document is opened in main window.
+// Document may be swept over values of a variable: it is loaded once and
+// only meta-objects which have the variable are reevaluated between steps,
+// so compiled expressions, grids and poligonizator blocks are reused.
+class BatchJob
+{
+public:
+    BatchJob(const QString &inputFileName, const QString &outputFileName);
+
+    void setGridSidesDimention(unsigned int gridDim);
+    void setIsoLevel(float isoLevel);
+    void setNormalMode(NormalMode normalMode);
+    void setExtractionMode(ExtractionMode extractionMode);
+    // Depth of octree of dual marching cubes.
+    void setOctreeDepth(unsigned int octreeDepth);
+    // Sparse grid field is poligonized at the set iso level only.
+    void setGridKind(GridKind gridKind);
+    // Mesh of every step is exported to output file name with step number
+    // appended (see outputFileName()), first and last values are included.
+    void setSweep(const QString &variableName, double firstValue,
+                double lastValue, int stepCount);
+    // Jobs of one pool parse every distinct expression once, pool is not
+    // owned by the job.
+    void setKernelPool(KernelPool *kernels) { fKernelPool = kernels; }
+
+    // Returns false if document can not be read or mesh can not be written.
+    bool run();
+    inline bool succeeded() const { return fSucceeded; }
+    // Jobs are run concurrently in global thread pool, which is shared with
+    // evaluation inside of the jobs, and share one kernel pool. Returns
+    // false if any job failed.
+    static bool runConcurrently(QList<BatchJob> *jobs);
+
+    // Returns file name with "-tag" inserted before its suffix.
+    static QString outputFileName(const QString &fileName,
+                const QString &tag);
+
+    inline double stageSeconds(BatchStage stage) const
+                { return fStageSeconds[stage]; }
+    inline int triangleCount() const { return fTriangleCount; }
+    // One line per stage and total one, sweep goes first.
+    QString timingReport() const;
+
+protected:
+    // Binary document is opened if it is one.
+    bool readDocument(QByteArray *fieldXMLData, DocumentFile *document);
+    bool exportTriangles(const QVector<TriangleN> &triangles,
+                const QString &fileName);
+    double sweepValue(int step) const;
+    // Reads view settings and copies field element of XML document.
+    // Swept variable gets its first value in the copy.
+    void readXMLDocument(QIODevice *xmlData, QByteArray *fieldXMLData);
+    void readViewElement(const QString &name,
+                const QXmlStreamAttributes &attributes);
+
+private:
+    QString fInputFileName;
+    QString fOutputFileName;
+
+    unsigned int fXDim;
+    unsigned int fYDim;
+    unsigned int fZDim;
+    float fIsoLevel;
+    // view keeps iso level as slider value and its multiplier
+    int fViewIsoLevel;
+    float fViewIsoLevelMultiplier;
+    bool fGridFitted;
+    NormalMode fNormalMode;
+    ExtractionMode fExtractionMode;
+    unsigned int fOctreeDepth;
+    GridKind fGridKind;
+
+    // settings set explicitly are not changed by document view
+    bool fGridDimSet;
+    bool fIsoLevelSet;
+    bool fNormalModeSet;
+    bool fExtractionModeSet;
+    bool fOctreeDepthSet;
+    bool fGridKindSet;
+
+    QString fSweepVariableName; // empty if document is not swept.
+    double fSweepFirstValue;
+    double fSweepLastValue;
+    int fSweepStepCount;
+
+    KernelPool *fKernelPool;
+
+    double fStageSeconds[BATCH_STAGE_COUNT];
+    int fTriangleCount; // of the last step.
+    bool fSucceeded;
+};
+
+#endif // BATCHJOB_H
@@ -4,18 +4,31 @@
 
 TEMPLATE = app
 TARGET = 
-DEPENDPATH += . field grid infix poligonization postfix widgets
-INCLUDEPATH += . widgets grid field postfix infix poligonization icons
+DEPENDPATH += . batch field grid infix poligonization postfix widgets
+INCLUDEPATH += . batch widgets grid field postfix infix poligonization icons
 
 # Input
-HEADERS += field/field.h \
+HEADERS += batch/batchjob.h \
+           field/documentfile.h \
+           field/documentjournal.h \
+           field/field.h \
+           field/fieldcache.h \
            field/fieldobject.h \
+           field/kernelpool.h \
            field/metaobject.h \
+           field/scenegenerator.h \
+           field/transforms.h \
            grid/grid.h \
+           grid/gridkernels.h \
+           grid/gridstorage.h \
+           grid/octree.h \
            grid/space_types.h \
+           grid/sparsegrid.h \
            infix/infixlex_types.h \
+           poligonization/classification.h \
            poligonization/gridcell.h \
            poligonization/marchingcubes_tables.h \
+           poligonization/meshexport.h \
            poligonization/normalization.h \
            poligonization/poligonizator.h \
            postfix/postfixexpr.h \
@@ -31,11 +44,24 @@ FORMS += widgets/mainwindow.ui \
          widgets/viewcontroller.ui
 #YACCSOURCES += infix/infixlex.y
 SOURCES += main.cpp \
+           batch/batchjob.cpp \
+           field/documentfile.cpp \
+           field/documentjournal.cpp \
            field/field.cpp \
+           field/fieldcache.cpp \
            field/fieldobject.cpp \
+           field/kernelpool.cpp \
            field/metaobject.cpp \
+           field/scenegenerator.cpp \
+           field/transforms.cpp \
            grid/grid.cpp \
+           grid/gridkernels.cpp \
+           grid/gridstorage.cpp \
+           grid/octree.cpp \
+           grid/sparsegrid.cpp \
+           poligonization/classification.cpp \
            poligonization/gridcell.cpp \
+           poligonization/meshexport.cpp \
            poligonization/normalization.cpp \
            poligonization/poligonizator.cpp \
            postfix/postfixexpr.cpp \
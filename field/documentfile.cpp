@@ -0,0 +1,294 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * documentfile.cpp is part of 3D Meta-Object-based Modelling System         *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <string.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QVector>
+
+#include "documentfile.h"
+#include "fieldobject.h"
+#include "grid.h"
+
+namespace DocumentFormat
+{
+    const char kMagic[8] = { 'D', 'I', 'P', '2', 'D', 'O', 'C', 'S' };
+    const unsigned int kVersion = 1;
+    const qint64 kSectionAlignment = 4096; // page size or a multiple of it.
+
+    typedef struct
+    {
+        char magic[8];
+        unsigned int version;
+        unsigned int sectionCount;
+    } Header; // section table follows the header.
+
+    typedef struct
+    {
+        unsigned int type;
+        unsigned int compression;
+        qint64 offset;
+        qint64 size;
+        qint64 rawSize;
+    } SectionEntry;
+
+    inline qint64 alignedOffset(qint64 offset)
+    {
+        return (offset + kSectionAlignment - 1) / kSectionAlignment *
+                    kSectionAlignment;
+    }
+}
+
+using namespace DocumentFormat;
+
+DocumentFile::DocumentFile()
+{
+}
+
+void DocumentFile::addSection(DocumentSectionType type,
+            const QByteArray &data, DocumentCompression compression)
+{
+    Section section;
+    section.type = type;
+    section.compression = compression;
+    section.offset = 0;
+    section.rawSize = data.size();
+    section.data = (compression == ZLIB_COMPRESSION) ? qCompress(data) :
+                data;
+    section.size = section.data.size();
+    section.grid = 0;
+    fSections.append(section);
+}
+
+void DocumentFile::addGridSection(const Grid *grid)
+{
+    Section section;
+    section.type = GRID_SECTION;
+    section.compression = NO_COMPRESSION;
+    section.offset = 0;
+    section.size = 0;
+    section.rawSize = 0;
+    section.grid = grid;
+    fSections.append(section);
+}
+
+bool DocumentFile::save(const QString &fileName)
+{
+    QString partFileName(fileName + ".part");
+    QFile file(partFileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "DocumentFile: can not write" << partFileName;
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.sectionCount = fSections.count();
+
+    // sizes of grid sections are known when they are written, so section
+    // table is written after sections
+    QVector<SectionEntry> entries(fSections.count());
+    qint64 offset = sizeof(header) + entries.count() * sizeof(SectionEntry);
+    bool result = true;
+    for (int i = 0; result && i < fSections.count(); i++)
+    {
+        Section &section = fSections[i];
+        section.offset = alignedOffset(offset);
+        result = file.seek(section.offset);
+        if (result && section.grid)
+        {
+            result = section.grid->saveToDevice(&file);
+            section.size = file.pos() - section.offset;
+            section.rawSize = section.size;
+        }
+        else if (result)
+        {
+            result = file.write(section.data) == section.size;
+        }
+        offset = section.offset + section.size;
+
+        memset(&entries[i], 0, sizeof(SectionEntry));
+        entries[i].type = section.type;
+        entries[i].compression = section.compression;
+        entries[i].offset = section.offset;
+        entries[i].size = section.size;
+        entries[i].rawSize = section.rawSize;
+    }
+
+    qint64 tableSize = entries.count() * sizeof(SectionEntry);
+    result = result && file.seek(0) &&
+                file.write(reinterpret_cast<const char *>(&header),
+                sizeof(header)) == sizeof(header) &&
+                file.write(reinterpret_cast<const char *>(entries.data()),
+                tableSize) == tableSize;
+    file.close();
+
+    // previous file is replaced, not overwritten, as its grids may be mapped
+    if (result)
+    {
+        QFile::remove(fileName);
+        result = QFile::rename(partFileName, fileName);
+    }
+    if (!result)
+    {
+        qWarning() << "DocumentFile: can not write" << fileName;
+        QFile::remove(partFileName);
+        return false;
+    }
+
+    fFileName = fileName;
+    return true;
+}
+
+bool DocumentFile::open(const QString &fileName)
+{
+    fFileName.clear();
+    fSections.clear();
+
+    QFile file(fileName);
+    Header header;
+    if (!file.open(QIODevice::ReadOnly) ||
+                file.read(reinterpret_cast<char *>(&header),
+                sizeof(header)) != sizeof(header) ||
+                memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        qWarning() << "DocumentFile:" << fileName << "is not a document";
+        return false;
+    }
+    if (header.version != kVersion)
+    {
+        qWarning() << "DocumentFile:" << fileName << "has unsupported version"
+                    << header.version;
+        return false;
+    }
+
+    QVector<SectionEntry> entries(header.sectionCount);
+    qint64 tableSize = entries.count() * sizeof(SectionEntry);
+    if (file.read(reinterpret_cast<char *>(entries.data()), tableSize) !=
+                tableSize)
+    {
+        qWarning() << "DocumentFile:" << fileName << "is truncated";
+        return false;
+    }
+
+    for (int i = 0; i < entries.count(); i++)
+    {
+        if (entries[i].offset + entries[i].size > file.size())
+        {
+            qWarning() << "DocumentFile:" << fileName << "is truncated";
+            fSections.clear();
+            return false;
+        }
+
+        Section section;
+        section.type = static_cast<DocumentSectionType>(entries[i].type);
+        section.compression =
+                    static_cast<DocumentCompression>(entries[i].compression);
+        section.offset = entries[i].offset;
+        section.size = entries[i].size;
+        section.rawSize = entries[i].rawSize;
+        section.grid = 0;
+        fSections.append(section);
+    }
+
+    fFileName = fileName;
+    return true;
+}
+
+int DocumentFile::sectionCount(DocumentSectionType type) const
+{
+    int result = 0;
+    for (int i = 0; i < fSections.count(); i++)
+    {
+        if (fSections[i].type == type)
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+QByteArray DocumentFile::section(DocumentSectionType type, int index) const
+{
+    QByteArray result;
+
+    int number = sectionNumber(type, index);
+    if (number < 0)
+    {
+        return result;
+    }
+    const Section &section = fSections[number];
+
+    QFile file(fFileName);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(section.offset))
+    {
+        return result;
+    }
+    result = file.read(section.size);
+
+    if (section.compression == ZLIB_COMPRESSION)
+    {
+        result = qUncompress(result);
+    }
+    else if (section.compression != NO_COMPRESSION)
+    {
+        qWarning() << "DocumentFile: unknown compression" <<
+                    section.compression << "of section" << number;
+        result.clear();
+    }
+
+    if (result.size() != section.rawSize)
+    {
+        qWarning() << "DocumentFile: section" << number << "is corrupted";
+        result.clear();
+    }
+    return result;
+}
+
+bool DocumentFile::attachGrid(int index, FieldObject *fieldObject) const
+{
+    int number = sectionNumber(GRID_SECTION, index);
+    if (number < 0 || fSections[number].compression != NO_COMPRESSION)
+    {
+        return false;
+    }
+
+    return fieldObject->attachGridFile(fFileName, fSections[number].offset);
+}
+
+int DocumentFile::sectionNumber(DocumentSectionType type, int index) const
+{
+    for (int i = 0; i < fSections.count(); i++)
+    {
+        if (fSections[i].type == type)
+        {
+            if (index == 0)
+            {
+                return i;
+            }
+            index--;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * documentfile.h is part of 3D Meta-Object-based Modelling System           *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DOCUMENTFILE_H
+#define DOCUMENTFILE_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class Grid;
+class FieldObject;
+
+typedef enum
+{
+    VIEW_SECTION = 1, // XML of view state.
+    FIELD_SECTION, // XML of field (meta-objects and their variables).
+    GRID_SECTION, // evaluated grid of a meta-object, see addGridSection().
+    MESH_SECTION // extracted triangles (TriangleN array).
+} DocumentSectionType;
+
+typedef enum
+{
+    NO_COMPRESSION = 0,
+    ZLIB_COMPRESSION
+} DocumentCompression;
+
+// Represents binary document file. It is a versioned container of sections:
+// header and section table go first, every section starts at a page
+// boundary so uncompressed ones may be mapped. Document data (view state,
+// field XML) is kept in sections together with evaluated grids of
+// meta-objects and extracted mesh, so saved scene is shown without
+// evaluation of its meta-objects.
+class DocumentFile
+{
+public:
+    DocumentFile();
+
+    // Sections are written by save() in the order they were added.
+    void addSection(DocumentSectionType type, const QByteArray &data,
+                DocumentCompression compression = NO_COMPRESSION);
+    // Grid is written uncompressed so it can be attached by attachGrid(),
+    // it has to stay alive until save().
+    void addGridSection(const Grid *grid);
+    // File is written under its name only when it is written completely,
+    // so grids attached from previous version of the file stay valid.
+    bool save(const QString &fileName);
+
+    // Reads section table only, sections are read when they are asked for.
+    bool open(const QString &fileName);
+    inline QString fileName() const { return fFileName; }
+
+    int sectionCount(DocumentSectionType type) const;
+    // Returns uncompressed data of index-th section of the type, empty
+    // array if there is no such section.
+    QByteArray section(DocumentSectionType type, int index = 0) const;
+    // Current grid of field object takes values of index-th grid section
+    // (see FieldObject::attachGridFile()). Returns false if there is no
+    // such section or its geometry differs from the grid one.
+    bool attachGrid(int index, FieldObject *fieldObject) const;
+
+protected:
+    // Returns -1 if there is no such section.
+    int sectionNumber(DocumentSectionType type, int index) const;
+
+private:
+    typedef struct
+    {
+        DocumentSectionType type;
+        DocumentCompression compression;
+        qint64 offset; // in file.
+        qint64 size; // in file.
+        qint64 rawSize; // uncompressed.
+        QByteArray data; // of added section.
+        const Grid *grid; // of added grid section.
+    } Section;
+
+    QString fFileName;
+    QList<Section> fSections;
+};
+
+#endif // DOCUMENTFILE_H
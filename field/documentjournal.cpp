@@ -0,0 +1,611 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * documentjournal.cpp is part of 3D Meta-Object-based Modelling System      *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QDebug>
+#include <QDesktopServices>
+#include <QDir>
+#include <QStringList>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QtConcurrentRun>
+
+#include "documentjournal.h"
+#include "metaobject.h"
+#include "transforms.h"
+
+namespace JournalFormat
+{
+    const char kMagic[8] = { 'D', 'I', 'P', '2', 'J', 'R', 'N', 'L' };
+    const quint32 kVersion = 1;
+    const QDataStream::Version kStreamVersion = QDataStream::Qt_4_5;
+
+    const char kSnapshotFileName[] = "snapshot.mox";
+    const char kJournalFileName[] = "journal";
+    // journal which operations are being compacted into snapshot
+    const char kOldJournalFileName[] = "journal.old";
+    // locked by instance which journal is in directory
+    const char kLockFileName[] = "lock";
+
+    // Locks file of given name (it is created if needed). Lock is held by
+    // returned descriptor and is released by system when process exits in
+    // any way, so lock of crashed instance is not left. Returns -1 if file
+    // is locked by other instance.
+    int lockFile(const QString &fileName)
+    {
+        int descriptor = ::open(QFile::encodeName(fileName).constData(),
+                    O_RDWR | O_CREAT, 0644);
+        if (descriptor >= 0 && flock(descriptor, LOCK_EX | LOCK_NB) != 0)
+        {
+            ::close(descriptor);
+            descriptor = -1;
+        }
+        return descriptor;
+    }
+
+    bool isLocked(const QString &directory)
+    {
+        int descriptor = lockFile(directory + "/" + kLockFileName);
+        if (descriptor < 0)
+        {
+            return true;
+        }
+        ::close(descriptor);
+        return false;
+    }
+
+    void removeDocumentFiles(const QString &directory)
+    {
+        QFile::remove(directory + "/" + kJournalFileName);
+        QFile::remove(directory + "/" + kOldJournalFileName);
+        QFile::remove(directory + "/" + kSnapshotFileName);
+        QFile::remove(directory + "/" + kSnapshotFileName + ".part");
+    }
+
+    JournalMetaObject metaObjectState(MetaObject *metaObject)
+    {
+        JournalMetaObject result;
+        result.expression = metaObject->description();
+        VariablesManager variablesManager(metaObject->variablesManager());
+        QStringList variableNames(variablesManager.variableNames());
+        for (int i = 0; i < variableNames.count(); i++)
+        {
+            result.variables.insert(variableNames[i],
+                        variablesManager.variableValue(variableNames[i]));
+        }
+        result.transform = metaObject->transform();
+        return result;
+    }
+
+    void applyOperation(JournalOperation operation, int index,
+                const JournalMetaObject &metaObject,
+                QList<JournalMetaObject> *metaObjects)
+    {
+        bool validIndex = index >= 0 && index < metaObjects->count();
+        if (operation == ADD_META_OBJECT)
+        {
+            metaObjects->append(metaObject);
+        }
+        else if (operation == REMOVE_META_OBJECT && validIndex)
+        {
+            metaObjects->removeAt(index);
+        }
+        else if (operation == SET_VARIABLES && validIndex)
+        {
+            (*metaObjects)[index].variables = metaObject.variables;
+        }
+    }
+
+    QByteArray documentXMLData(const QByteArray &viewXMLData,
+                const QList<JournalMetaObject> &metaObjects,
+                quint64 sequence)
+    {
+        QByteArray result;
+        QBuffer buffer(&result);
+        buffer.open(QIODevice::WriteOnly);
+
+        QXmlStreamWriter writer(&buffer);
+        writer.setAutoFormatting(true);
+        writer.setAutoFormattingIndent(4);
+        writer.writeStartDocument();
+        writer.writeStartElement("document");
+        writer.writeAttribute("type", "meta-objects");
+        writer.writeAttribute("name", "not-used");
+        // operations up to sequence are in the snapshot already
+        writer.writeAttribute("sequence", QString::number(sequence));
+
+        QXmlStreamReader viewReader(viewXMLData);
+        while (!viewReader.atEnd())
+        {
+            viewReader.readNext();
+            if (!viewReader.isStartDocument() && !viewReader.isEndDocument())
+            {
+                writer.writeCurrentToken(viewReader);
+            }
+        }
+
+        writer.writeStartElement("field");
+        for (int i = 0; i < metaObjects.count(); i++)
+        {
+            PostfixExprMetaObject::writeXMLElement(&writer,
+                        metaObjects[i].expression, metaObjects[i].variables,
+                        metaObjects[i].transform);
+        }
+        writer.writeEndElement();
+
+        writer.writeEndElement();
+        writer.writeEndDocument();
+        buffer.close();
+
+        return result;
+    }
+
+    // Runs in background thread. Snapshot appears under its name only when
+    // it is written completely, rename() replaces previous one atomically,
+    // so there is a whole snapshot on disk at any moment. Journal it
+    // replaces is removed afterwards.
+    bool writeSnapshot(const QString &fileName, const QByteArray &viewXMLData,
+                const QList<JournalMetaObject> &metaObjects,
+                quint64 sequence, const QString &oldJournalFileName)
+    {
+        QString partFileName(fileName + ".part");
+        QByteArray data(documentXMLData(viewXMLData, metaObjects, sequence));
+        QFile file(partFileName);
+        bool result = file.open(QIODevice::WriteOnly) &&
+                    file.write(data) == data.size() && file.flush();
+        file.close();
+
+        if (!result || ::rename(QFile::encodeName(partFileName).constData(),
+                    QFile::encodeName(fileName).constData()) != 0)
+        {
+            qWarning() << "DocumentJournal: can not write" << fileName;
+            QFile::remove(partFileName);
+            return false;
+        }
+        QFile::remove(oldJournalFileName);
+        return true;
+    }
+
+    // Appends operations of journal file to the end of other journal file.
+    bool appendJournal(const QString &fileName, const QString &targetFileName)
+    {
+        QFile file(fileName);
+        QFile targetFile(targetFileName);
+        if (!file.open(QIODevice::ReadOnly) ||
+                    !targetFile.open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            return false;
+        }
+
+        QByteArray operations(file.readAll().mid(sizeof(kMagic) +
+                    sizeof(kVersion)));
+        return targetFile.write(operations) == operations.size() &&
+                    targetFile.flush();
+    }
+
+    bool readSnapshot(const QString &fileName, QByteArray *viewXMLData,
+                QList<JournalMetaObject> *metaObjects, quint64 *sequence)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+
+        QBuffer viewBuffer(viewXMLData);
+        viewBuffer.open(QIODevice::WriteOnly);
+        QXmlStreamWriter viewWriter(&viewBuffer);
+
+        QXmlStreamReader reader(&file);
+        int depth = 0;
+        int viewDepth = 0; // of view element, 0 outside of it.
+        while (!reader.atEnd())
+        {
+            reader.readNext();
+            if (reader.isStartElement())
+            {
+                depth++;
+            }
+            if (depth == 1 && reader.isStartElement())
+            {
+                *sequence = reader.attributes().value("sequence").toString()
+                            .toULongLong();
+            }
+            else if (viewDepth == 0 && depth == 2 && reader.isStartElement() &&
+                        reader.name() == QLatin1String("view"))
+            {
+                viewDepth = depth;
+            }
+            else if (depth == 3 && reader.isStartElement() &&
+                        reader.name() == QLatin1String("meta-object"))
+            {
+                JournalMetaObject metaObject;
+                PostfixExprMetaObject::readXMLElement(&reader,
+                            &metaObject.expression, &metaObject.variables,
+                            &metaObject.transform);
+                metaObjects->append(metaObject);
+                depth--; // meta-object end element is read already
+                continue;
+            }
+
+            if (viewDepth > 0)
+            {
+                viewWriter.writeCurrentToken(reader);
+            }
+            if (reader.isEndElement())
+            {
+                if (depth == viewDepth)
+                {
+                    viewDepth = -1; // view is copied
+                }
+                depth--;
+            }
+        }
+        viewBuffer.close();
+
+        if (reader.hasError())
+        {
+            qWarning() << "DocumentJournal: snapshot XML error at line" <<
+                        reader.lineNumber() << ":" << reader.errorString();
+        }
+        return !reader.hasError();
+    }
+
+    // Applies operations of journal file which are not in snapshot yet.
+    // Reading stops at a partially written operation.
+    void replayJournal(const QString &fileName, quint64 snapshotSequence,
+                QList<JournalMetaObject> *metaObjects)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(kStreamVersion);
+        char magic[sizeof(kMagic)];
+        quint32 version = 0;
+        if (stream.readRawData(magic, sizeof(magic)) != sizeof(magic) ||
+                    memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+        {
+            return;
+        }
+        stream >> version;
+        if (version != kVersion)
+        {
+            return;
+        }
+
+        while (!stream.atEnd())
+        {
+            quint64 sequence = 0;
+            quint8 operation = 0;
+            qint32 index = 0;
+            JournalMetaObject metaObject;
+            metaObject.transform = Transforms::identity();
+            stream >> sequence >> operation >> index;
+            if (operation == ADD_META_OBJECT)
+            {
+                stream >> metaObject.expression;
+                for (int i = 0; i < 12; i++)
+                {
+                    stream >> metaObject.transform.m[i / 4][i % 4];
+                }
+            }
+            if (operation == ADD_META_OBJECT || operation == SET_VARIABLES)
+            {
+                stream >> metaObject.variables;
+            }
+            if (stream.status() != QDataStream::Ok)
+            {
+                break;
+            }
+            if (sequence > snapshotSequence)
+            {
+                applyOperation(static_cast<JournalOperation>(operation),
+                            index, metaObject, metaObjects);
+            }
+        }
+    }
+}
+
+using namespace JournalFormat;
+
+DocumentJournal::DocumentJournal(const QString &directory)
+            : fDirectory(directory), fLockDescriptor(-1), fSequence(0),
+            fPendingOperationCount(0), fViewChanged(false)
+{
+}
+
+DocumentJournal::~DocumentJournal()
+{
+    fCompaction.waitForFinished();
+    fJournalFile.close();
+
+    if (fLockDescriptor >= 0)
+    {
+        if (!QFile::exists(filePath(kSnapshotFileName)) &&
+                    !QFile::exists(filePath(kSnapshotFileName) + ".part"))
+        {
+            QFile::remove(filePath(kLockFileName));
+            QDir().rmdir(fDirectory);
+        }
+        ::close(fLockDescriptor);
+    }
+}
+
+QString DocumentJournal::defaultLocation()
+{
+    return QDesktopServices::storageLocation(
+                QDesktopServices::DataLocation) + "/autosave";
+}
+
+QString DocumentJournal::newDirectory(const QString &location)
+{
+    // names are sorted in order of instances start
+    return location + "/" + QString::number(static_cast<uint>(time(0))) +
+                "-" + QString::number(static_cast<uint>(getpid()));
+}
+
+void DocumentJournal::reset(
+            const QList<QSharedPointer<MetaObject> > &metaObjects)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    discard();
+    fMetaObjects.clear();
+    for (int i = 0; i < metaObjects.count(); i++)
+    {
+        fMetaObjects.append(metaObjectState(metaObjects[i].data()));
+    }
+
+    if (QDir().mkpath(fDirectory) && lockDirectory() && openJournalFile())
+    {
+        startCompaction();
+    }
+}
+
+void DocumentJournal::setViewXMLData(const QByteArray &viewXMLData)
+{
+    if (viewXMLData != fViewXMLData)
+    {
+        fViewXMLData = viewXMLData;
+        fViewChanged = true;
+    }
+}
+
+void DocumentJournal::addMetaObject(MetaObject *metaObject)
+{
+    appendOperation(ADD_META_OBJECT, fMetaObjects.count(),
+                metaObjectState(metaObject));
+}
+
+void DocumentJournal::removeMetaObject(int index)
+{
+    appendOperation(REMOVE_META_OBJECT, index, JournalMetaObject());
+}
+
+void DocumentJournal::setVariables(int index, MetaObject *metaObject)
+{
+    appendOperation(SET_VARIABLES, index, metaObjectState(metaObject));
+}
+
+bool DocumentJournal::compact()
+{
+    if (!fJournalFile.isOpen() || fCompaction.isRunning() ||
+                (fPendingOperationCount == 0 && !fViewChanged))
+    {
+        return false;
+    }
+
+    startCompaction();
+    return true;
+}
+
+void DocumentJournal::discard()
+{
+    fCompaction.waitForFinished();
+    fJournalFile.close();
+    if (isEnabled())
+    {
+        removeDocumentFiles(fDirectory);
+    }
+}
+
+bool DocumentJournal::hasRecoverableDocument(const QString &directory)
+{
+    QString snapshotFileName(directory + "/" + kSnapshotFileName);
+    return !directory.isEmpty() && (QFile::exists(snapshotFileName) ||
+                QFile::exists(snapshotFileName + ".part")) &&
+                !isLocked(directory);
+}
+
+QStringList DocumentJournal::recoverableDirectories(const QString &location)
+{
+    QStringList result;
+    QStringList names(QDir(location).entryList(
+                QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name));
+    for (int i = 0; i < names.count(); i++)
+    {
+        QString directory(location + "/" + names[i]);
+        if (hasRecoverableDocument(directory))
+        {
+            result.append(directory);
+        }
+    }
+    return result;
+}
+
+void DocumentJournal::removeDirectory(const QString &directory)
+{
+    removeDocumentFiles(directory);
+    QFile::remove(directory + "/" + kLockFileName);
+    QDir().rmdir(directory);
+}
+
+QByteArray DocumentJournal::recoveredDocumentXMLData(
+            const QString &directory)
+{
+    QByteArray viewXMLData;
+    QList<JournalMetaObject> metaObjects;
+    quint64 sequence = 0;
+    QString snapshotFileName(directory + "/" + kSnapshotFileName);
+    if (!QFile::exists(snapshotFileName))
+    {
+        // crash right after the first snapshot of a document was written,
+        // but before it was renamed
+        snapshotFileName += ".part";
+    }
+    if (!readSnapshot(snapshotFileName, &viewXMLData, &metaObjects,
+                &sequence))
+    {
+        return QByteArray();
+    }
+
+    // old journal (if compaction was interrupted) goes first
+    replayJournal(directory + "/" + kOldJournalFileName, sequence,
+                &metaObjects);
+    replayJournal(directory + "/" + kJournalFileName, sequence,
+                &metaObjects);
+
+    return documentXMLData(viewXMLData, metaObjects, 0);
+}
+
+QString DocumentJournal::filePath(const char *fileName) const
+{
+    return fDirectory + "/" + fileName;
+}
+
+bool DocumentJournal::lockDirectory()
+{
+    if (fLockDescriptor < 0)
+    {
+        fLockDescriptor = lockFile(filePath(kLockFileName));
+        if (fLockDescriptor < 0)
+        {
+            qWarning() << "DocumentJournal:" << fDirectory <<
+                        "is used by other instance";
+        }
+    }
+    return fLockDescriptor >= 0;
+}
+
+bool DocumentJournal::openJournalFile()
+{
+    fJournalFile.setFileName(filePath(kJournalFileName));
+    if (!fJournalFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "DocumentJournal: can not write" <<
+                    fJournalFile.fileName();
+        return false;
+    }
+
+    QDataStream stream(&fJournalFile);
+    stream.setVersion(kStreamVersion);
+    stream.writeRawData(kMagic, sizeof(kMagic));
+    stream << kVersion;
+    fJournalFile.flush();
+    return true;
+}
+
+void DocumentJournal::appendOperation(JournalOperation operation, int index,
+            const JournalMetaObject &metaObject)
+{
+    if (!fJournalFile.isOpen())
+    {
+        return;
+    }
+
+    fSequence++;
+    applyOperation(operation, index, metaObject, &fMetaObjects);
+
+    // operation is written by one call, so crash leaves at most one
+    // partially written operation at the end of journal
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(kStreamVersion);
+    stream << fSequence << static_cast<quint8>(operation) <<
+                static_cast<qint32>(index);
+    if (operation == ADD_META_OBJECT)
+    {
+        stream << metaObject.expression;
+        for (int i = 0; i < 12; i++)
+        {
+            stream << metaObject.transform.m[i / 4][i % 4];
+        }
+    }
+    if (operation == ADD_META_OBJECT || operation == SET_VARIABLES)
+    {
+        stream << metaObject.variables;
+    }
+
+    if (fJournalFile.write(record) != record.size() || !fJournalFile.flush())
+    {
+        qWarning() << "DocumentJournal: can not write" <<
+                    fJournalFile.fileName();
+    }
+    fPendingOperationCount++;
+}
+
+void DocumentJournal::startCompaction()
+{
+    // operations journaled from now on go to a new journal file, the
+    // current one is removed when snapshot is written. Old journal of
+    // previous compaction is still needed if its snapshot was not written,
+    // then the current journal is appended to it.
+    fJournalFile.close();
+    bool previousFailed = fCompaction.resultCount() > 0 &&
+                !fCompaction.result();
+    if (previousFailed && QFile::exists(filePath(kOldJournalFileName)))
+    {
+        if (!appendJournal(filePath(kJournalFileName),
+                    filePath(kOldJournalFileName)))
+        {
+            qWarning() << "DocumentJournal: can not write" <<
+                        filePath(kOldJournalFileName);
+        }
+        QFile::remove(filePath(kJournalFileName));
+    }
+    else
+    {
+        QFile::remove(filePath(kOldJournalFileName));
+        QFile::rename(filePath(kJournalFileName),
+                    filePath(kOldJournalFileName));
+    }
+    openJournalFile();
+
+    fCompaction = QtConcurrent::run(writeSnapshot,
+                filePath(kSnapshotFileName), fViewXMLData, fMetaObjects,
+                fSequence, filePath(kOldJournalFileName));
+    fPendingOperationCount = 0;
+    fViewChanged = false;
+}
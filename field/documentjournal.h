@@ -0,0 +1,131 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * documentjournal.h is part of 3D Meta-Object-based Modelling System        *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DOCUMENTJOURNAL_H
+#define DOCUMENTJOURNAL_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QFile>
+#include <QFuture>
+#include <QList>
+#include <QMap>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+#include "space_types.h"
+
+class MetaObject;
+
+typedef enum
+{
+    ADD_META_OBJECT = 1, // appended to the end of field.
+    REMOVE_META_OBJECT,
+    SET_VARIABLES // of meta-object, all of them.
+} JournalOperation;
+
+// Expression meta-object as it is kept by journal, enough to write it to
+// document XML.
+typedef struct
+{
+    QString expression;
+    QMap<QString, double> variables;
+    Transform transform;
+} JournalMetaObject;
+
+// Represents autosave of a document as an append-only journal of edit
+// operations (journal file) on top of full document XML (snapshot file).
+// Operation is a small record flushed on every change, so autosave costs
+// nothing like whole document serialization through XML queries. Journal is
+// compacted into a new snapshot in a background thread, document state is
+// mirrored by journal itself, so meta-objects are not touched meanwhile.
+// Journal without directory is disabled. Each application instance keeps
+// its journal in own directory which is locked while the instance runs, so
+// instances do not touch each other's files and only directories of
+// instances which were not closed normally are recovered.
+class DocumentJournal
+{
+public:
+    DocumentJournal(const QString &directory = QString());
+    // Waits for compaction, files are left for recovery. Directory is
+    // unlocked and is removed if it was discarded.
+    ~DocumentJournal();
+
+    // Where directories of all instances are.
+    static QString defaultLocation();
+    // New directory for journal of this instance in given location.
+    static QString newDirectory(const QString &location);
+
+    inline bool isEnabled() const { return !fDirectory.isEmpty(); }
+    inline QString directory() const { return fDirectory; }
+
+    // Starts journal of a document which field has given meta-objects, its
+    // snapshot is written at once. Files of previous document are dropped.
+    void reset(const QList<QSharedPointer<MetaObject> > &metaObjects);
+    // View element of document, it is written by the next compaction.
+    void setViewXMLData(const QByteArray &viewXMLData);
+
+    void addMetaObject(MetaObject *metaObject);
+    void removeMetaObject(int index);
+    void setVariables(int index, MetaObject *metaObject);
+
+    // Operations journaled since last compaction.
+    inline int pendingOperationCount() const
+                { return fPendingOperationCount; }
+    // Writes snapshot of current document in a background thread and starts
+    // new journal file. Returns false if there is nothing to compact or
+    // previous compaction is still running.
+    bool compact();
+    // Removes journal files, f.e. when application is closed normally.
+    void discard();
+
+    // Journal files are left by an application which was not closed
+    // normally and directory is not locked by a running one.
+    static bool hasRecoverableDocument(const QString &directory);
+    // Directories of location which have recoverable documents, the most
+    // recent one goes last.
+    static QStringList recoverableDirectories(const QString &location);
+    // Removes directory of recovered (or declined) document.
+    static void removeDirectory(const QString &directory);
+    // Document XML of snapshot with journaled operations applied.
+    static QByteArray recoveredDocumentXMLData(const QString &directory);
+
+protected:
+    QString filePath(const char *fileName) const;
+    bool lockDirectory();
+    bool openJournalFile();
+    void appendOperation(JournalOperation operation, int index,
+                const JournalMetaObject &metaObject);
+    void startCompaction();
+
+private:
+    QString fDirectory;
+    int fLockDescriptor; // of directory lock file, -1 if it is not locked.
+    QFile fJournalFile;
+    quint64 fSequence; // of last journaled operation.
+    int fPendingOperationCount;
+    bool fViewChanged;
+    QByteArray fViewXMLData;
+    QList<JournalMetaObject> fMetaObjects;
+    QFuture<bool> fCompaction;
+};
+
+#endif // DOCUMENTJOURNAL_H
@@ -22,31 +22,119 @@
 
 #include <QList>
 #include <QVector>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 #include <QIODevice>
 #include <QDebug>
-#include <QXmlQuery>
-#include <QXmlItem>
-#include <QXmlResultItems>
-#include <QXmlSerializer>
+#include <QMap>
+#include <QString>
+#include <QXmlStreamReader>
 #include <QBuffer>
 
 #include "field.h"
+#include "documentfile.h"
+#include "kernelpool.h"
 #include "postfixexpr.h"
 #include "grid.h"
 
+const unsigned int kCoarsestRefinementStride = 4;
+
+namespace Loading
+{
+    // Meta-object of loaded document which is built and evaluated
+    // independently of the others.
+    typedef struct
+    {
+        QString expression;
+        QMap<QString, double> variables;
+        unsigned int xDim;
+        unsigned int yDim;
+        unsigned int zDim;
+        GridLayout layout;
+        bool explicitBounds;
+        Point minPoint;
+        Point maxPoint;
+        unsigned int stride;
+        GridKind gridKind;
+        float sparseIsoLevel;
+        float sparseBandWidth;
+        const FieldCache *cache;
+        const DocumentFile *document;
+        int index; // of meta-object element in document.
+        Transform transform;
+        PostfixExpr *kernel; // shared by tasks of the same expression.
+        PostfixExprMetaObject *metaObject; // 0 if invalid.
+    } MetaObjectTask;
+
+    void loadMetaObject(MetaObjectTask &task)
+    {
+        if (!task.kernel->successfullyParsed())
+        {
+            qDebug() << "Got invalid MetaObject, skipping it.";
+            return;
+        }
+        task.metaObject = new PostfixExprMetaObject(task.xDim, task.yDim,
+                    task.zDim, *task.kernel, task.variables, false);
+        if (!task.metaObject->isValid())
+        {
+            qDebug() << "Got invalid MetaObject, skipping it.";
+            delete task.metaObject;
+            task.metaObject = 0;
+            return;
+        }
+        task.metaObject->setTransform(task.transform);
+        task.metaObject->setGridLayout(task.layout);
+        if (task.explicitBounds)
+        {
+            task.metaObject->setGridBounds(task.minPoint, task.maxPoint);
+        }
+        if (task.gridKind == SPARSE_GRID)
+        {
+            task.metaObject->setGridKind(SPARSE_GRID);
+            task.metaObject->setSparseBand(task.sparseIsoLevel,
+                        task.sparseBandWidth);
+            task.metaObject->recalculate();
+            return;
+        }
+        if (task.document &&
+                    task.document->attachGrid(task.index, task.metaObject))
+        {
+            return;
+        }
+        if (!task.cache->load(task.metaObject))
+        {
+            task.metaObject->recalculateLevel(task.stride);
+        }
+    }
+}
+
+using namespace Loading;
+
 Field::Field(const Field &copyee) : FieldObject(copyee)
 {
     fIsoLevel = copyee.fIsoLevel;
+    fRefinementStride = copyee.fRefinementStride;
+    fCache = copyee.fCache;
     fMetaObjects = copyee.fMetaObjects;
 }
 
 Field::Field(unsigned int xDim, unsigned int yDim, unsigned int zDim,
-            QBuffer *xmlData)
-            : FieldObject(xDim, yDim, zDim, xmlData), fIsoLevel(0)
+            QBuffer *xmlData, bool progressive, const FieldCache &cache,
+            const DocumentFile *document, GridKind gridKind,
+            KernelPool *kernels)
+            : FieldObject(xDim, yDim, zDim, xmlData), fIsoLevel(0),
+            fRefinementStride(progressive ? kCoarsestRefinementStride : 1),
+            fCache(cache)
 {
+    if (gridKind == SPARSE_GRID)
+    {
+        FieldObject::setGridKind(SPARSE_GRID);
+        fRefinementStride = 1;
+    }
+
     if (xmlData)
     {
-        initWithXML(xmlData);
+        initWithXML(xmlData, document, kernels);
     }
 }
 
@@ -54,7 +142,19 @@ QByteArray Field::XMLRepresentation()
 {
     QByteArray fieldXMLData;
 
-    fieldXMLData.append("<field>");
+    const Grid *fieldGrid = grid()->data();
+    if (fieldGrid->hasExplicitBounds())
+    {
+        fieldXMLData.append(QString().sprintf("<field xmin=\"%.9g\" "
+                    "ymin=\"%.9g\" zmin=\"%.9g\" xmax=\"%.9g\" "
+                    "ymax=\"%.9g\" zmax=\"%.9g\">", fieldGrid->xMin(),
+                    fieldGrid->yMin(), fieldGrid->zMin(), fieldGrid->xMax(),
+                    fieldGrid->yMax(), fieldGrid->zMax()).toAscii());
+    }
+    else
+    {
+        fieldXMLData.append("<field>");
+    }
 
     int metaObjectCount = fMetaObjects.count();
     for (int i = 0; i < metaObjectCount; i++)
@@ -80,15 +180,31 @@ float Field::valueAtPoint(const Point& p)
     return result;
 }
 
-void Field::updateMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr)
+GridBox Field::updateMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr)
 {
+    if (gridKind() == SPARSE_GRID)
+    {
+        // sparse grids are summed again, changed cells are not tracked
+        metaObjectPtr->recalculate();
+        sumMetaObjectGrids();
+        return grid()->data()->cellsBox();
+    }
+
     metaObjectPtr->swapGrid();
-    metaObjectPtr->recalculate();
+    if (!fCache.load(metaObjectPtr.data()))
+    {
+        metaObjectPtr->recalculate();
+    }
+    const Grid *newGrid = metaObjectPtr->grid()->data();
 
     metaObjectPtr->swapGrid();
-    subtractFieldObject(metaObjectPtr.data());
+    const Grid *oldGrid = metaObjectPtr->grid()->data();
+    GridBox changedPointsBox = oldGrid->differentPointsBox(newGrid);
+
+    grid()->data()->replaceGrid(oldGrid, newGrid);
     metaObjectPtr->swapGrid();
-    addFieldObject(metaObjectPtr.data());
+
+    return grid()->data()->cellsBoxOfPoints(changedPointsBox);
 }
 
 void Field::useGridOfMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr)
@@ -141,67 +257,412 @@ void Field::setGridZDimention(unsigned int gridZDim)
     }
 }
 
+void Field::setGridLayout(GridLayout layout)
+{
+    FieldObject::setGridLayout(layout);
+
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->setGridLayout(layout);
+    }
+}
+
+void Field::setGridStorageKind(GridStorageKind kind)
+{
+    FieldObject::setGridStorageKind(kind);
+
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->setGridStorageKind(kind);
+    }
+}
+
+bool Field::refine()
+{
+    if (fRefinementStride <= 1)
+    {
+        return false;
+    }
+
+    fRefinementStride /= 2;
+
+    if (gridKind() == SPARSE_GRID)
+    {
+        // sparse grids are evaluated exactly at once
+        fRefinementStride = 1;
+        unsigned int metaObjectCount = fMetaObjects.count();
+        for(unsigned int i = 0; i < metaObjectCount; i++)
+        {
+            fMetaObjects[i]->recalculateLevel(fRefinementStride);
+        }
+        sumMetaObjectGrids();
+        return true;
+    }
+
+    QVector<const Grid *> metaObjectGrids;
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        // meta-objects changed in between are evaluated exactly already
+        fMetaObjects[i]->recalculateLevel(fRefinementStride);
+        metaObjectGrids.append(fMetaObjects[i]->grid()->data());
+    }
+
+    grid()->data()->zeroizePoints();
+    grid()->data()->addGrids(metaObjectGrids);
+
+    if (fRefinementStride == 1)
+    {
+        storeInCache();
+    }
+
+    qDebug() << "Field refined to lattice stride" << fRefinementStride;
+    return true;
+}
+
+void Field::storeInCache()
+{
+    if (gridKind() == SPARSE_GRID)
+    {
+        // cache keeps dense grids only
+        return;
+    }
+
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fCache.store(fMetaObjects[i].data());
+    }
+}
+
+void Field::resampleGrids(unsigned int xDim, unsigned int yDim,
+            unsigned int zDim)
+{
+    QVector<const Grid *> metaObjectGrids;
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->resampleGrids(xDim, yDim, zDim);
+        metaObjectGrids.append(fMetaObjects[i]->grid()->data());
+    }
+
+    // field stays exact sum of its meta-objects
+    grid()->data()->setDimentions(xDim, yDim, zDim);
+    swapGrid();
+    grid()->data()->setDimentions(xDim, yDim, zDim);
+    swapGrid();
+    if (gridKind() == SPARSE_GRID)
+    {
+        sumMetaObjectGrids();
+        return;
+    }
+    grid()->data()->addGrids(metaObjectGrids);
+}
+
+void Field::setGridBounds(const Point &minPoint, const Point &maxPoint)
+{
+    FieldObject::setGridBounds(minPoint, maxPoint);
+
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->setGridBounds(minPoint, maxPoint);
+    }
+
+    restartRefinement();
+}
+
+void Field::resetGridBounds()
+{
+    FieldObject::resetGridBounds();
+
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->resetGridBounds();
+    }
+
+    restartRefinement();
+}
+
+bool Field::fitGridBounds(float isoLevel)
+{
+    Point minPoint;
+    Point maxPoint;
+    // one step more than the lattice stride, as coarse lattice may miss
+    // surface details which are smaller than its stride
+    if (!boundingBox(isoLevel, fRefinementStride + 1, &minPoint, &maxPoint))
+    {
+        return false;
+    }
+
+    setGridBounds(minPoint, maxPoint);
+    qDebug() << "Grid bounds fitted to" << minPoint.x << minPoint.y <<
+                minPoint.z << "-" << maxPoint.x << maxPoint.y << maxPoint.z;
+    return true;
+}
+
+void Field::restartRefinement()
+{
+    // refine() evaluates meta-objects at the coarsest level then
+    fRefinementStride = 2 * kCoarsestRefinementStride;
+    refine();
+}
+
+void Field::setGridKind(GridKind kind)
+{
+    if (gridKind() == kind)
+    {
+        return;
+    }
+
+    FieldObject::setGridKind(kind);
+
+    QVector<const Grid *> metaObjectGrids;
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->setGridKind(kind);
+        fMetaObjects[i]->setSparseBand(sparseIsoLevel(), sparseBandWidth());
+        fMetaObjects[i]->recalculate();
+        metaObjectGrids.append(fMetaObjects[i]->grid()->data());
+    }
+
+    // both kinds are evaluated at full resolution
+    fRefinementStride = 1;
+    if (kind == SPARSE_GRID)
+    {
+        sumMetaObjectGrids();
+        return;
+    }
+
+    grid()->data()->zeroizePoints();
+    grid()->data()->addGrids(metaObjectGrids);
+    storeInCache();
+}
+
+void Field::setSparseBand(float isoLevel)
+{
+    if (isoLevel == sparseIsoLevel())
+    {
+        return;
+    }
+
+    FieldObject::setSparseBand(isoLevel, sparseBandWidth());
+
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        fMetaObjects[i]->setSparseBand(isoLevel, sparseBandWidth());
+    }
+
+    if (gridKind() == SPARSE_GRID)
+    {
+        sumMetaObjectGrids();
+    }
+}
+
+void Field::sumMetaObjectGrids()
+{
+    QVector<SparseGrid *> metaObjectGrids;
+    unsigned int metaObjectCount = fMetaObjects.count();
+    for(unsigned int i = 0; i < metaObjectCount; i++)
+    {
+        metaObjectGrids.append(fMetaObjects[i]->sparseGrid()->data());
+    }
+
+    SparseGrid *fieldGrid = sparseGrid()->data();
+    fieldGrid->setGeometry(grid()->data());
+    fieldGrid->sumGrids(metaObjectGrids);
+}
+
 void Field::addMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr)
 {
+    metaObjectPtr->setGridKind(gridKind());
+    metaObjectPtr->setSparseBand(sparseIsoLevel(), sparseBandWidth());
+
+    const Grid *fieldGrid = grid()->data();
+    if (!metaObjectPtr->grid()->data()->hasSameBounds(fieldGrid))
+    {
+        // meta-object has to be evaluated in grid points of the field
+        if (fieldGrid->hasExplicitBounds())
+        {
+            Point minPoint = { fieldGrid->xMin(), fieldGrid->yMin(),
+                        fieldGrid->zMin() };
+            Point maxPoint = { fieldGrid->xMax(), fieldGrid->yMax(),
+                        fieldGrid->zMax() };
+            metaObjectPtr->setGridBounds(minPoint, maxPoint);
+        }
+        else
+        {
+            metaObjectPtr->resetGridBounds();
+        }
+        metaObjectPtr->recalculate();
+    }
+
+    if (gridKind() == SPARSE_GRID)
+    {
+        if (metaObjectPtr->evaluatedStride() != 1)
+        {
+            metaObjectPtr->recalculate();
+        }
+        fMetaObjects.append(metaObjectPtr);
+        sumMetaObjectGrids();
+        return;
+    }
+
+    // grids of the same layout are added much faster
+    metaObjectPtr->setGridLayout(grid()->data()->layout());
     addFieldObject(metaObjectPtr.data());
     fMetaObjects.append(metaObjectPtr);
 }
 
 void Field::removeMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr)
 {
+    if (gridKind() == SPARSE_GRID)
+    {
+        fMetaObjects.removeOne(metaObjectPtr);
+        sumMetaObjectGrids();
+        return;
+    }
+
     subtractFieldObject(metaObjectPtr.data());
     fMetaObjects.removeOne(metaObjectPtr);
 }
 
-bool Field::initWithXML(QBuffer *xmlData)
+bool Field::initWithXML(QBuffer *xmlData, const DocumentFile *document,
+            KernelPool *kernels)
 {
     bool result = false;
 
+    MetaObjectTask task;
+    task.xDim = grid()->data()->xDimention();
+    task.yDim = grid()->data()->yDimention();
+    task.zDim = grid()->data()->zDimention();
+    task.layout = grid()->data()->layout();
+    task.stride = fRefinementStride;
+    task.gridKind = gridKind();
+    task.sparseIsoLevel = sparseIsoLevel();
+    task.sparseBandWidth = sparseBandWidth();
+    task.explicitBounds = false;
+    task.cache = &fCache;
+    task.document = document;
+    task.index = 0;
+    task.transform = Transforms::identity();
+    task.kernel = 0;
+    task.metaObject = 0;
+
+    QList<MetaObjectTask> tasks;
+
+    // whole document is read in one pass, every expression defined
+    // meta-object (child of root field element) becomes a task as soon as
+    // its element ends
     xmlData->open(QIODevice::ReadOnly);
-    QXmlQuery query;
-    query.bindVariable("field", xmlData);
-
-    QXmlResultItems resultItems;
-    query.setQuery("fn:count(fn:doc($field)/field/"
-                "meta-object[@type='expression'])");
-    // how many expression defined meta-objects we have
-    query.evaluateTo(&resultItems);
-    xmlData->close();
-
-    int exprMetaObjectCount = resultItems.next().toAtomicValue().toInt();
-    qDebug() << "Expression MetaObject count = " << exprMetaObjectCount;
-
-    char queryFormat[] = "let $exprMetaObjects := "
-                "fn:doc($field)/field/meta-object[@type='expression'] "
-                "return $exprMetaObjects[%i]";
-
-    int xDim = grid()->data()->xDimention();
-    int yDim = grid()->data()->yDimention();
-    int zDim = grid()->data()->zDimention();
+    QXmlStreamReader reader(xmlData);
+    int depth = 0;
+    while (!reader.atEnd())
+    {
+        reader.readNext();
+        if (reader.isEndElement())
+        {
+            depth--;
+            continue;
+        }
+        if (!reader.isStartElement())
+        {
+            continue;
+        }
+        depth++;
+        if (depth == 1 && reader.attributes().hasAttribute("xmin"))
+        {
+            // grid bounds the document was saved with
+            QXmlStreamAttributes attributes = reader.attributes();
+            Point minPoint = { attributes.value("xmin").toString().toFloat(),
+                        attributes.value("ymin").toString().toFloat(),
+                        attributes.value("zmin").toString().toFloat() };
+            Point maxPoint = { attributes.value("xmax").toString().toFloat(),
+                        attributes.value("ymax").toString().toFloat(),
+                        attributes.value("zmax").toString().toFloat() };
+            FieldObject::setGridBounds(minPoint, maxPoint);
+            task.explicitBounds = grid()->data()->hasExplicitBounds();
+            task.minPoint = minPoint;
+            task.maxPoint = maxPoint;
+            continue;
+        }
+        if (depth != 2 || reader.name() != QLatin1String("meta-object") ||
+                    reader.attributes().value("type") !=
+                    QLatin1String("expression"))
+        {
+            continue;
+        }
 
-    for (int i = 1; i <= exprMetaObjectCount; i++)
+        PostfixExprMetaObject::readXMLElement(&reader, &task.expression,
+                    &task.variables, &task.transform);
+        depth--; // meta-object end element is read already
+        tasks.append(task);
+        task.index++;
+    }
+    if (reader.hasError())
     {
-        QByteArray metaObjectXMLData;
-        QBuffer metaObjectBuffer(&metaObjectXMLData);
-        metaObjectBuffer.open(QIODevice::WriteOnly);
+        qWarning() << "Field XML error at line" << reader.lineNumber() <<
+                    ":" << reader.errorString();
+    }
+    xmlData->close();
 
-        query.setQuery(QString().sprintf(queryFormat, i));
+    // every distinct expression is parsed once (parser is serial anyway),
+    // so instances of a meta-object which differ by variable values or
+    // transform only are built of copies of one kernel
+    KernelPool ownKernels;
+    KernelPool *kernelPool = kernels ? kernels : &ownKernels;
+    QList<QSharedPointer<PostfixExpr> > taskKernels;
+    for (int i = 0; i < tasks.count(); i++)
+    {
+        taskKernels.append(kernelPool->kernel(tasks[i].expression));
+        tasks[i].kernel = taskKernels.last().data();
+    }
+    qDebug() << "Expression MetaObject count = " << tasks.count() <<
+                ", distinct expressions = " << kernelPool->count();
 
-        QXmlSerializer metaObjectSerializer(query, &metaObjectBuffer);
-        query.evaluateTo(&metaObjectSerializer);
-        metaObjectBuffer.close();
+    // meta-objects are built and evaluated concurrently, one per task
+    if (tasks.count() < 2 ||
+                QThreadPool::globalInstance()->maxThreadCount() < 2)
+    {
+        for (int i = 0; i < tasks.count(); i++)
+        {
+            loadMetaObject(tasks[i]);
+        }
+    }
+    else
+    {
+        QtConcurrent::blockingMap(tasks, loadMetaObject);
+    }
 
-        PostfixExprMetaObject *metaObject =
-                    new PostfixExprMetaObject(xDim, yDim, zDim,
-                                &metaObjectBuffer);
-        if (!metaObject->isValid())
+    // meta-objects are accumulated at once in document order, so field
+    // values do not depend on the order tasks were finished in
+    QVector<const Grid *> metaObjectGrids;
+    for (int i = 0; i < tasks.count(); i++)
+    {
+        PostfixExprMetaObject *metaObject = tasks[i].metaObject;
+        if (metaObject)
         {
-            qDebug() << "Got invalid MetaObject, skipping it.";
-            delete metaObject;
-            continue;
+            metaObjectGrids.append(metaObject->grid()->data());
+            fMetaObjects.append(QSharedPointer<MetaObject>(metaObject));
         }
-        addFieldObject(metaObject);
-        fMetaObjects.append(QSharedPointer<MetaObject>(metaObject));
+    }
+    if (gridKind() == SPARSE_GRID)
+    {
+        sumMetaObjectGrids();
+    }
+    else
+    {
+        grid()->data()->addGrids(metaObjectGrids);
+    }
+
+    if (fRefinementStride == 1)
+    {
+        storeInCache();
     }
 
     result = true;
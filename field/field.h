@@ -25,6 +25,10 @@
 
 #include "metaobject.h"
 #include "fieldobject.h"
+#include "fieldcache.h"
+
+class DocumentFile;
+class KernelPool;
 
 class QBuffer;
 class QByteArray;
@@ -37,31 +41,82 @@ class Field : public FieldObject
 {
 public:
     Field(const Field &copyee);
+    // Progressive field evaluates its meta-objects at coarse resolution
+    // only, refine() is used to get to the full one. Meta-objects found in
+    // cache or embedded in binary document (grid sections go in order of
+    // meta-object elements) are not evaluated at all. Field of sparse grid
+    // kind is evaluated exactly at once, without cache and embedded grids.
+    // Expressions are parsed into kernels of given pool, or of the field's
+    // own one if it is not given.
     Field(unsigned int xDim, unsigned int yDim, unsigned int zDim,
-                QBuffer *xmlData = 0);
+                QBuffer *xmlData = 0, bool progressive = false,
+                const FieldCache &cache = FieldCache(),
+                const DocumentFile *document = 0,
+                GridKind gridKind = DENSE_GRID, KernelPool *kernels = 0);
 
     virtual QByteArray XMLRepresentation();
 
     virtual float valueAtPoint(const Point& p);
 
-    void updateMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
+    // Returns box of grid cells where field has changed.
+    GridBox updateMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
     void useGridOfMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
 
     void setGridSidesDimention(unsigned int gridDim);
     void setGridXDimention(unsigned int gridXDim);
     void setGridYDimention(unsigned int gridYDim);
     void setGridZDimention(unsigned int gridZDim);
+    void setGridLayout(GridLayout layout);
+    void setGridStorageKind(GridStorageKind kind);
+    // Fast preview of dimentions change: grids of meta-objects are resampled
+    // and summed up. Exact values of a meta-object are restored by
+    // updateMetaObject(). Sparse grids are recalculated exactly instead.
+    void resampleGrids(unsigned int xDim, unsigned int yDim,
+                unsigned int zDim);
+    // Meta-objects have to be reevaluated in new grid points, it is done at
+    // the coarsest refinement level, refine() is used to get to the full
+    // one.
+    void setGridBounds(const Point &minPoint, const Point &maxPoint);
+    void resetGridBounds();
+    // Fits grid bounds to the bounding box of isoLevel isosurface of the
+    // field, so all grid points are spent near the model. Returns false
+    // (bounds are not changed) if there is no isosurface in the grid.
+    bool fitGridBounds(float isoLevel);
+
+    // Meta-objects are recalculated in grids of new kind and summed up.
+    void setGridKind(GridKind kind);
+    // Moves sparse grid band (see SparseGrid::setBand()) to isoLevel, sum
+    // of meta-objects is exact near the isosurface of that level only.
+    void setSparseBand(float isoLevel);
 
     void addMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
     void removeMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
 
     QList<QSharedPointer<MetaObject> > metaObjects() { return fMetaObjects; }
 
+    // Stride of the lattice meta-objects are evaluated on, 1 when field is
+    // evaluated at full resolution.
+    unsigned int refinementStride() const { return fRefinementStride; }
+    // Evaluates meta-objects on twice finer lattice (only points which are
+    // new to it), returns false if field is at full resolution already.
+    bool refine();
+
+    void setCache(const FieldCache &cache) { fCache = cache; }
+    // Stores exactly evaluated meta-objects in cache, it is done on its own
+    // when refinement gets to full resolution.
+    void storeInCache();
+
 protected:
-    bool initWithXML(QBuffer *xmlData);
+    bool initWithXML(QBuffer *xmlData, const DocumentFile *document,
+                KernelPool *kernels);
+    void restartRefinement();
+    // Sparse grid of the field gets sum of meta-object sparse grids.
+    void sumMetaObjectGrids();
 
 private:
     float fIsoLevel;
+    unsigned int fRefinementStride;
+    FieldCache fCache;
     QList<QSharedPointer<MetaObject> > fMetaObjects;
 };
 
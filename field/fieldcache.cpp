@@ -0,0 +1,118 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * fieldcache.cpp is part of 3D Meta-Object-based Modelling System           *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDesktopServices>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "fieldcache.h"
+#include "metaobject.h"
+#include "grid.h"
+
+const qint64 kMaxCacheSize = 1024 * 1024 * 1024; // in bytes.
+const char kGridFileSuffix[] = ".grid";
+
+FieldCache::FieldCache(const QString &directory) : fDirectory(directory)
+{
+}
+
+QString FieldCache::defaultDirectory()
+{
+    return QDesktopServices::storageLocation(
+                QDesktopServices::CacheLocation) + "/grids";
+}
+
+bool FieldCache::load(MetaObject *metaObject) const
+{
+    if (!isEnabled())
+    {
+        return false;
+    }
+
+    QString gridFileName(fileName(metaObject));
+    if (!QFile::exists(gridFileName))
+    {
+        return false;
+    }
+
+    return metaObject->attachGridFile(gridFileName);
+}
+
+void FieldCache::store(MetaObject *metaObject) const
+{
+    if (!isEnabled() || metaObject->evaluatedStride() != 1)
+    {
+        return;
+    }
+
+    QString gridFileName(fileName(metaObject));
+    if (QFile::exists(gridFileName) || !QDir().mkpath(fDirectory))
+    {
+        return;
+    }
+
+    // grid appears under its name only when it is written completely
+    QString partFileName(gridFileName + ".part");
+    if (!metaObject->grid()->data()->saveToFile(partFileName) ||
+                !QFile::rename(partFileName, gridFileName))
+    {
+        qWarning() << "FieldCache: can not write" << gridFileName;
+        QFile::remove(partFileName);
+        return;
+    }
+
+    removeOldestFiles();
+}
+
+QString FieldCache::fileName(MetaObject *metaObject) const
+{
+    const Grid *grid = metaObject->grid()->data();
+    QByteArray key(metaObject->XMLRepresentation());
+    key += QString().sprintf("%u %u %u %i %.9g %.9g %.9g %.9g %.9g %.9g",
+                grid->xDimention(), grid->yDimention(), grid->zDimention(),
+                grid->layout(), grid->xMin(), grid->xMax(), grid->yMin(),
+                grid->yMax(), grid->zMin(), grid->zMax()).toAscii();
+
+    return fDirectory + "/" + QCryptographicHash::hash(key,
+                QCryptographicHash::Md5).toHex() + kGridFileSuffix;
+}
+
+void FieldCache::removeOldestFiles() const
+{
+    QFileInfoList files = QDir(fDirectory).entryInfoList(
+                QStringList(QString("*") + kGridFileSuffix), QDir::Files,
+                QDir::Time);
+
+    qint64 cacheSize = 0;
+    int fileCount = files.count();
+    for (int i = 0; i < fileCount; i++)
+    {
+        cacheSize += files[i].size();
+        // newest files go first
+        if (cacheSize > kMaxCacheSize)
+        {
+            QFile::remove(files[i].absoluteFilePath());
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * fieldcache.h is part of 3D Meta-Object-based Modelling System             *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FIELDCACHE_H
+#define FIELDCACHE_H
+
+#include <QString>
+
+class MetaObject;
+
+// Represents on-disk cache of exactly evaluated meta-object grids. File name
+// of a grid is a hash of meta-object XML representation (expression text and
+// variable values) and of grid geometry, so changed meta-objects and grids
+// simply miss the cache. Cached grids are attached by mapping (see
+// Grid::attachFile()), not read. Cache without directory is disabled.
+class FieldCache
+{
+public:
+    FieldCache(const QString &directory = QString());
+
+    static QString defaultDirectory();
+
+    inline bool isEnabled() const { return !fDirectory.isEmpty(); }
+    inline QString directory() const { return fDirectory; }
+
+    // Returns true if current grid of meta-object was taken from cache.
+    bool load(MetaObject *metaObject) const;
+    // Stores exactly evaluated current grid of meta-object if it is not
+    // cached yet. Oldest grids are removed when cache exceeds its size.
+    void store(MetaObject *metaObject) const;
+
+protected:
+    QString fileName(MetaObject *metaObject) const;
+    void removeOldestFiles() const;
+
+private:
+    QString fDirectory;
+};
+
+#endif // FIELDCACHE_H
@@ -24,17 +24,27 @@
 
 #include "fieldobject.h"
 
+const float kDefaultSparseIsoLevel = 2.0;
+const float kDefaultSparseBandWidth = 0.5;
+
 FieldObject::FieldObject(const FieldObject &copyee)
 {
     fCurrentGridId = copyee.fCurrentGridId;
     fGrid[0] = copyee.fGrid[0];
     fGrid[1] = copyee.fGrid[1];
     fUsingExternalGrid = copyee.fUsingExternalGrid;
+    fEvaluatedStride = copyee.fEvaluatedStride;
+    fGridKind = copyee.fGridKind;
+    fSparseGrid = copyee.fSparseGrid;
+    fSparseIsoLevel = copyee.fSparseIsoLevel;
+    fSparseBandWidth = copyee.fSparseBandWidth;
 }
 
 FieldObject::FieldObject(unsigned int xDim, unsigned int yDim,
             unsigned int zDim, QBuffer *xmlData)
-            : fCurrentGridId(0), fUsingExternalGrid(0)
+            : fCurrentGridId(0), fUsingExternalGrid(0), fEvaluatedStride(0),
+            fGridKind(DENSE_GRID), fSparseIsoLevel(kDefaultSparseIsoLevel),
+            fSparseBandWidth(kDefaultSparseBandWidth)
 {
     initGrids(xDim, yDim, zDim);
 }
@@ -47,13 +57,59 @@ FieldObject::FieldObject(QBuffer *xmlData) : fCurrentGridId(0),
 */
 void FieldObject::recalculate()
 {
+    if (fGridKind == SPARSE_GRID)
+    {
+        fSparseGrid->setGeometry(grid()->data());
+        fSparseGrid->fillWithFieldObject(this);
+        fEvaluatedStride = 1;
+        return;
+    }
+
     grid()->data()->fillWithFieldObject(this);
+    fEvaluatedStride = 1;
+}
+
+void FieldObject::recalculateLevel(unsigned int stride)
+{
+    if (fEvaluatedStride != 0 && fEvaluatedStride <= stride)
+    {
+        return;
+    }
+
+    if (fGridKind == SPARSE_GRID)
+    {
+        recalculate();
+        return;
+    }
+
+    // previous level is reused only if its lattice contains the new one
+    unsigned int evaluatedStride = fEvaluatedStride;
+    if (evaluatedStride % stride != 0)
+    {
+        evaluatedStride = 0;
+    }
+
+    grid()->data()->fillWithFieldObject(this, stride, evaluatedStride);
+    fEvaluatedStride = stride;
+}
+
+bool FieldObject::attachGridFile(const QString &fileName, qint64 offset)
+{
+    if (fGridKind == SPARSE_GRID ||
+                !grid()->data()->attachFile(fileName, offset))
+    {
+        return false;
+    }
+
+    fEvaluatedStride = 1;
+    return true;
 }
 
 void FieldObject::useExternalGrid(const FieldObject *fieldObject)
 {
     //swapGrid();
     fGrid[fCurrentGridId] = fieldObject->fGrid[fCurrentGridId];
+    fSparseGrid = fieldObject->fSparseGrid;
     fUsingExternalGrid = true;
 }
 
@@ -71,6 +127,13 @@ void FieldObject::swapGrid()
 
 void FieldObject::addFieldObject(const FieldObject *fieldObject)
 {
+    if (fGridKind == SPARSE_GRID || fieldObject->fGridKind == SPARSE_GRID)
+    {
+        qWarning() << "Sparse grids can not be added, see"
+                    << "SparseGrid::sumGrids()";
+        return;
+    }
+
     Grid *thisGrid = grid()->data();
     Grid *grid = fieldObject->grid()->data();
 
@@ -79,6 +142,13 @@ void FieldObject::addFieldObject(const FieldObject *fieldObject)
 
 void FieldObject::subtractFieldObject(const FieldObject *fieldObject)
 {
+    if (fGridKind == SPARSE_GRID || fieldObject->fGridKind == SPARSE_GRID)
+    {
+        qWarning() << "Sparse grids can not be subtracted, see"
+                    << "SparseGrid::sumGrids()";
+        return;
+    }
+
     Grid *thisGrid = grid()->data();
     Grid *grid = fieldObject->grid()->data();
 
@@ -118,6 +188,85 @@ void FieldObject::setGridZDimention(unsigned int gridZDim)
     recalculate();
 }
 
+void FieldObject::setGridLayout(GridLayout layout)
+{
+    grid()->data()->setLayout(layout);
+    swapGrid();
+    grid()->data()->setLayout(layout);
+    swapGrid();
+}
+
+void FieldObject::setGridStorageKind(GridStorageKind kind)
+{
+    grid()->data()->setStorageKind(kind);
+    swapGrid();
+    grid()->data()->setStorageKind(kind);
+    swapGrid();
+}
+
+void FieldObject::resampleGrids(unsigned int xDim, unsigned int yDim,
+            unsigned int zDim)
+{
+    grid()->data()->resample(xDim, yDim, zDim);
+    fEvaluatedStride = 0;
+    // the other grid only receives next values, so it is not resampled
+    swapGrid();
+    grid()->data()->setDimentions(xDim, yDim, zDim);
+    swapGrid();
+
+    if (fGridKind == SPARSE_GRID)
+    {
+        // sparse grid values can not be resampled
+        recalculate();
+    }
+}
+
+void FieldObject::setGridBounds(const Point &minPoint,
+            const Point &maxPoint)
+{
+    grid()->data()->setBounds(minPoint, maxPoint);
+    fEvaluatedStride = 0;
+    swapGrid();
+    grid()->data()->setBounds(minPoint, maxPoint);
+    swapGrid();
+}
+
+void FieldObject::resetGridBounds()
+{
+    grid()->data()->resetBounds();
+    fEvaluatedStride = 0;
+    swapGrid();
+    grid()->data()->resetBounds();
+    swapGrid();
+}
+
+bool FieldObject::boundingBox(float isoLevel, unsigned int margin,
+            Point *minPoint, Point *maxPoint) const
+{
+    const Grid *currentGrid = grid()->data();
+    GridBox box = (fGridKind == SPARSE_GRID) ?
+                fSparseGrid->insidePointsBox(isoLevel) :
+                currentGrid->insidePointsBox(isoLevel);
+    if (box.xMin > box.xMax)
+    {
+        return false;
+    }
+
+    minPoint->x = currentGrid->xCoord(box.xMin) -
+                margin * currentGrid->xStep();
+    minPoint->y = currentGrid->yCoord(box.yMin) -
+                margin * currentGrid->yStep();
+    minPoint->z = currentGrid->zCoord(box.zMin) -
+                margin * currentGrid->zStep();
+    maxPoint->x = currentGrid->xCoord(box.xMax) +
+                margin * currentGrid->xStep();
+    maxPoint->y = currentGrid->yCoord(box.yMax) +
+                margin * currentGrid->yStep();
+    maxPoint->z = currentGrid->zCoord(box.zMax) +
+                margin * currentGrid->zStep();
+    return true;
+}
+
 void FieldObject::initGrids(unsigned int xDim, unsigned int yDim,
             unsigned int zDim)
 {
@@ -125,6 +274,44 @@ void FieldObject::initGrids(unsigned int xDim, unsigned int yDim,
     fGrid[1] = QSharedPointer<Grid>(new Grid(xDim, yDim, zDim));
 }
 
+void FieldObject::setGridKind(GridKind kind)
+{
+    if (fGridKind == kind)
+    {
+        return;
+    }
+
+    fGridKind = kind;
+    fEvaluatedStride = 0;
+
+    bool dense = (kind == DENSE_GRID);
+    fGrid[0]->setHoldsPoints(dense);
+    fGrid[1]->setHoldsPoints(dense);
+
+    if (dense)
+    {
+        fSparseGrid.clear();
+    }
+    else
+    {
+        const Grid *currentGrid = grid()->data();
+        fSparseGrid = QSharedPointer<SparseGrid>(new SparseGrid(
+                    currentGrid->xDimention(), currentGrid->yDimention(),
+                    currentGrid->zDimention()));
+        fSparseGrid->setBand(fSparseIsoLevel, fSparseBandWidth);
+    }
+}
+
+void FieldObject::setSparseBand(float isoLevel, float bandWidth)
+{
+    fSparseIsoLevel = isoLevel;
+    fSparseBandWidth = bandWidth;
+    if (!fSparseGrid.isNull())
+    {
+        fSparseGrid->setBand(isoLevel, bandWidth);
+    }
+}
+
 const QSharedPointer<Grid>* FieldObject::grid() const
 {
     return fGrid + fCurrentGridId;
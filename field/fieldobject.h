@@ -24,10 +24,21 @@
 #include <QSharedPointer>
 
 #include "grid.h"
+#include "sparsegrid.h"
 #include "space_types.h"
 
 class QBuffer;
 class QByteArray;
+class QString;
+
+// Kind of grid field-object values are kept in. Dense grid holds every
+// point value, sparse one holds values near isosurface only (see
+// SparseGrid), dense grid is kept for its geometry then.
+typedef enum
+{
+    DENSE_GRID = 1,
+    SPARSE_GRID
+} GridKind;
 
 // Represents the basic "field-object" type, Inherited by field and meta-object.
 // Field-object (so inherited classes too) holds 2 separate grids of same
@@ -55,11 +66,51 @@ public:
     void setGridXDimention(unsigned int gridXDim);
     void setGridYDimention(unsigned int gridYDim);
     void setGridZDimention(unsigned int gridZDim);
+    // Point values are kept, so no recalculation is needed.
+    void setGridLayout(GridLayout layout);
+    // Point values are kept, see GridStorage for storage kinds.
+    void setGridStorageKind(GridStorageKind kind);
+    // Changes grids dimentions without recalculation, current grid values
+    // are resampled from old ones (see Grid::resample()).
+    void resampleGrids(unsigned int xDim, unsigned int yDim,
+                unsigned int zDim);
+    // Sets space bounds of grids (see Grid::setBounds()), field-object has
+    // to be recalculated afterwards.
+    void setGridBounds(const Point &minPoint, const Point &maxPoint);
+    void resetGridBounds();
+    // Space box of points where field-object is inside of isoLevel
+    // isosurface, expanded by margin grid steps on each side. Returns false
+    // if there are no such points.
+    bool boundingBox(float isoLevel, unsigned int margin, Point *minPoint,
+                Point *maxPoint) const;
 
     virtual void recalculate();
+    // Evaluates field-object on a coarse lattice of given stride reusing
+    // values from previous (coarser) levels, see
+    // Grid::fillWithFieldObject(). Does nothing if grid is already finer.
+    void recalculateLevel(unsigned int stride);
+    // Stride of lattice which points are evaluated exactly, 1 if all grid
+    // points are, 0 if none (e.g. after resampling).
+    unsigned int evaluatedStride() const { return fEvaluatedStride; }
+    // Current grid takes exact values from file written by
+    // Grid::saveToFile() (see Grid::attachFile()) instead of evaluation.
+    bool attachGridFile(const QString &fileName, qint64 offset = 0);
 
     virtual const QSharedPointer<Grid>* grid() const;
 
+    GridKind gridKind() const { return fGridKind; }
+    // Field-object has to be recalculated afterwards. Sparse grid does not
+    // support swap grid approach, file attaching and progressive
+    // evaluation (it is evaluated exactly at once).
+    void setGridKind(GridKind kind);
+    // Band of values sparse grid is exact in, see SparseGrid::setBand().
+    void setSparseBand(float isoLevel, float bandWidth);
+    float sparseIsoLevel() const { return fSparseIsoLevel; }
+    float sparseBandWidth() const { return fSparseBandWidth; }
+    // Null if grid kind is dense.
+    const QSharedPointer<SparseGrid>* sparseGrid() const
+                { return &fSparseGrid; }
+
 protected:
 
     void initGrids(unsigned int xDim, unsigned int yDim, unsigned int zDim);
@@ -68,6 +119,11 @@ private: // data
     unsigned int fCurrentGridId;
     QSharedPointer<Grid> fGrid[2];
     bool fUsingExternalGrid;
+    unsigned int fEvaluatedStride;
+    GridKind fGridKind;
+    QSharedPointer<SparseGrid> fSparseGrid;
+    float fSparseIsoLevel;
+    float fSparseBandWidth;
 };
 
 #endif // FIELDOBJECT_H
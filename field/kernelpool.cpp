@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * kernelpool.cpp is part of 3D Meta-Object-based Modelling System           *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QMutexLocker>
+
+#include "kernelpool.h"
+#include "postfixexpr.h"
+
+KernelPool::KernelPool()
+{
+}
+
+QSharedPointer<PostfixExpr> KernelPool::kernel(const QString &expression)
+{
+    QMutexLocker locker(&fMutex);
+
+    QSharedPointer<PostfixExpr> &kernelPtr = fKernels[expression];
+    if (kernelPtr.isNull())
+    {
+        kernelPtr = QSharedPointer<PostfixExpr>(new PostfixExpr(expression));
+    }
+    return kernelPtr;
+}
+
+int KernelPool::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return fKernels.count();
+}
@@ -0,0 +1,54 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * kernelpool.h is part of 3D Meta-Object-based Modelling System             *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef KERNELPOOL_H
+#define KERNELPOOL_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QSharedPointer>
+
+class PostfixExpr;
+
+// Represents expressions parsed into kernels which meta-objects are built of
+// (see PostfixExpr copy constructor). Pool may be shared by fields loaded
+// concurrently (f.e. by batch jobs), so every distinct expression is parsed
+// once for all of them. Kernels are never executed, copies of them are.
+class KernelPool
+{
+public:
+    KernelPool();
+
+    // Expression is parsed on the first request, the same kernel is
+    // returned afterwards.
+    QSharedPointer<PostfixExpr> kernel(const QString &expression);
+    int count() const;
+
+private:
+    KernelPool(const KernelPool &);
+    KernelPool &operator=(const KernelPool &);
+
+private: // data
+    mutable QMutex fMutex;
+    QHash<QString, QSharedPointer<PostfixExpr> > fKernels;
+};
+
+#endif // KERNELPOOL_H
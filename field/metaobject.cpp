@@ -21,11 +21,10 @@
 
 #include <math.h>
 
-#include <QXmlQuery>
-#include <QXmlItem>
-#include <QXmlSerializer>
 #include <QBuffer>
-#include <QXmlResultItems>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QStringList>
 #include <QString>
 #include <QDebug>
 
@@ -36,6 +35,12 @@
 const char kTypeExpression[] = "expression";
 const char kTypePredefined[] = "predefined";
 
+void MetaObject::setTransform(const Transform &transform)
+{
+    fTransform = transform;
+    fHasTransform = !Transforms::isIdentity(transform);
+}
+
 PostfixExprMetaObject::PostfixExprMetaObject(unsigned int xDim,
             unsigned int yDim, unsigned int zDim,
             const QSharedPointer<PostfixExpr> &postfixExprPtr)
@@ -49,37 +54,121 @@ PostfixExprMetaObject::PostfixExprMetaObject(unsigned int xDim,
 }
 
 PostfixExprMetaObject::PostfixExprMetaObject(unsigned int xDim,
-            unsigned int yDim, unsigned int zDim, QBuffer *xmlData)
+            unsigned int yDim, unsigned int zDim, QBuffer *xmlData,
+            bool recalculateGrid)
             : MetaObject(xDim, yDim, zDim, xmlData), fIsValid(false)
 {
     fIsValid = initWithXML(xmlData);
-    if (fIsValid)
+    if (fIsValid && recalculateGrid)
+    {
+        recalculate();
+    }
+}
+
+PostfixExprMetaObject::PostfixExprMetaObject(unsigned int xDim,
+            unsigned int yDim, unsigned int zDim, const QString &expression,
+            const QMap<QString, double> &variables, bool recalculateGrid)
+            : MetaObject(xDim, yDim, zDim, 0), fIsValid(false)
+{
+    fIsValid = initWithExpression(expression, variables);
+    if (fIsValid && recalculateGrid)
     {
         recalculate();
     }
 }
 
+PostfixExprMetaObject::PostfixExprMetaObject(unsigned int xDim,
+            unsigned int yDim, unsigned int zDim, const PostfixExpr &kernel,
+            const QMap<QString, double> &variables, bool recalculateGrid)
+            : MetaObject(xDim, yDim, zDim, 0), fIsValid(false)
+{
+    QSharedPointer<PostfixExpr> exprPtr(new PostfixExpr(kernel));
+    exprPtr->variablesManager().setVariableValues(variables);
+    fIsValid = setPostfixExpression(exprPtr);
+    if (fIsValid && recalculateGrid)
+    {
+        recalculate();
+    }
+}
+
+void PostfixExprMetaObject::readXMLElement(QXmlStreamReader *reader,
+            QString *expression, QMap<QString, double> *variables,
+            Transform *transform)
+{
+    *expression = reader->attributes().value("value").toString();
+    variables->clear();
+    *transform = Transforms::identity();
+
+    int depth = 1;
+    while (depth > 0 && !reader->atEnd())
+    {
+        reader->readNext();
+        if (reader->isEndElement())
+        {
+            depth--;
+        }
+        else if (reader->isStartElement())
+        {
+            depth++;
+            if (reader->name() == QLatin1String("var"))
+            {
+                QXmlStreamAttributes attributes = reader->attributes();
+                (*variables)[attributes.value("name").toString()] =
+                            attributes.value("value").toString().toDouble();
+            }
+            else if (reader->name() == QLatin1String("transform") &&
+                        !Transforms::fromString(reader->attributes().value(
+                        "matrix").toString(), transform))
+            {
+                qWarning() << "Malformed meta-object transform, ignoring it.";
+            }
+        }
+    }
+}
+
+void PostfixExprMetaObject::writeXMLElement(QXmlStreamWriter *writer,
+            const QString &expression, const QMap<QString, double> &variables,
+            const Transform &transform)
+{
+    writer->writeStartElement("meta-object");
+    writer->writeAttribute("type", kTypeExpression);
+    writer->writeAttribute("value", expression);
+    if (!Transforms::isIdentity(transform))
+    {
+        writer->writeEmptyElement("transform");
+        writer->writeAttribute("matrix", Transforms::toString(transform));
+    }
+
+    QMap<QString, double>::const_iterator varIt = variables.constBegin();
+    for (; varIt != variables.constEnd(); ++varIt)
+    {
+        writer->writeEmptyElement("var");
+        writer->writeAttribute("name", varIt.key());
+        writer->writeAttribute("value",
+                    QString::number(varIt.value(), 'f', 6));
+    }
+    writer->writeEndElement();
+}
+
 QByteArray PostfixExprMetaObject::XMLRepresentation()
 {
     QByteArray metaObjectXMLData;
     QBuffer metaObjectXMLBuffer(&metaObjectXMLData);
     metaObjectXMLBuffer.open(QIODevice::WriteOnly);
 
-    QByteArray variablesXMLData(fUserVariablesManager.XMLRepresentation());
-    QBuffer variablesXMLBuffer(&variablesXMLData);
-    variablesXMLBuffer.open(QIODevice::ReadOnly);
-
-    QXmlQuery query;
-    QString expression(fPostfixExprPtr->infixString());
-    query.bindVariable("expr", QVariant(expression));
-    query.bindVariable("variables", &variablesXMLBuffer);
-
-    query.setQuery("<meta-object type=\"expression\" value=\"{ $expr }\">"
-                "{ fn:doc($variables)/variables/var }</meta-object>");
-    QXmlSerializer metaObjectSerializer(query, &metaObjectXMLBuffer);
-    query.evaluateTo(&metaObjectSerializer);
+    // written by stream writer, an XML query per meta-object is too slow
+    // for large fields
+    QMap<QString, double> variables;
+    QStringList variableNames(fUserVariablesManager.variableNames());
+    for (int i = 0; i < variableNames.count(); i++)
+    {
+        variables.insert(variableNames[i],
+                    fUserVariablesManager.variableValue(variableNames[i]));
+    }
 
-    variablesXMLBuffer.close();
+    QXmlStreamWriter writer(&metaObjectXMLBuffer);
+    writeXMLElement(&writer, fPostfixExprPtr->infixString(), variables,
+                transform());
     metaObjectXMLBuffer.close();
 
     return metaObjectXMLData;
@@ -87,9 +176,10 @@ QByteArray PostfixExprMetaObject::XMLRepresentation()
 
 float PostfixExprMetaObject::valueAtPoint(const Point& p)
 {
-    fTemporaryVariables["x"] = p.x;
-    fTemporaryVariables["y"] = p.y;
-    fTemporaryVariables["z"] = p.z;
+    Point sample = samplePoint(p);
+    fTemporaryVariables["x"] = sample.x;
+    fTemporaryVariables["y"] = sample.y;
+    fTemporaryVariables["z"] = sample.z;
 
     fVariablesManager.setVariableValues(fTemporaryVariables);
     return fPostfixExprPtr->execute();
@@ -107,24 +197,39 @@ QString PostfixExprMetaObject::description()
 
 bool PostfixExprMetaObject::initWithXML(QBuffer *xmlData)
 {
-    bool result = false;
+    QString expression;
+    QMap<QString, double> variables;
+    Transform transform = Transforms::identity();
 
     xmlData->open(QIODevice::ReadOnly);
-    QXmlQuery query;
-    query.bindVariable("metaObject", xmlData);
-
-    QXmlResultItems resultItems;
-    query.setQuery("fn:doc($metaObject)/meta-object/fn:data(@value)");
-    query.evaluateTo(&resultItems);
+    QXmlStreamReader reader(xmlData);
+    while (!reader.atEnd())
+    {
+        reader.readNext();
+        if (reader.isStartElement() &&
+                    reader.name() == QLatin1String("meta-object"))
+        {
+            readXMLElement(&reader, &expression, &variables, &transform);
+            break;
+        }
+    }
     xmlData->close();
 
-    QString expr(resultItems.next().toAtomicValue().toString());
-    qDebug() << "MetaObject expression = " << expr;
+    setTransform(transform);
+    return initWithExpression(expression, variables);
+}
+
+bool PostfixExprMetaObject::initWithExpression(const QString &expression,
+            const QMap<QString, double> &variables)
+{
+    bool result = false;
+
+    qDebug() << "MetaObject expression = " << expression;
 
-    QSharedPointer<PostfixExpr> exprPtr(new PostfixExpr(expr));
+    QSharedPointer<PostfixExpr> exprPtr(new PostfixExpr(expression));
     if (exprPtr->successfullyParsed())
     {
-        exprPtr->variablesManager().setVariableValuesWithXML(xmlData);
+        exprPtr->variablesManager().setVariableValues(variables);
         setPostfixExpression(exprPtr);
 
         result = true;
@@ -156,8 +261,10 @@ bool PostfixExprMetaObject::setPostfixExpression(
 
 float CylinderMetaObject::valueAtPoint(const Point& p)
 {
+    Point sample = samplePoint(p);
     float r2 = 900;
-    float d2 = (p.x * p.x + p.y * p.y + p.z * p.z);
+    float d2 = (sample.x * sample.x + sample.y * sample.y +
+                sample.z * sample.z);
     if (d2 < 0.0001) d2 = 0.0001;
     float result = r2 / d2;
 
@@ -26,10 +26,13 @@
 #include <QString>
 
 #include "fieldobject.h"
+#include "transforms.h"
 #include "variablesmanager.h"
 
 class QBuffer;
 class QByteArray;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 typedef enum
 {
@@ -45,14 +48,31 @@ class MetaObject : public FieldObject
 public:
     MetaObject(unsigned int xDim, unsigned int yDim, unsigned int zDim,
                 QBuffer *xmlData = 0)
-                : FieldObject(xDim, yDim, zDim, xmlData) {}
+                : FieldObject(xDim, yDim, zDim, xmlData),
+                fTransform(Transforms::identity()), fHasTransform(false) {}
 
     virtual VariablesManager variablesManager() = 0;
     virtual QString description() = 0;
     virtual MetaObjectType type() = 0;
 
+    // Transform is applied to sample points before evaluation, so the same
+    // expression may be placed (rotated, moved) differently by several
+    // meta-objects. It is identity by default. Meta-object has to be
+    // recalculated (see Field::updateMetaObject()) after transform change,
+    // expression is not parsed again.
+    inline const Transform &transform() const { return fTransform; }
+    inline bool hasTransform() const { return fHasTransform; }
+    void setTransform(const Transform &transform);
+
 protected:
     virtual bool initWithXML(QBuffer *xmlData) = 0;
+
+    inline Point samplePoint(const Point &p) const
+                { return fHasTransform ? Transforms::apply(fTransform, p) : p; }
+
+private:
+    Transform fTransform;
+    bool fHasTransform; // false for identity, so it costs nothing.
 };
 
 // Represent meta-object field potential values of which are defined by a
@@ -63,8 +83,36 @@ public:
     PostfixExprMetaObject(unsigned int xDim, unsigned int yDim,
                 unsigned int zDim, const QSharedPointer<PostfixExpr>
                 &postfixExprPtr);
+    // Grid may be left unevaluated to be calculated level by level later.
+    PostfixExprMetaObject(unsigned int xDim, unsigned int yDim,
+                unsigned int zDim, QBuffer *xmlData,
+                bool recalculateGrid = true);
+    // Meta-object of already read XML data, see readXMLElement().
+    PostfixExprMetaObject(unsigned int xDim, unsigned int yDim,
+                unsigned int zDim, const QString &expression,
+                const QMap<QString, double> &variables,
+                bool recalculateGrid = true);
+
+    // Meta-object has its own copy of kernel (see PostfixExpr copy
+    // constructor), so meta-objects of the same expression are built without
+    // parsing it again.
     PostfixExprMetaObject(unsigned int xDim, unsigned int yDim,
-                unsigned int zDim, QBuffer *xmlData);
+                unsigned int zDim, const PostfixExpr &kernel,
+                const QMap<QString, double> &variables,
+                bool recalculateGrid = true);
+
+    // Reads expression, variable values and transform (identity if there
+    // is no transform element) of meta-object element which start element
+    // has just been read, reader is left at its end element. So
+    // meta-objects are read in the same pass as the whole document.
+    static void readXMLElement(QXmlStreamReader *reader, QString *expression,
+                QMap<QString, double> *variables, Transform *transform);
+    // Writes meta-object element readXMLElement() reads, transform element
+    // is omitted for identity.
+    static void writeXMLElement(QXmlStreamWriter *writer,
+                const QString &expression,
+                const QMap<QString, double> &variables,
+                const Transform &transform);
 
     virtual QByteArray XMLRepresentation();
 
@@ -78,6 +126,8 @@ public:
 
 protected:
     virtual bool initWithXML(QBuffer *xmlData);
+    bool initWithExpression(const QString &expression,
+                const QMap<QString, double> &variables);
     bool setPostfixExpression(const QSharedPointer<PostfixExpr>
                 &postfixExprPtr);
 
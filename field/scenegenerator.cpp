@@ -0,0 +1,178 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * scenegenerator.cpp is part of 3D Meta-Object-based Modelling System       *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <math.h>
+
+#include <QBuffer>
+#include <QIODevice>
+#include <QXmlStreamWriter>
+
+#include "scenegenerator.h"
+#include "metaobject.h"
+
+// blade rotation is given by meta-object transform
+const char kBladeExpression[] = "R^N/((kX*x-dX)^N+(kY*y-dY)^N+(kZ*z-dZ)^N)";
+const char kAxisExpression[] = "R/sqrt((z-dZ)^2.000+(y-dY)^2.000)";
+
+void SceneGenerator::addViewElement(const QString &name,
+            const QXmlStreamAttributes &attributes)
+{
+    fViewElements.append(qMakePair(name, attributes));
+}
+
+void SceneGenerator::addMetaObject(const QString &expression,
+            const QMap<QString, double> &variables, const Transform &transform)
+{
+    addLinearArray(expression, variables, QString(), 0.0, 0.0, 1);
+    fInstances.last().transform = transform;
+}
+
+void SceneGenerator::addLinearArray(const QString &expression,
+            const QMap<QString, double> &variables,
+            const QString &instanceVariable, double firstValue, double step,
+            int count)
+{
+    int expressionIndex = fExpressions.indexOf(expression);
+    if (expressionIndex < 0)
+    {
+        expressionIndex = fExpressions.count();
+        fExpressions.append(expression);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        SceneInstance instance;
+        instance.expression = expressionIndex;
+        instance.variables = variables;
+        instance.transform = Transforms::identity();
+        if (!instanceVariable.isEmpty())
+        {
+            instance.variables[instanceVariable] = firstValue + i * step;
+        }
+        fInstances.append(instance);
+    }
+}
+
+void SceneGenerator::addCircularArray(const QString &expression,
+            const QMap<QString, double> &variables,
+            const Transform &transform, int count)
+{
+    int firstInstance = fInstances.count();
+    addLinearArray(expression, variables, QString(), 0.0, 0.0, count);
+    for (int i = 0; i < count; i++)
+    {
+        fInstances[firstInstance + i].transform = Transforms::product(
+                    transform, Transforms::rotationX(2.0 * M_PI * i / count));
+    }
+}
+
+QByteArray SceneGenerator::documentXMLData() const
+{
+    QByteArray documentXMLData;
+    QBuffer documentXMLBuffer(&documentXMLData);
+    documentXMLBuffer.open(QIODevice::WriteOnly);
+
+    QXmlStreamWriter writer(&documentXMLBuffer);
+    writer.setAutoFormatting(true);
+    writer.setAutoFormattingIndent(4);
+    writer.writeStartDocument();
+    writer.writeStartElement("document");
+    writer.writeAttribute("type", "meta-objects");
+    writer.writeAttribute("name", "not-used");
+
+    writer.writeStartElement("view");
+    for (int i = 0; i < fViewElements.count(); i++)
+    {
+        writer.writeEmptyElement(fViewElements[i].first);
+        writer.writeAttributes(fViewElements[i].second);
+    }
+    writer.writeEndElement();
+
+    writer.writeStartElement("field");
+    for (int i = 0; i < fInstances.count(); i++)
+    {
+        const SceneInstance &instance = fInstances[i];
+        PostfixExprMetaObject::writeXMLElement(&writer,
+                    fExpressions[instance.expression], instance.variables,
+                    instance.transform);
+    }
+    writer.writeEndElement();
+
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    documentXMLBuffer.close();
+
+    return documentXMLData;
+}
+
+SceneGenerator SceneGenerator::propeller(int bladeCount, double bladeTilt,
+            double axisRadius, unsigned int yzDim)
+{
+    SceneGenerator generator;
+
+    QXmlStreamAttributes gridAttributes;
+    gridAttributes.append("dimX", "40");
+    gridAttributes.append("dimY", QString::number(yzDim));
+    gridAttributes.append("dimZ", QString::number(yzDim));
+    gridAttributes.append("isoMult", "0.2");
+    gridAttributes.append("iso", "3");
+    generator.addViewElement("grid", gridAttributes);
+
+    QXmlStreamAttributes cameraAttributes;
+    cameraAttributes.append("rotX", "9");
+    cameraAttributes.append("rotY", "0");
+    cameraAttributes.append("rotZ", "0");
+    cameraAttributes.append("scaleMult", "0.1900");
+    cameraAttributes.append("scale", "3");
+    generator.addViewElement("camera", cameraAttributes);
+
+    QXmlStreamAttributes displayAttributes;
+    displayAttributes.append("axises", "false");
+    displayAttributes.append("polygonMode", "faces");
+    displayAttributes.append("normalMode", "smooth");
+    generator.addViewElement("display", displayAttributes);
+
+    QXmlStreamAttributes colorsAttributes;
+    colorsAttributes.append("background", "#0f0f0f");
+    colorsAttributes.append("light1", "#ffff00");
+    colorsAttributes.append("light2", "#bbbb00");
+    generator.addViewElement("colors", colorsAttributes);
+
+    // blade is tilted around z axis after its turn around x one
+    QMap<QString, double> bladeVariables;
+    bladeVariables.insert("N", 4.0);
+    bladeVariables.insert("R", 7.0);
+    bladeVariables.insert("dX", 0.0);
+    bladeVariables.insert("dY", 0.0);
+    bladeVariables.insert("dZ", 11.5);
+    bladeVariables.insert("kX", 1.0);
+    bladeVariables.insert("kY", 7.0);
+    bladeVariables.insert("kZ", 0.5);
+    generator.addCircularArray(kBladeExpression, bladeVariables,
+                Transforms::rotationZ(bladeTilt), bladeCount);
+
+    QMap<QString, double> axisVariables;
+    axisVariables.insert("R", axisRadius);
+    axisVariables.insert("dY", 0.0);
+    axisVariables.insert("dZ", 0.0);
+    generator.addMetaObject(kAxisExpression, axisVariables);
+
+    return generator;
+}
@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * scenegenerator.h is part of 3D Meta-Object-based Modelling System         *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SCENEGENERATOR_H
+#define SCENEGENERATOR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QXmlStreamAttributes>
+
+#include "transforms.h"
+
+// Meta-object of generated scene, instances of the same expression differ by
+// variable values and transform only.
+typedef struct
+{
+    int expression; // index in generator's expressions.
+    QMap<QString, double> variables;
+    Transform transform;
+} SceneInstance;
+
+// Represents generator of meta-object documents (f.e. propellers). A
+// meta-object may be instanced by a pattern (array), instances get their own
+// transforms or values of some variables ("uniforms") and share expression
+// text, so generated document is parsed once per expression on loading (see
+// Field) instead of once per meta-object.
+class SceneGenerator
+{
+public:
+    SceneGenerator() {}
+
+    // Element of document view (see ViewController), f.e. grid.
+    void addViewElement(const QString &name,
+                const QXmlStreamAttributes &attributes);
+
+    void addMetaObject(const QString &expression,
+                const QMap<QString, double> &variables,
+                const Transform &transform = Transforms::identity());
+    // Variable of i-th instance gets firstValue + i * step value, other
+    // variables are the same for all instances.
+    void addLinearArray(const QString &expression,
+                const QMap<QString, double> &variables,
+                const QString &instanceVariable, double firstValue,
+                double step, int count);
+    // Instances are spread around x axis by full turn, sample points of i-th
+    // instance are rotated by 2 * pi * i / count angle before given
+    // transform is applied.
+    void addCircularArray(const QString &expression,
+                const QMap<QString, double> &variables,
+                const Transform &transform, int count);
+
+    inline int metaObjectCount() const { return fInstances.count(); }
+    // Document in the format main window saves.
+    QByteArray documentXMLData() const;
+
+    // Propeller of bladeCount tilted blades on an axis cylinder (see
+    // "--generate propeller" in main.cpp).
+    static SceneGenerator propeller(int bladeCount, double bladeTilt,
+                double axisRadius, unsigned int yzDim = 80);
+
+private:
+    QList<QPair<QString, QXmlStreamAttributes> > fViewElements;
+    QStringList fExpressions;
+    QList<SceneInstance> fInstances;
+};
+
+#endif // SCENEGENERATOR_H
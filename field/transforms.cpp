@@ -0,0 +1,150 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * transforms.cpp is part of 3D Meta-Object-based Modelling System           *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <math.h>
+
+#include <QStringList>
+
+#include "transforms.h"
+
+namespace Rotation
+{
+    // Rotation in plane of axises first and second (x is 0, y is 1, z is 2),
+    // first axis turns to the second one.
+    Transform inPlane(int first, int second, float angle)
+    {
+        Transform result = Transforms::identity();
+        float c = cos(angle);
+        float s = sin(angle);
+        result.m[first][first] = c;
+        result.m[first][second] = -s;
+        result.m[second][first] = s;
+        result.m[second][second] = c;
+        return result;
+    }
+}
+
+Transform Transforms::identity()
+{
+    Transform result;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            result.m[row][column] = (row == column) ? 1.0 : 0.0;
+        }
+    }
+    return result;
+}
+
+Transform Transforms::rotationX(float angle)
+{
+    return Rotation::inPlane(1, 2, angle);
+}
+
+Transform Transforms::rotationY(float angle)
+{
+    return Rotation::inPlane(2, 0, angle);
+}
+
+Transform Transforms::rotationZ(float angle)
+{
+    return Rotation::inPlane(0, 1, angle);
+}
+
+Transform Transforms::translation(const Point &offset)
+{
+    Transform result = identity();
+    result.m[0][3] = offset.x;
+    result.m[1][3] = offset.y;
+    result.m[2][3] = offset.z;
+    return result;
+}
+
+Transform Transforms::product(const Transform &first,
+            const Transform &second)
+{
+    Transform result;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            // implicit last row of matrixes is (0, 0, 0, 1)
+            float value = (column == 3) ? first.m[row][3] : 0.0;
+            for (int i = 0; i < 3; i++)
+            {
+                value += first.m[row][i] * second.m[i][column];
+            }
+            result.m[row][column] = value;
+        }
+    }
+    return result;
+}
+
+bool Transforms::isIdentity(const Transform &transform)
+{
+    Transform identityTransform = identity();
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            if (transform.m[row][column] !=
+                        identityTransform.m[row][column])
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QString Transforms::toString(const Transform &transform)
+{
+    QStringList values;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            values.append(QString::number(transform.m[row][column], 'f', 6));
+        }
+    }
+    return values.join(" ");
+}
+
+bool Transforms::fromString(const QString &string, Transform *transform)
+{
+    QStringList values(string.simplified().split(' '));
+    if (values.count() != 12)
+    {
+        return false;
+    }
+
+    Transform result;
+    bool ok = true;
+    for (int i = 0; ok && i < 12; i++)
+    {
+        result.m[i / 4][i % 4] = values[i].toFloat(&ok);
+    }
+    if (ok)
+    {
+        *transform = result;
+    }
+    return ok;
+}
@@ -0,0 +1,58 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * transforms.h is part of 3D Meta-Object-based Modelling System             *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <QString>
+
+#include "space_types.h"
+
+// Represents set of functions which make, combine and apply affine
+// transforms. Rotations are counterclockwise when looking from the positive
+// end of an axis, angles are in radians.
+namespace Transforms
+{
+    Transform identity();
+    Transform rotationX(float angle);
+    Transform rotationY(float angle);
+    Transform rotationZ(float angle);
+    Transform translation(const Point &offset);
+    // Transform which applies second one and then first one.
+    Transform product(const Transform &first, const Transform &second);
+    bool isIdentity(const Transform &transform);
+
+    inline Point apply(const Transform &transform, const Point &p)
+    {
+        const float (*m)[4] = transform.m;
+        Point result = {
+                    m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                    m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                    m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3] };
+        return result;
+    }
+
+    // 12 matrix values row by row separated by spaces, as in XML documents.
+    QString toString(const Transform &transform);
+    // Returns false (transform is not changed) if string is malformed.
+    bool fromString(const QString &string, Transform *transform);
+}
+
+#endif // TRANSFORMS_H
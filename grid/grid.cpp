@@ -19,11 +19,15 @@
 \* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include <QDebug>
+#include <QFile>
+#include <QString>
 
 #include "grid.h"
+#include "gridkernels.h"
 #include "fieldobject.h"
 #include "space_types.h"
 
@@ -48,12 +52,57 @@ namespace Util
     {
         return ceilf(0.5 * dim * step);
     }
+
+    inline bool isLatticePosition(unsigned int pos, unsigned int stride,
+                unsigned int dim)
+    {
+        return pos % stride == 0 || pos == dim - 1;
+    }
+
+    // Next lattice position, dim if pos is the last one.
+    inline unsigned int nextLatticePosition(unsigned int pos,
+                unsigned int stride, unsigned int dim)
+    {
+        if (pos == dim - 1)
+        {
+            return dim;
+        }
+        return qMin(pos - pos % stride + stride, dim - 1);
+    }
+}
+
+namespace GridFile
+{
+    const char kMagic[8] = { 'D', 'I', 'P', '2', 'G', 'R', 'I', 'D' };
+    const unsigned int kVersion = 1;
+
+    typedef struct
+    {
+        char magic[8];
+        unsigned int version;
+        unsigned int layout;
+        unsigned int xDim;
+        unsigned int yDim;
+        unsigned int zDim;
+        float xMin;
+        float xMax;
+        float yMin;
+        float yMax;
+        float zMin;
+        float zMax;
+        unsigned int reserved;
+        GridIndex storageSize;
+    } Header; // point values follow the header.
 }
 
 using namespace Util;
+using namespace GridFile;
 
-Grid::Grid(unsigned int xDim, unsigned int yDim, unsigned int zDim)
-            : fPointValues(0),
+Grid::Grid(unsigned int xDim, unsigned int yDim, unsigned int zDim,
+            GridLayout layout)
+            : fHoldsPoints(true), fPointValues(0), fStorageSize(0),
+            fLayout(layout),
+            fXBricks(0), fYBricks(0), fZBricks(0), fExplicitBounds(false),
             fXMin(kMin), fXMax(kMax), fXDim(xDim),
             fYMin(kMin), fYMax(kMax), fYDim(yDim),
             fZMin(kMin), fZMax(kMax), fZDim(zDim)
@@ -67,19 +116,114 @@ Grid::~Grid()
     freePoints();
 }
 
+void Grid::setLayout(GridLayout layout)
+{
+    if (fLayout == layout)
+    {
+        return;
+    }
+
+    if (!fHoldsPoints)
+    {
+        fLayout = layout;
+        allocatePoints();
+        return;
+    }
+
+    GridIndex thisPointCount = pointCount();
+    float *linearValues = new float[thisPointCount];
+
+    GridIndex index = 0;
+    unsigned int xPos, yPos, zPos;
+    for (zPos = 0; zPos < fZDim; zPos++)
+    {
+        for (yPos = 0; yPos < fYDim; yPos++)
+        {
+            for (xPos = 0; xPos < fXDim; xPos++)
+            {
+                linearValues[index] = fPointValues[pointIndex(xPos, yPos,
+                            zPos)];
+                index++;
+            }
+        }
+    }
+
+    freePoints();
+    fLayout = layout;
+    allocatePoints();
+
+    index = 0;
+    for (zPos = 0; zPos < fZDim; zPos++)
+    {
+        for (yPos = 0; yPos < fYDim; yPos++)
+        {
+            for (xPos = 0; xPos < fXDim; xPos++)
+            {
+                fPointValues[pointIndex(xPos, yPos, zPos)] =
+                            linearValues[index];
+                index++;
+            }
+        }
+    }
+
+    delete[] linearValues;
+}
+
+void Grid::setStorageKind(GridStorageKind kind)
+{
+    if (fStorage.kind() == kind)
+    {
+        return;
+    }
+
+    if (!fHoldsPoints)
+    {
+        fStorage.setKind(kind);
+        return;
+    }
+
+    float *values = new float[fStorageSize];
+    memcpy(values, fPointValues, fStorageSize * sizeof(float));
+
+    freePoints();
+    fStorage.setKind(kind);
+    allocatePoints();
+
+    memcpy(fPointValues, values, fStorageSize * sizeof(float));
+    delete[] values;
+}
+
+void Grid::setHoldsPoints(bool holdsPoints)
+{
+    if (fHoldsPoints == holdsPoints)
+    {
+        return;
+    }
+
+    freePoints();
+    fHoldsPoints = holdsPoints;
+    allocatePoints();
+}
+
 void Grid::calculateSteps()
 {
-    fXStep = sideStep();
-    fXMin = axisMin(fXDim, fXStep);
-    fXMax = axisMax(fXDim, fXStep);
+    calculateAxis(fXDim, &fXMin, &fXMax, &fXStep);
+    calculateAxis(fYDim, &fYMin, &fYMax, &fYStep);
+    calculateAxis(fZDim, &fZMin, &fZMax, &fZStep);
+}
 
-    fYStep = sideStep();
-    fYMin = axisMin(fYDim, fYStep);
-    fYMax = axisMax(fYDim, fYStep);
+void Grid::calculateAxis(unsigned int dim, float *min, float *max,
+            float *step)
+{
+    if (fExplicitBounds)
+    {
+        *step = (*max - *min) / qMax(dim - 1, 1u);
+        return;
+    }
 
-    fZStep = sideStep();
-    fZMin = axisMin(fZDim, fZStep);
-    fZMax = axisMax(fZDim, fZStep);
+    *step = sideStep();
+    *min = axisMin(dim, *step);
+    *max = axisMax(dim, *step);
 }
 
 void Grid::setSidesDimention(int dim)
@@ -94,12 +238,60 @@ void Grid::setSidesDimention(int dim)
     allocatePoints();
 }
 
+void Grid::setDimentions(unsigned int xDim, unsigned int yDim,
+            unsigned int zDim)
+{
+    fXDim = xDim;
+    fYDim = yDim;
+    fZDim = zDim;
+
+    calculateSteps();
+
+    freePoints();
+    allocatePoints();
+}
+
+void Grid::resample(unsigned int xDim, unsigned int yDim, unsigned int zDim)
+{
+    if (!fHoldsPoints)
+    {
+        setDimentions(xDim, yDim, zDim);
+        return;
+    }
+
+    Grid source(fXDim, fYDim, fZDim, fLayout);
+    if (fExplicitBounds)
+    {
+        Point minPoint = { fXMin, fYMin, fZMin };
+        Point maxPoint = { fXMax, fYMax, fZMax };
+        source.setBounds(minPoint, maxPoint);
+    }
+    source.addGrid(this);
+
+    setDimentions(xDim, yDim, zDim);
+
+    Point p;
+    unsigned int xPos, yPos, zPos;
+    for (zPos = 0; zPos < fZDim; zPos++)
+    {
+        p.z = zCoord(zPos);
+        for (yPos = 0; yPos < fYDim; yPos++)
+        {
+            p.y = yCoord(yPos);
+            for (xPos = 0; xPos < fXDim; xPos++)
+            {
+                p.x = xCoord(xPos);
+                fPointValues[pointIndex(xPos, yPos, zPos)] =
+                            source.interpolatedValue(p);
+            }
+        }
+    }
+}
+
 void Grid::setXDimention(int xDim)
 {
     fXDim = xDim;
-    fXStep = sideStep();
-    fXMin = axisMin(fXDim, fXStep);
-    fXMax = axisMax(fXDim, fXStep);
+    calculateAxis(fXDim, &fXMin, &fXMax, &fXStep);
 
     freePoints();
     allocatePoints();
@@ -108,9 +300,7 @@ void Grid::setXDimention(int xDim)
 void Grid::setYDimention(int yDim)
 {
     fYDim = yDim;
-    fYStep = sideStep();
-    fYMin = axisMin(fYDim, fYStep);
-    fYMax = axisMax(fYDim, fYStep);
+    calculateAxis(fYDim, &fYMin, &fYMax, &fYStep);
 
     freePoints();
     allocatePoints();
@@ -119,15 +309,428 @@ void Grid::setYDimention(int yDim)
 void Grid::setZDimention(int zDim)
 {
     fZDim = zDim;
-    fZStep = sideStep();
-    fZMin = axisMin(fZDim, fZStep);
-    fZMax = axisMax(fZDim, fZStep);
+    calculateAxis(fZDim, &fZMin, &fZMax, &fZStep);
 
     freePoints();
     allocatePoints();
 }
 
+void Grid::setBounds(const Point &minPoint, const Point &maxPoint)
+{
+    if (minPoint.x >= maxPoint.x || minPoint.y >= maxPoint.y ||
+                minPoint.z >= maxPoint.z)
+    {
+        qWarning() << "Grid::setBounds(): empty bounds are ignored";
+        return;
+    }
+
+    fExplicitBounds = true;
+    fXMin = minPoint.x;
+    fXMax = maxPoint.x;
+    fYMin = minPoint.y;
+    fYMax = maxPoint.y;
+    fZMin = minPoint.z;
+    fZMax = maxPoint.z;
+    calculateSteps();
+
+    zeroizePoints();
+}
+
+void Grid::resetBounds()
+{
+    fExplicitBounds = false;
+    calculateSteps();
+
+    zeroizePoints();
+}
+
+bool Grid::hasSameBounds(const Grid *grid) const
+{
+    return fExplicitBounds == grid->fExplicitBounds &&
+                fXMin == grid->fXMin && fXMax == grid->fXMax &&
+                fYMin == grid->fYMin && fYMax == grid->fYMax &&
+                fZMin == grid->fZMin && fZMax == grid->fZMax;
+}
+
+float Grid::interpolatedValue(const Point &p) const
+{
+    float xPos = qBound(0.0f, (p.x - fXMin) / fXStep, fXDim - 1.0f);
+    float yPos = qBound(0.0f, (p.y - fYMin) / fYStep, fYDim - 1.0f);
+    float zPos = qBound(0.0f, (p.z - fZMin) / fZStep, fZDim - 1.0f);
+
+    unsigned int x0 = static_cast<unsigned int>(xPos);
+    unsigned int y0 = static_cast<unsigned int>(yPos);
+    unsigned int z0 = static_cast<unsigned int>(zPos);
+    unsigned int x1 = qMin(x0 + 1, fXDim - 1);
+    unsigned int y1 = qMin(y0 + 1, fYDim - 1);
+    unsigned int z1 = qMin(z0 + 1, fZDim - 1);
+
+    float u = xPos - x0;
+    float v = yPos - y0;
+    float w = zPos - z0;
+
+    const float *values = fPointValues;
+    float value00 = values[pointIndex(x0, y0, z0)] * (1 - u) +
+                values[pointIndex(x1, y0, z0)] * u;
+    float value10 = values[pointIndex(x0, y1, z0)] * (1 - u) +
+                values[pointIndex(x1, y1, z0)] * u;
+    float value01 = values[pointIndex(x0, y0, z1)] * (1 - u) +
+                values[pointIndex(x1, y0, z1)] * u;
+    float value11 = values[pointIndex(x0, y1, z1)] * (1 - u) +
+                values[pointIndex(x1, y1, z1)] * u;
+
+    return (value00 * (1 - v) + value10 * v) * (1 - w) +
+                (value01 * (1 - v) + value11 * v) * w;
+}
+
+GridBox Grid::cellsBox() const
+{
+    GridBox box = { 0, (int)fXDim - 2, 0, (int)fYDim - 2, 0, (int)fZDim - 2 };
+    return box;
+}
+
+GridBox Grid::cellsBoxOfPoints(const GridBox &pointsBox) const
+{
+    // point p is vertex of cells p - 1 and p
+    GridBox box = {
+        qMax(pointsBox.xMin - 1, 0), qMin(pointsBox.xMax, (int)fXDim - 2),
+        qMax(pointsBox.yMin - 1, 0), qMin(pointsBox.yMax, (int)fYDim - 2),
+        qMax(pointsBox.zMin - 1, 0), qMin(pointsBox.zMax, (int)fZDim - 2) };
+    return box;
+}
+
+GridBox Grid::differentPointsBox(const Grid *grid) const
+{
+    GridBox box = { (int)fXDim, -1, (int)fYDim, -1, (int)fZDim, -1 };
+
+    if (fXDim != grid->fXDim || fYDim != grid->fYDim || fZDim != grid->fZDim)
+    {
+        GridBox wholeBox = { 0, (int)fXDim - 1, 0, (int)fYDim - 1,
+                    0, (int)fZDim - 1 };
+        return wholeBox;
+    }
+
+    float *rowBuffers = new float[2 * fXDim];
+
+    int xPos, yPos, zPos;
+    for (zPos = 0; zPos < (int)fZDim; zPos++)
+    {
+        for (yPos = 0; yPos < (int)fYDim; yPos++)
+        {
+            const float *values = rowValues(0, yPos, zPos, fXDim,
+                        rowBuffers);
+            const float *otherValues = grid->rowValues(0, yPos, zPos, fXDim,
+                        rowBuffers + fXDim);
+
+            int rowMin = -1;
+            int rowMax = -1;
+            for (xPos = 0; xPos < (int)fXDim; xPos++)
+            {
+                if (values[xPos] != otherValues[xPos])
+                {
+                    if (rowMin < 0)
+                    {
+                        rowMin = xPos;
+                    }
+                    rowMax = xPos;
+                }
+            }
+
+            if (rowMin >= 0)
+            {
+                box.xMin = qMin(box.xMin, rowMin);
+                box.xMax = qMax(box.xMax, rowMax);
+                box.yMin = qMin(box.yMin, yPos);
+                box.yMax = qMax(box.yMax, yPos);
+                box.zMin = qMin(box.zMin, zPos);
+                box.zMax = qMax(box.zMax, zPos);
+            }
+        }
+    }
+
+    delete[] rowBuffers;
+
+    return box;
+}
+
+bool Grid::saveToFile(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    return saveToDevice(&file);
+}
+
+bool Grid::saveToDevice(QIODevice *device) const
+{
+    if (!fHoldsPoints)
+    {
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.layout = fLayout;
+    header.xDim = fXDim;
+    header.yDim = fYDim;
+    header.zDim = fZDim;
+    header.xMin = fXMin;
+    header.xMax = fXMax;
+    header.yMin = fYMin;
+    header.yMax = fYMax;
+    header.zMin = fZMin;
+    header.zMax = fZMax;
+    header.storageSize = fStorageSize;
+
+    qint64 valuesSize = fStorageSize * sizeof(float);
+    return device->write(reinterpret_cast<const char *>(&header),
+                sizeof(header)) == sizeof(header) &&
+                device->write(reinterpret_cast<const char *>(fPointValues),
+                valuesSize) == valuesSize;
+}
+
+bool Grid::attachFile(const QString &fileName, qint64 offset)
+{
+    QFile file(fileName);
+    Header header;
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(offset) ||
+                file.read(reinterpret_cast<char *>(&header),
+                sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+    file.close();
+
+    if (!fHoldsPoints || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+                header.version != kVersion ||
+                header.layout != static_cast<unsigned int>(fLayout) ||
+                header.xDim != fXDim || header.yDim != fYDim ||
+                header.zDim != fZDim || header.xMin != fXMin ||
+                header.xMax != fXMax || header.yMin != fYMin ||
+                header.yMax != fYMax || header.zMin != fZMin ||
+                header.zMax != fZMax || header.storageSize != fStorageSize)
+    {
+        return false;
+    }
+
+    float *values = fStorage.attachFile(fileName, offset + sizeof(header),
+                fStorageSize);
+    if (!values)
+    {
+        return false;
+    }
+
+    fPointValues = values;
+    return true;
+}
+
+GridBox Grid::insidePointsBox(float isoLevel) const
+{
+    GridBox box = { (int)fXDim, -1, (int)fYDim, -1, (int)fZDim, -1 };
+
+    float *rowBuffer = new float[fXDim];
+
+    int xPos, yPos, zPos;
+    for (zPos = 0; zPos < (int)fZDim; zPos++)
+    {
+        for (yPos = 0; yPos < (int)fYDim; yPos++)
+        {
+            const float *values = rowValues(0, yPos, zPos, fXDim, rowBuffer);
+
+            int rowMin = -1;
+            int rowMax = -1;
+            for (xPos = 0; xPos < (int)fXDim; xPos++)
+            {
+                if (values[xPos] >= isoLevel)
+                {
+                    if (rowMin < 0)
+                    {
+                        rowMin = xPos;
+                    }
+                    rowMax = xPos;
+                }
+            }
+
+            if (rowMin >= 0)
+            {
+                box.xMin = qMin(box.xMin, rowMin);
+                box.xMax = qMax(box.xMax, rowMax);
+                box.yMin = qMin(box.yMin, yPos);
+                box.yMax = qMax(box.yMax, yPos);
+                box.zMin = qMin(box.zMin, zPos);
+                box.zMax = qMax(box.zMax, zPos);
+            }
+        }
+    }
+
+    delete[] rowBuffer;
+
+    return box;
+}
+
+const float *Grid::rowValues(unsigned int xPos, unsigned int yPos,
+            unsigned int zPos, unsigned int count, float *buffer) const
+{
+    if (fLayout == LINEAR_LAYOUT)
+    {
+        return fPointValues + pointIndex(xPos, yPos, zPos);
+    }
+
+    // row crosses bricks, it is contiguous inside of each of them
+    unsigned int copied = 0;
+    while (copied < count)
+    {
+        unsigned int brickXPos = xPos + copied;
+        unsigned int runLength = qMin(count - copied,
+                    kBrickSide - (brickXPos & (kBrickSide - 1)));
+        memcpy(buffer + copied,
+                    fPointValues + pointIndex(brickXPos, yPos, zPos),
+                    runLength * sizeof(float));
+        copied += runLength;
+    }
+    return buffer;
+}
+
 void Grid::fillWithFieldObject(FieldObject *fieldObject)
+{
+    if (fLayout == BRICKED_LAYOUT)
+    {
+        fillBricked(fieldObject);
+    }
+    else
+    {
+        fillLinear(fieldObject);
+    }
+}
+
+void Grid::fillWithFieldObject(FieldObject *fieldObject, unsigned int stride,
+            unsigned int evaluatedStride)
+{
+    if (stride <= 1 && evaluatedStride == 0)
+    {
+        fillWithFieldObject(fieldObject);
+        return;
+    }
+    stride = qMax(stride, 1u);
+
+    Point p = { 0.0, 0.0, 0.0 };
+
+    unsigned int xPos, yPos, zPos;
+    for (zPos = 0; zPos < fZDim;
+                zPos = nextLatticePosition(zPos, stride, fZDim))
+    {
+        p.z = zCoord(zPos);
+        bool zEvaluated = evaluatedStride &&
+                    isLatticePosition(zPos, evaluatedStride, fZDim);
+
+        for (yPos = 0; yPos < fYDim;
+                    yPos = nextLatticePosition(yPos, stride, fYDim))
+        {
+            p.y = yCoord(yPos);
+            bool yzEvaluated = zEvaluated &&
+                        isLatticePosition(yPos, evaluatedStride, fYDim);
+
+            for (xPos = 0; xPos < fXDim;
+                        xPos = nextLatticePosition(xPos, stride, fXDim))
+            {
+                if (yzEvaluated &&
+                            isLatticePosition(xPos, evaluatedStride, fXDim))
+                {
+                    continue;
+                }
+
+                p.x = xCoord(xPos);
+                fPointValues[pointIndex(xPos, yPos, zPos)] =
+                            fieldObject->valueAtPoint(p);
+            }
+        }
+    }
+
+    if (stride > 1)
+    {
+        interpolateFromLattice(stride);
+    }
+}
+
+void Grid::addGrid(const Grid *grid)
+{
+    QVector<const Grid *> grids(1, grid);
+    combineGrids(grids, QVector<float>(1, 1.0));
+}
+
+void Grid::subtractGrid(const Grid *grid)
+{
+    QVector<const Grid *> grids(1, grid);
+    combineGrids(grids, QVector<float>(1, -1.0));
+}
+
+void Grid::replaceGrid(const Grid *oldGrid, const Grid *newGrid)
+{
+    QVector<const Grid *> grids;
+    grids << oldGrid << newGrid;
+    QVector<float> factors;
+    factors << -1.0 << 1.0;
+    combineGrids(grids, factors);
+}
+
+void Grid::addGrids(const QVector<const Grid *> &grids)
+{
+    combineGrids(grids, QVector<float>(grids.count(), 1.0));
+}
+
+void Grid::zeroizePoints()
+{
+    if (fPointValues)
+    {
+        GridKernels::combine(fPointValues, fStorageSize,
+                    QVector<const float *>(), QVector<float>(), true);
+    }
+}
+
+void Grid::allocatePoints()
+{
+    fXBricks = (fXDim + kBrickSide - 1) >> kBrickSideBits;
+    fYBricks = (fYDim + kBrickSide - 1) >> kBrickSideBits;
+    fZBricks = (fZDim + kBrickSide - 1) >> kBrickSideBits;
+
+    if (fLayout == BRICKED_LAYOUT)
+    {
+        fStorageSize = static_cast<GridIndex>(fXBricks) * fYBricks *
+                    fZBricks * kBrickPointCount;
+    }
+    else
+    {
+        fStorageSize = pointCount();
+    }
+
+    if (!fHoldsPoints)
+    {
+        return;
+    }
+
+    fPointValues = fStorage.allocate(fStorageSize);
+    if (!fPointValues)
+    {
+        qWarning() << "Grid: can not allocate" << fXDim << "x" << fYDim <<
+                    "x" << fZDim << "points";
+    }
+    Q_CHECK_PTR(fPointValues);
+
+    zeroizePoints();
+}
+
+void Grid::freePoints()
+{
+    fStorage.free();
+    fPointValues = 0;
+}
+
+void Grid::fillLinear(FieldObject *fieldObject)
 {
     Point p = { 0.0, 0.0, 0.0 };
 
@@ -135,7 +738,7 @@ void Grid::fillWithFieldObject(FieldObject *fieldObject)
     unsigned int yPos = 0;
     unsigned int xPos = 0;
 
-    unsigned int index = 0;
+    GridIndex index = 0;
 
     //#pragma omp parallel for
     for(zPos = 0; zPos < fZDim; zPos++)
@@ -161,70 +764,146 @@ void Grid::fillWithFieldObject(FieldObject *fieldObject)
     }
 }
 
-void Grid::addGrid(const Grid *grid)
+void Grid::interpolateFromLattice(unsigned int stride)
 {
-    unsigned int thisPointCount = pointCount();
-    if ( fPointValues && grid->fPointValues &&
-                (thisPointCount == grid->pointCount()) )
+    unsigned int xPos, yPos, zPos;
+    for (zPos = 0; zPos < fZDim; zPos++)
     {
-        for(unsigned int i = 0; i < thisPointCount; i++)
+        unsigned int z0 = zPos - zPos % stride;
+        unsigned int z1 = (zPos == z0) ? z0 : qMin(z0 + stride, fZDim - 1);
+        float w = (z1 == z0) ? 0.0 : float(zPos - z0) / (z1 - z0);
+
+        for (yPos = 0; yPos < fYDim; yPos++)
         {
-            fPointValues[i] += grid->fPointValues[i];
+            unsigned int y0 = yPos - yPos % stride;
+            unsigned int y1 = (yPos == y0) ? y0 :
+                        qMin(y0 + stride, fYDim - 1);
+            float v = (y1 == y0) ? 0.0 : float(yPos - y0) / (y1 - y0);
+
+            for (xPos = 0; xPos < fXDim; xPos++)
+            {
+                if (isLatticePosition(xPos, stride, fXDim) &&
+                            isLatticePosition(yPos, stride, fYDim) &&
+                            isLatticePosition(zPos, stride, fZDim))
+                {
+                    continue;
+                }
+
+                unsigned int x0 = xPos - xPos % stride;
+                unsigned int x1 = (xPos == x0) ? x0 :
+                            qMin(x0 + stride, fXDim - 1);
+                float u = (x1 == x0) ? 0.0 : float(xPos - x0) / (x1 - x0);
+
+                const float *values = fPointValues;
+                float value00 = values[pointIndex(x0, y0, z0)] * (1 - u) +
+                            values[pointIndex(x1, y0, z0)] * u;
+                float value10 = values[pointIndex(x0, y1, z0)] * (1 - u) +
+                            values[pointIndex(x1, y1, z0)] * u;
+                float value01 = values[pointIndex(x0, y0, z1)] * (1 - u) +
+                            values[pointIndex(x1, y0, z1)] * u;
+                float value11 = values[pointIndex(x0, y1, z1)] * (1 - u) +
+                            values[pointIndex(x1, y1, z1)] * u;
+
+                fPointValues[pointIndex(xPos, yPos, zPos)] =
+                            (value00 * (1 - v) + value10 * v) * (1 - w) +
+                            (value01 * (1 - v) + value11 * v) * w;
+            }
         }
     }
-    else
-    {
-        printf("Different point counts or no points! Doing noting.\n");
-        printf("Self point count = %i.\n", thisPointCount);
-        printf("Operand point count = %i.\n", grid->pointCount());
-    }
 }
 
-void Grid::subtractGrid(const Grid *grid)
+void Grid::fillBricked(FieldObject *fieldObject)
 {
-    unsigned int thisPointCount = pointCount();
-    if ( fPointValues && grid->fPointValues &&
-                (thisPointCount == grid->pointCount()) )
+    Point p = { 0.0, 0.0, 0.0 };
+
+    // points are evaluated in storage order, brick after brick
+    unsigned int xBrick, yBrick, zBrick;
+    unsigned int xPos, yPos, zPos;
+    for (zBrick = 0; zBrick < fZBricks; zBrick++)
     {
-        for(unsigned int i = 0; i < thisPointCount; i++)
+        unsigned int zFirst = zBrick << kBrickSideBits;
+        unsigned int zLast = qMin(zFirst + kBrickSide, fZDim);
+        for (yBrick = 0; yBrick < fYBricks; yBrick++)
         {
-            fPointValues[i] -= grid->fPointValues[i];
+            unsigned int yFirst = yBrick << kBrickSideBits;
+            unsigned int yLast = qMin(yFirst + kBrickSide, fYDim);
+            for (xBrick = 0; xBrick < fXBricks; xBrick++)
+            {
+                unsigned int xFirst = xBrick << kBrickSideBits;
+                unsigned int xLast = qMin(xFirst + kBrickSide, fXDim);
+                for (zPos = zFirst; zPos < zLast; zPos++)
+                {
+                    p.z = zCoord(zPos);
+                    for (yPos = yFirst; yPos < yLast; yPos++)
+                    {
+                        p.y = yCoord(yPos);
+                        float *values = fPointValues +
+                                    pointIndex(xFirst, yPos, zPos);
+                        for (xPos = xFirst; xPos < xLast; xPos++)
+                        {
+                            p.x = xCoord(xPos);
+                            values[xPos - xFirst] =
+                                        fieldObject->valueAtPoint(p);
+                        }
+                    }
+                }
+            }
         }
     }
-    else
-    {
-        printf("Different point counts or no points! Doing noting.\n");
-        printf("Self point count = %i.\n", thisPointCount);
-        printf("Operand point count = %i.\n", grid->pointCount());
-    }
 }
 
-void Grid::zeroizePoints()
+void Grid::combineGrids(const QVector<const Grid *> &grids,
+            const QVector<float> &factors)
 {
-    if (fPointValues)
+    QVector<const float *> operands;
+    QVector<float> operandFactors;
+
+    GridIndex thisPointCount = pointCount();
+    for (int i = 0; i < grids.count(); i++)
     {
-        unsigned int thisPointCount = pointCount();
-        for(unsigned int i = 0; i < thisPointCount; i++)
+        const Grid *grid = grids[i];
+        if (!fPointValues || !grid->fPointValues ||
+                    fXDim != grid->fXDim || fYDim != grid->fYDim ||
+                    fZDim != grid->fZDim || !hasSameBounds(grid))
         {
-            fPointValues[i] = 0.0;
+            qWarning() << "Different dimentions, bounds or no points, skipping"
+                        << "grid of" << grid->pointCount() << "points, self"
+                        << "point count is" << thisPointCount;
+            continue;
         }
-    }
-}
 
-void Grid::allocatePoints()
-{
-    unsigned int thisPointCount = pointCount();
-    fPointValues = new float[thisPointCount];
+        if (fLayout != grid->fLayout)
+        {
+            combineGridByPoints(grid, factors[i]);
+            continue;
+        }
 
-    zeroizePoints();
+        // padding of bricks is added too, it is never read
+        operands.append(grid->fPointValues);
+        operandFactors.append(factors[i]);
+    }
+
+    if (!operands.isEmpty())
+    {
+        GridKernels::combine(fPointValues, fStorageSize, operands,
+                    operandFactors);
+    }
 }
 
-void Grid::freePoints()
+void Grid::combineGridByPoints(const Grid *grid, float factor)
 {
-    if (fPointValues)
+    unsigned int xPos, yPos, zPos;
+    for (zPos = 0; zPos < fZDim; zPos++)
     {
-        delete[] fPointValues;
-        fPointValues = 0;
+        for (yPos = 0; yPos < fYDim; yPos++)
+        {
+            for (xPos = 0; xPos < fXDim; xPos++)
+            {
+                fPointValues[pointIndex(xPos, yPos, zPos)] += factor *
+                            grid->fPointValues[grid->pointIndex(xPos, yPos,
+                            zPos)];
+            }
+        }
     }
 }
 
@@ -21,25 +21,80 @@
 #ifndef GRID_H
 #define GRID_H
 
+#include <QVector>
+
+#include "space_types.h"
+#include "gridstorage.h"
+
+extern const float kMin; // grid ranges are chosen inside of [kMin, kMax].
+extern const float kMax;
 extern const float kDim;
 
 class FieldObject;
+class QString;
+class QIODevice;
+
+const unsigned int kBrickSideBits = 3;
+const unsigned int kBrickSide = 1 << kBrickSideBits; // in points.
+const unsigned int kBrickPointCount = kBrickSide * kBrickSide * kBrickSide;
+
+// Order of point values in memory. Linear layout is x-fastest order of whole
+// grid. Bricked layout stores kBrickSide^3 bricks of points contiguously (in
+// x-fastest order inside of a brick and of bricks), so the 8 vertexes of a
+// cell and cells of a block are close in memory at any grid dimention.
+typedef enum
+{
+    LINEAR_LAYOUT = 1,
+    BRICKED_LAYOUT
+} GridLayout;
 
-// Represents a centered cubic grid with support of different dimentions on
-// x, y, z sides. A potential value is defined in each grid point. So grid
+// Represents a cubic grid with support of different dimentions on x, y, z
+// sides. Grid is centered in origin by default, explicit space bounds may be
+// set instead. A potential value is defined in each grid point. So grid
 // holds some field-object's field potential values. Grid supports subtaction
 // and addition of potentian values of other grid.
 class Grid
 {
 public:
-    Grid(unsigned int xDim, unsigned int yDim, unsigned int zDim);
+    Grid(unsigned int xDim, unsigned int yDim, unsigned int zDim,
+                GridLayout layout = LINEAR_LAYOUT);
     ~Grid();
 
+    inline GridLayout layout() const { return fLayout; }
+    // Point values are kept.
+    void setLayout(GridLayout layout);
+
+    inline GridStorageKind storageKind() const { return fStorage.kind(); }
+    // Point values are kept (they are copied through heap memory).
+    void setStorageKind(GridStorageKind kind);
+
+    // Grid which does not hold points keeps geometry only (dimentions,
+    // bounds and layout), f.e. for field-object which values are kept by
+    // SparseGrid. Its pointValues() is 0, point values are zeroized when
+    // points are held again.
+    inline bool holdsPoints() const { return fHoldsPoints; }
+    void setHoldsPoints(bool holdsPoints);
+
     void setSidesDimention(int dim);
+    void setDimentions(unsigned int xDim, unsigned int yDim,
+                unsigned int zDim);
+    // Changes dimentions keeping the field: new point values are
+    // trilinearly interpolated from current ones.
+    void resample(unsigned int xDim, unsigned int yDim, unsigned int zDim);
     void setXDimention(int dim);
     void setYDimention(int dim);
     void setZDimention(int dim);
 
+    // Explicit bounds make the first and the last points of each axis lie on
+    // them, so each axis gets its own step, bounds are kept by dimentions
+    // changes. Point values are zeroized.
+    void setBounds(const Point &minPoint, const Point &maxPoint);
+    // Returns to default bounds: grid is centered in origin and all axises
+    // have the same step which fits the largest dimention into [kMin, kMax].
+    void resetBounds();
+    inline bool hasExplicitBounds() const { return fExplicitBounds; }
+    bool hasSameBounds(const Grid *grid) const;
+
     inline float xMin() const { return fXMin; }
     inline float xMax() const { return fXMax; }
     inline float xStep() const { return fXStep; }
@@ -55,15 +110,40 @@ public:
     inline float zStep() const { return fZStep; }
     inline unsigned int zDimention() const { return fZDim; } // in points.
 
-    inline unsigned int pointCount() const { return fXDim * fYDim * fZDim; }
-    inline unsigned int cellCount() const { return (fXDim - 1) * (fYDim - 1) *
+    inline GridIndex pointCount() const
+                { return static_cast<GridIndex>(fXDim) * fYDim * fZDim; }
+    // Number of values in pointValues(), bricked layout pads grid sides to
+    // whole bricks.
+    inline GridIndex storageSize() const { return fStorageSize; }
+    inline GridIndex cellCount() const
+                { return static_cast<GridIndex>(fXDim - 1) * (fYDim - 1) *
                 (fZDim - 1); }
 
     // Get point index (used to access pointValues() return value) by
     // giving point position in cartesian space coordinates.
-    inline unsigned int pointIndex(unsigned int xPos, unsigned int yPos,
+    inline GridIndex pointIndex(unsigned int xPos, unsigned int yPos,
                 unsigned int zPos) const
-                { return (fXDim * fYDim * zPos) + (fXDim * yPos) + xPos; }
+    {
+        if (fLayout == BRICKED_LAYOUT)
+        {
+            const unsigned int mask = kBrickSide - 1;
+            GridIndex brick = (static_cast<GridIndex>(fXBricks) * fYBricks *
+                        (zPos >> kBrickSideBits)) +
+                        (fXBricks * (yPos >> kBrickSideBits)) +
+                        (xPos >> kBrickSideBits);
+            return (brick << (3 * kBrickSideBits)) |
+                        ((zPos & mask) << (2 * kBrickSideBits)) |
+                        ((yPos & mask) << kBrickSideBits) | (xPos & mask);
+        }
+        return (static_cast<GridIndex>(fXDim) * fYDim * zPos) +
+                    (static_cast<GridIndex>(fXDim) * yPos) + xPos;
+    }
+
+    // Returns values of count points of X-row starting in given point. Row
+    // values are contiguous in linear layout and are returned in place,
+    // otherwise they are copied to buffer (which must hold count values).
+    const float *rowValues(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos, unsigned int count, float *buffer) const;
 
     // Get real cartesian space coordinates of cell's first (0-indexed) vertex.
     inline float xCoord(unsigned int xPos) const
@@ -73,19 +153,68 @@ public:
     inline float zCoord(unsigned int zPos) const
                 { return fZMin + (zPos * fZStep); }
 
+    // Trilinear interpolation of point values, p is clamped to grid ranges.
+    float interpolatedValue(const Point &p) const;
+
+    // Box of all grid cells.
+    GridBox cellsBox() const;
+    // Box of cells which have at least one vertex in given box of points.
+    GridBox cellsBoxOfPoints(const GridBox &pointsBox) const;
+    // Box of points which values differ from corresponding values of given
+    // grid. Whole grid is returned if dimentions are different.
+    GridBox differentPointsBox(const Grid *grid) const;
+    // Box of points which values are not below isoLevel (inside of
+    // isosurface), empty box (min > max) if there are no such points.
+    GridBox insidePointsBox(float isoLevel) const;
+
     void fillWithFieldObject(FieldObject *fieldObject);
+    // Evaluates field-object only in points of a coarse lattice (points
+    // which positions are multiples of stride or last ones on each axis)
+    // and interpolates the others. Lattice points of evaluatedStride (which
+    // must be a multiple of stride, 0 if none) are already evaluated and are
+    // skipped, so refinement through lattices of halving strides evaluates
+    // each point once.
+    void fillWithFieldObject(FieldObject *fieldObject, unsigned int stride,
+                unsigned int evaluatedStride);
     void addGrid(const Grid *grid);
     void subtractGrid(const Grid *grid);
+    void zeroizePoints();
+    // Same as subtractGrid(oldGrid) followed by addGrid(newGrid), but in one
+    // pass over point values.
+    void replaceGrid(const Grid *oldGrid, const Grid *newGrid);
+    // Adds all given grids in one pass over point values.
+    void addGrids(const QVector<const Grid *> &grids);
 
     const float *pointValues() const { return fPointValues; }
 
+    // Writes grid geometry and point values (in native byte order) to file,
+    // which may be attached by attachFile() later. Grid which does not hold
+    // points is not written.
+    bool saveToFile(const QString &fileName) const;
+    // Same for a part of bigger file, written at current device position.
+    bool saveToDevice(QIODevice *device) const;
+    // Point values of a file written by saveToFile() (or of a part written
+    // by saveToDevice() at offset) are mapped instead of being read, see
+    // GridStorage::attachFile(). Returns false (grid is unchanged) if file
+    // geometry differs from the grid one.
+    bool attachFile(const QString &fileName, qint64 offset = 0);
+
 protected:
     void calculateSteps(); // TODO: clear cell dimention vs. point dimention
                            // question!!!
+    void calculateAxis(unsigned int dim, float *min, float *max,
+                float *step);
 
-    void zeroizePoints();
     void allocatePoints();
     void freePoints();
+    void fillLinear(FieldObject *fieldObject);
+    void interpolateFromLattice(unsigned int stride);
+    void fillBricked(FieldObject *fieldObject);
+    // Adds grids multiplied by corresponding factors. Operands of different
+    // layout are processed point by point.
+    void combineGrids(const QVector<const Grid *> &grids,
+                const QVector<float> &factors);
+    void combineGridByPoints(const Grid *grid, float factor);
 
     inline unsigned int maxSideDimention();
     inline unsigned int minSideDimention();
@@ -93,8 +222,17 @@ protected:
 
 private: // data
 
-    float *fPointValues;
+    GridStorage fStorage;
+    bool fHoldsPoints;
+    float *fPointValues; // values of fStorage.
+    GridIndex fStorageSize;
+
+    GridLayout fLayout;
+    unsigned int fXBricks; // bricks on each side in bricked layout.
+    unsigned int fYBricks;
+    unsigned int fZBricks;
 
+    bool fExplicitBounds;
     float fXMin; // Grid ranges.
     float fXMax;
     float fXStep;
@@ -0,0 +1,115 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * gridkernels.cpp is part of 3D Meta-Object-based Modelling System          *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <QList>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include "gridkernels.h"
+
+const GridIndex kChunkSize = 1 << 16; // values per concurrent task.
+const GridIndex kBlockSize = 1 << 10; // values kept in cache at once.
+
+namespace Chunks
+{
+    typedef struct
+    {
+        float *values;
+        GridIndex offset;
+        GridIndex count;
+        const QVector<const float *> *operands;
+        const QVector<float> *factors;
+        bool clear;
+    } Chunk;
+
+    // values[i] += factor * operand[i].
+    inline void addScaled(float *values, const float *operand, float factor,
+                unsigned int count)
+    {
+        unsigned int i = 0;
+#ifdef __SSE__
+        __m128 scale = _mm_set1_ps(factor);
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i),
+                        _mm_mul_ps(_mm_loadu_ps(operand + i), scale)));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            values[i] += factor * operand[i];
+        }
+    }
+
+    void processChunk(Chunk &chunk)
+    {
+        int operandCount = chunk.operands->count();
+        GridIndex last = chunk.offset + chunk.count;
+        for (GridIndex first = chunk.offset; first < last;
+                    first += kBlockSize)
+        {
+            unsigned int count = qMin(kBlockSize, last - first);
+            float *values = chunk.values + first;
+            if (chunk.clear)
+            {
+                memset(values, 0, count * sizeof(float));
+            }
+            for (int k = 0; k < operandCount; k++)
+            {
+                addScaled(values, chunk.operands->at(k) + first,
+                            chunk.factors->at(k), count);
+            }
+        }
+    }
+}
+
+using namespace Chunks;
+
+void GridKernels::combine(float *values, GridIndex count,
+            const QVector<const float *> &operands,
+            const QVector<float> &factors, bool clear)
+{
+    QList<Chunk> chunks;
+    for (GridIndex offset = 0; offset < count; offset += kChunkSize)
+    {
+        Chunk chunk = { values, offset, qMin(kChunkSize, count - offset),
+                    &operands, &factors, clear };
+        chunks.append(chunk);
+    }
+
+    // small grids are not worth of threads start
+    if (chunks.count() < 2 ||
+                QThreadPool::globalInstance()->maxThreadCount() < 2)
+    {
+        for (int i = 0; i < chunks.count(); i++)
+        {
+            processChunk(chunks[i]);
+        }
+        return;
+    }
+
+    QtConcurrent::blockingMap(chunks, processChunk);
+}
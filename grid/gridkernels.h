@@ -0,0 +1,43 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * gridkernels.h is part of 3D Meta-Object-based Modelling System            *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GRIDKERNELS_H
+#define GRIDKERNELS_H
+
+#include <QVector>
+
+#include "space_types.h"
+
+// Represents set of functions for whole grid passes over point values. Work
+// is split into chunks which are processed by all available cores, and each
+// chunk is processed in small blocks (with SSE when available), so result
+// values stay in cache while all operands are added to them and whole pass
+// reads and writes every value only once.
+namespace GridKernels
+{
+    // values[i] = values[i] + SUM(factors[k] * operands[k][i]) for i less
+    // than count, values are zeroized before if clear is true. Operands must
+    // not overlap values.
+    void combine(float *values, GridIndex count,
+                const QVector<const float *> &operands,
+                const QVector<float> &factors, bool clear = false);
+}
+
+#endif // GRIDKERNELS_H
@@ -0,0 +1,227 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * gridstorage.cpp is part of 3D Meta-Object-based Modelling System          *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <new>
+
+#include <QtGlobal>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "gridstorage.h"
+
+const unsigned long long kHugePageSize = 2 * 1024 * 1024;
+
+GridStorage::GridStorage(GridStorageKind kind) : fKind(kind),
+            fAllocatedKind(HEAP_STORAGE), fValues(0), fCount(0),
+            fMappedSize(0), fMappedOffset(0), fFile(0)
+{
+}
+
+GridStorage::~GridStorage()
+{
+    free();
+}
+
+float *GridStorage::allocate(GridIndex count)
+{
+    free();
+
+    // size in bytes has to be addressable
+    if (count < 0 || static_cast<unsigned long long>(count) >
+                static_cast<size_t>(-1) / sizeof(float))
+    {
+        qWarning() << "GridStorage::allocate():" << count <<
+                    "values can not be addressed";
+        return 0;
+    }
+
+    if (fKind == MAPPED_STORAGE)
+    {
+        fValues = allocateMapped(count);
+    }
+    else if (fKind == HUGE_PAGE_STORAGE)
+    {
+        fValues = allocateHugePages(count);
+    }
+
+    if (fValues)
+    {
+        fAllocatedKind = fKind;
+    }
+    else
+    {
+        fAllocatedKind = HEAP_STORAGE;
+        fValues = new (std::nothrow) float[count];
+    }
+
+    if (fValues)
+    {
+        fCount = count;
+    }
+    return fValues;
+}
+
+void GridStorage::free()
+{
+    if (!fValues)
+    {
+        return;
+    }
+
+    switch (fAllocatedKind)
+    {
+        case MAPPED_STORAGE:
+        {
+            fFile->unmap(reinterpret_cast<uchar *>(fValues));
+            delete fFile; // temporary file is removed
+            fFile = 0;
+            break;
+        }
+        case HUGE_PAGE_STORAGE:
+        {
+#ifdef Q_OS_LINUX
+            munmap(fValues, fMappedSize);
+#endif
+            fMappedSize = 0;
+            break;
+        }
+        case FILE_STORAGE:
+        {
+#ifdef Q_OS_UNIX
+            munmap(reinterpret_cast<char *>(fValues) - fMappedOffset,
+                        fMappedSize);
+#endif
+            fMappedSize = 0;
+            fMappedOffset = 0;
+            break;
+        }
+        default:
+        {
+            delete[] fValues;
+        }
+    }
+
+    fValues = 0;
+    fCount = 0;
+}
+
+float *GridStorage::attachFile(const QString &fileName, qint64 offset,
+            GridIndex count)
+{
+    QFile file(fileName);
+    qint64 size = count * sizeof(float);
+    if (count < 0 || !file.open(QIODevice::ReadOnly) ||
+                file.size() < offset + size)
+    {
+        return 0;
+    }
+
+#ifdef Q_OS_UNIX
+    // mapping has to start at page boundary, so only values of files which
+    // hold a few grids are mapped
+    qint64 mappingOffset = offset % sysconf(_SC_PAGESIZE);
+    void *mapping = mmap(0, mappingOffset + size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, file.handle(), offset - mappingOffset);
+    if (mapping == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    free();
+    fAllocatedKind = FILE_STORAGE;
+    fMappedSize = mappingOffset + size;
+    fMappedOffset = mappingOffset;
+    fValues = reinterpret_cast<float *>(static_cast<char *>(mapping) +
+                mappingOffset);
+#else
+    float *values = new (std::nothrow) float[count];
+    if (!values || !file.seek(offset) ||
+                file.read(reinterpret_cast<char *>(values), size) != size)
+    {
+        delete[] values;
+        return 0;
+    }
+
+    free();
+    fAllocatedKind = HEAP_STORAGE;
+    fValues = values;
+#endif
+
+    fCount = count;
+    return fValues;
+}
+
+float *GridStorage::allocateMapped(GridIndex count)
+{
+    qint64 size = count * sizeof(float);
+
+    fFile = new QTemporaryFile(QDir::tempPath() + "/dip2_grid");
+    uchar *values = 0;
+    if (fFile->open() && fFile->resize(size))
+    {
+        values = fFile->map(0, size);
+    }
+
+    if (!values)
+    {
+        qWarning() << "GridStorage: can not map" << size << "bytes of" <<
+                    fFile->fileName() << "using heap storage";
+        delete fFile;
+        fFile = 0;
+    }
+    return reinterpret_cast<float *>(values);
+}
+
+float *GridStorage::allocateHugePages(GridIndex count)
+{
+#ifdef Q_OS_LINUX
+    fMappedSize = (count * sizeof(float) + kHugePageSize - 1) &
+                ~(kHugePageSize - 1);
+
+    // reserved huge pages are used if there are enough of them, otherwise
+    // transparent huge pages are asked for
+    void *values = mmap(0, fMappedSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (values == MAP_FAILED)
+    {
+        values = mmap(0, fMappedSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (values == MAP_FAILED)
+        {
+            fMappedSize = 0;
+            return 0;
+        }
+        madvise(values, fMappedSize, MADV_HUGEPAGE);
+    }
+    return static_cast<float *>(values);
+#else
+    Q_UNUSED(count);
+    qWarning() << "GridStorage: huge pages are not supported,"
+                << "using heap storage";
+    return 0;
+#endif
+}
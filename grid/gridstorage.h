@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * gridstorage.h is part of 3D Meta-Object-based Modelling System            *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GRIDSTORAGE_H
+#define GRIDSTORAGE_H
+
+#include <QtGlobal>
+
+#include "space_types.h"
+
+class QString;
+class QTemporaryFile;
+
+typedef enum
+{
+    HEAP_STORAGE = 1,
+    MAPPED_STORAGE,
+    HUGE_PAGE_STORAGE,
+    FILE_STORAGE // values of a file attached by attachFile().
+} GridStorageKind;
+
+// Represents memory of grid point values. Heap storage is the plain
+// new float[], mapped storage is a temporary file mapped into memory (so
+// values of grids which exceed RAM are paged to disk by the system) and huge
+// page storage is backed by huge memory pages (less TLB misses on passes
+// over big grids). Storage kinds which are not supported by the platform
+// fall back to heap storage.
+class GridStorage
+{
+public:
+    GridStorage(GridStorageKind kind = HEAP_STORAGE);
+    ~GridStorage();
+
+    inline GridStorageKind kind() const { return fKind; }
+    // Takes effect on next allocation.
+    void setKind(GridStorageKind kind) { fKind = kind; }
+
+    // Returns 0 if count values can not be allocated (or even addressed).
+    // Previously allocated values are freed.
+    float *allocate(GridIndex count);
+    // Maps count values which start at offset of given file instead of
+    // allocation. Mapping is private, so values may be changed but file is
+    // never written. Where mapping is not supported values are read into
+    // heap storage. Returns 0 (current values are kept) if file is too
+    // short or can not be read.
+    float *attachFile(const QString &fileName, qint64 offset,
+                GridIndex count);
+    void free();
+
+    inline float *values() const { return fValues; }
+    inline GridIndex count() const { return fCount; }
+
+private:
+    GridStorage(const GridStorage &);
+    GridStorage &operator=(const GridStorage &);
+
+    float *allocateMapped(GridIndex count);
+    float *allocateHugePages(GridIndex count);
+
+private: // data
+    GridStorageKind fKind;
+    GridStorageKind fAllocatedKind;
+    float *fValues;
+    GridIndex fCount;
+    unsigned long long fMappedSize; // in bytes, for huge page and file
+                                    // storage.
+    unsigned long long fMappedOffset; // of values in file mapping.
+    QTemporaryFile *fFile;
+};
+
+#endif // GRIDSTORAGE_H
@@ -0,0 +1,425 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * octree.cpp is part of 3D Meta-Object-based Modelling System               *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <math.h>
+#include <limits.h>
+
+#include <QDebug>
+
+#include "octree.h"
+#include "fieldobject.h"
+
+const unsigned int kMaxOctreeDepth = 10; // 1024^3 finest cells.
+// QVector of Qt4 allocates its items in a block of int size in bytes
+const int kMaxNodeCount = INT_MAX / sizeof(OctreeNode);
+const int kMaxDualCellCount = INT_MAX / sizeof(DualCell);
+
+Octree::Octree(FieldObject *fieldObject, const Point &minPoint,
+            const Point &maxPoint, unsigned int maxDepth)
+            : fFieldObject(fieldObject), fMinPoint(minPoint),
+            fMaxPoint(maxPoint), fIsoLevel(2.0), fMaxDepth(0), fMinDepth(3),
+            fFlatnessTolerance(0.0), fLeafCount(0)
+{
+    setMaxDepth(maxDepth);
+}
+
+void Octree::setBounds(const Point &minPoint, const Point &maxPoint)
+{
+    if (minPoint.x == fMinPoint.x && minPoint.y == fMinPoint.y &&
+                minPoint.z == fMinPoint.z && maxPoint.x == fMaxPoint.x &&
+                maxPoint.y == fMaxPoint.y && maxPoint.z == fMaxPoint.z)
+    {
+        return;
+    }
+
+    fMinPoint = minPoint;
+    fMaxPoint = maxPoint;
+    resetLattice();
+}
+
+void Octree::setMaxDepth(unsigned int maxDepth)
+{
+    maxDepth = qBound(1u, maxDepth, kMaxOctreeDepth);
+    if (fMaxDepth == maxDepth)
+    {
+        return;
+    }
+
+    fMaxDepth = maxDepth;
+    resetLattice();
+}
+
+void Octree::resetLattice()
+{
+    float halfCellCount = 2u << fMaxDepth;
+    fStep.x = (fMaxPoint.x - fMinPoint.x) / halfCellCount;
+    fStep.y = (fMaxPoint.y - fMinPoint.y) / halfCellCount;
+    fStep.z = (fMaxPoint.z - fMinPoint.z) / halfCellCount;
+
+    // sample points are different now
+    fValues.clear();
+    fNodes.clear();
+    fLeafCount = 0;
+    fDualCells.clear();
+}
+
+void Octree::rebuild(bool fieldChanged)
+{
+    if (fieldChanged)
+    {
+        fValues.clear();
+    }
+
+    fNodes.clear();
+    fLeafCount = 0;
+    fDualCells.clear();
+
+    unsigned int size = 1u << fMaxDepth;
+    OctreeNode root = { 0, 0, 0, size, -1, sampleValue(size, size, size) };
+    fNodes.append(root);
+    refineNode(0, 0);
+    nodeProc(0);
+
+    if (fDualCells.count() == kMaxDualCellCount)
+    {
+        qWarning() << "Octree: too many dual cells, isosurface is incomplete";
+    }
+    qDebug() << "Octree rebuilt, nodes:" << fNodes.count() << "leaves:" <<
+                fLeafCount << "crossed dual cells:" << fDualCells.count() <<
+                "evaluated points:" << fValues.count();
+}
+
+Point Octree::nodeCenter(int node) const
+{
+    const OctreeNode &octreeNode = fNodes[node];
+    return samplePoint(2 * octreeNode.xPos + octreeNode.size,
+                2 * octreeNode.yPos + octreeNode.size,
+                2 * octreeNode.zPos + octreeNode.size);
+}
+
+Point Octree::nodeGradient(int node)
+{
+    const OctreeNode &octreeNode = fNodes[node];
+    unsigned int size = octreeNode.size; // half of node in half cells.
+    unsigned int xPos = 2 * octreeNode.xPos + size;
+    unsigned int yPos = 2 * octreeNode.yPos + size;
+    unsigned int zPos = 2 * octreeNode.zPos + size;
+
+    Point gradient;
+    gradient.x = (sampleValue(xPos + size, yPos, zPos) -
+                sampleValue(xPos - size, yPos, zPos)) / (2 * size * fStep.x);
+    gradient.y = (sampleValue(xPos, yPos + size, zPos) -
+                sampleValue(xPos, yPos - size, zPos)) / (2 * size * fStep.y);
+    gradient.z = (sampleValue(xPos, yPos, zPos + size) -
+                sampleValue(xPos, yPos, zPos - size)) / (2 * size * fStep.z);
+
+    return gradient;
+}
+
+Point Octree::samplePoint(unsigned int xPos, unsigned int yPos,
+            unsigned int zPos) const
+{
+    Point p;
+    p.x = fMinPoint.x + xPos * fStep.x;
+    p.y = fMinPoint.y + yPos * fStep.y;
+    p.z = fMinPoint.z + zPos * fStep.z;
+    return p;
+}
+
+float Octree::sampleValue(unsigned int xPos, unsigned int yPos,
+            unsigned int zPos)
+{
+    quint64 key = sampleKey(xPos, yPos, zPos);
+    QHash<quint64, float>::const_iterator value = fValues.constFind(key);
+    if (value != fValues.constEnd())
+    {
+        return value.value();
+    }
+
+    float newValue = fFieldObject->valueAtPoint(samplePoint(xPos, yPos,
+                zPos));
+    fValues.insert(key, newValue);
+    return newValue;
+}
+
+void Octree::refineNode(int node, unsigned int depth)
+{
+    // node is copied, as nodes are reallocated when children are appended
+    OctreeNode parent = fNodes[node];
+    if (!isRefinementNeeded(parent, depth))
+    {
+        fLeafCount++;
+        return;
+    }
+    if (fNodes.count() > kMaxNodeCount - 8)
+    {
+        qWarning() << "Octree: too many nodes, node of depth" << depth <<
+                    "is not refined";
+        fLeafCount++;
+        return;
+    }
+
+    int firstChild = fNodes.count();
+    fNodes[node].firstChild = firstChild;
+
+    OctreeNode childNode;
+    childNode.size = parent.size / 2;
+    childNode.firstChild = -1;
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        childNode.xPos = parent.xPos + ((i & 1) ? childNode.size : 0);
+        childNode.yPos = parent.yPos + ((i & 2) ? childNode.size : 0);
+        childNode.zPos = parent.zPos + ((i & 4) ? childNode.size : 0);
+        childNode.value = sampleValue(2 * childNode.xPos + childNode.size,
+                    2 * childNode.yPos + childNode.size,
+                    2 * childNode.zPos + childNode.size);
+        fNodes.append(childNode);
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        refineNode(firstChild + i, depth + 1);
+    }
+}
+
+bool Octree::isRefinementNeeded(const OctreeNode &node, unsigned int depth)
+{
+    if (node.size < 2)
+    {
+        return false; // finest cell
+    }
+    if (depth < fMinDepth)
+    {
+        return true;
+    }
+
+    unsigned int xPos = 2 * node.xPos;
+    unsigned int yPos = 2 * node.yPos;
+    unsigned int zPos = 2 * node.zPos;
+    unsigned int size = 2 * node.size; // in half cells.
+
+    float minValue = node.value;
+    float maxValue = node.value;
+    float cornerSum = 0.0;
+    float cornerValue;
+    for (int i = 0; i < 8; i++)
+    {
+        cornerValue = sampleValue(xPos + ((i & 1) ? size : 0),
+                    yPos + ((i & 2) ? size : 0),
+                    zPos + ((i & 4) ? size : 0));
+        minValue = qMin(minValue, cornerValue);
+        maxValue = qMax(maxValue, cornerValue);
+        cornerSum += cornerValue;
+    }
+
+    if (minValue < fIsoLevel && maxValue >= fIsoLevel)
+    {
+        return fFlatnessTolerance <= 0.0 ||
+                    fabs(node.value - cornerSum / 8) > fFlatnessTolerance;
+    }
+
+    // gradient criterion: field may vary inside of the node as much as it
+    // varies between its samples, so it may still reach iso level there
+    float distance = qMin(fabs(minValue - fIsoLevel),
+                fabs(maxValue - fIsoLevel));
+    return distance <= maxValue - minValue;
+}
+
+void Octree::nodeProc(int node)
+{
+    if (fNodes[node].firstChild < 0)
+    {
+        return;
+    }
+
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        nodeProc(child(node, i));
+    }
+
+    int edgeNodes[4];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        int axisBit = 1 << axis;
+        int uBit = 1 << ((axis + 1) % 3);
+        int vBit = 1 << ((axis + 2) % 3);
+
+        for (i = 0; i < 8; i++)
+        {
+            if (!(i & axisBit))
+            {
+                faceProc(child(node, i), child(node, i | axisBit), axis);
+            }
+        }
+
+        // edges go through the node center
+        for (int half = 0; half < 2; half++)
+        {
+            int axisPart = half ? axisBit : 0;
+            edgeNodes[0] = child(node, axisPart);
+            edgeNodes[1] = child(node, axisPart | uBit);
+            edgeNodes[2] = child(node, axisPart | vBit);
+            edgeNodes[3] = child(node, axisPart | uBit | vBit);
+            edgeProc(edgeNodes, axis);
+        }
+    }
+
+    int pointNodes[8];
+    for (i = 0; i < 8; i++)
+    {
+        pointNodes[i] = child(node, i);
+    }
+    vertProc(pointNodes);
+}
+
+void Octree::faceProc(int node0, int node1, int axis)
+{
+    if (fNodes[node0].firstChild < 0 && fNodes[node1].firstChild < 0)
+    {
+        return;
+    }
+
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    int axisBit = 1 << axis;
+    int uBit = 1 << u;
+    int vBit = 1 << v;
+
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        if (!(i & axisBit))
+        {
+            faceProc(child(node0, i | axisBit), child(node1, i), axis);
+        }
+    }
+
+    // edges go through the face center, next axises of u are v and axis,
+    // next axises of v are axis and u
+    int edgeNodes[4];
+    for (int half = 0; half < 2; half++)
+    {
+        int uPart = half ? uBit : 0;
+        edgeNodes[0] = child(node0, uPart | axisBit);
+        edgeNodes[1] = child(node0, uPart | axisBit | vBit);
+        edgeNodes[2] = child(node1, uPart);
+        edgeNodes[3] = child(node1, uPart | vBit);
+        edgeProc(edgeNodes, u);
+
+        int vPart = half ? vBit : 0;
+        edgeNodes[0] = child(node0, vPart | axisBit);
+        edgeNodes[1] = child(node1, vPart);
+        edgeNodes[2] = child(node0, vPart | axisBit | uBit);
+        edgeNodes[3] = child(node1, vPart | uBit);
+        edgeProc(edgeNodes, v);
+    }
+
+    // children next to the face center
+    int pointNodes[8];
+    for (i = 0; i < 8; i++)
+    {
+        pointNodes[i] = child((i & axisBit) ? node1 : node0, i ^ axisBit);
+    }
+    vertProc(pointNodes);
+}
+
+void Octree::edgeProc(const int *nodes, int axis)
+{
+    int i;
+    bool areLeaves = true;
+    for (i = 0; areLeaves && i < 4; i++)
+    {
+        areLeaves = fNodes[nodes[i]].firstChild < 0;
+    }
+    if (areLeaves)
+    {
+        return;
+    }
+
+    int axisBit = 1 << axis;
+    int uBit = 1 << ((axis + 1) % 3);
+    int vBit = 1 << ((axis + 2) % 3);
+
+    // children next to the edge are on other sides of nodes in u and v
+    int edgeNodes[4];
+    for (int half = 0; half < 2; half++)
+    {
+        int axisPart = half ? axisBit : 0;
+        for (i = 0; i < 4; i++)
+        {
+            edgeNodes[i] = child(nodes[i], axisPart | ((i & 1) ? 0 : uBit) |
+                        ((i & 2) ? 0 : vBit));
+        }
+        edgeProc(edgeNodes, axis);
+    }
+
+    // children next to the edge center
+    int pointNodes[8];
+    for (i = 0; i < 8; i++)
+    {
+        pointNodes[i] = child(nodes[((i & uBit) ? 1 : 0) +
+                    ((i & vBit) ? 2 : 0)], i ^ uBit ^ vBit);
+    }
+    vertProc(pointNodes);
+}
+
+void Octree::vertProc(const int *nodes)
+{
+    int i;
+    bool areLeaves = true;
+    for (i = 0; areLeaves && i < 8; i++)
+    {
+        areLeaves = fNodes[nodes[i]].firstChild < 0;
+    }
+
+    if (!areLeaves)
+    {
+        // children next to the point are on other sides of nodes
+        int pointNodes[8];
+        for (i = 0; i < 8; i++)
+        {
+            pointNodes[i] = child(nodes[i], 7 - i);
+        }
+        vertProc(pointNodes);
+        return;
+    }
+
+    float minValue = fNodes[nodes[0]].value;
+    float maxValue = minValue;
+    for (i = 1; i < 8; i++)
+    {
+        minValue = qMin(minValue, fNodes[nodes[i]].value);
+        maxValue = qMax(maxValue, fNodes[nodes[i]].value);
+    }
+    if (minValue >= fIsoLevel || maxValue < fIsoLevel ||
+                fDualCells.count() == kMaxDualCellCount)
+    {
+        return;
+    }
+
+    DualCell cell;
+    for (i = 0; i < 8; i++)
+    {
+        cell.nodes[i] = nodes[i];
+    }
+    fDualCells.append(cell);
+}
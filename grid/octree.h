@@ -0,0 +1,152 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * octree.h is part of 3D Meta-Object-based Modelling System                 *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <QHash>
+#include <QVector>
+
+#include "space_types.h"
+
+class FieldObject;
+
+// Represents node of adaptive octree. Position of its lowest corner and its
+// size are given in cells of the finest lattice (one of maximal depth).
+typedef struct
+{
+    unsigned int xPos;
+    unsigned int yPos;
+    unsigned int zPos;
+    unsigned int size;
+    int firstChild; // -1 for leaves, children of a node go in a row.
+    float value; // in node center.
+} OctreeNode;
+
+// Represents cell of octree's dual grid: leaves (given by node indexes)
+// around a common point, in (x + 2 * y + 4 * z) order of their positions
+// around it. Leaves of different sizes are around a point where octree
+// changes its level, so some of them are repeated then.
+typedef struct
+{
+    int nodes[8];
+} DualCell;
+
+// Represents adaptive octree over axis aligned box of space. Field-object's
+// potential values are evaluated lazily, only in corners and centers of
+// nodes which are visited, and nodes are refined only where isosurface may
+// cross them, so memory and time depend on surface area rather than on
+// volume (grid of 512^3 points is held by 9 levels of octree). Isosurface is
+// extracted from the dual grid (its vertexes are centers of leaves), which
+// has no cracks between leaves of different levels (dual marching cubes).
+class Octree
+{
+public:
+    Octree(FieldObject *fieldObject, const Point &minPoint,
+                const Point &maxPoint, unsigned int maxDepth = 7);
+
+    inline float isoLevel() const { return fIsoLevel; }
+    void setIsoLevel(float isoLevel) { fIsoLevel = isoLevel; }
+
+    // Evaluated values are dropped when bounds or maximal depth change.
+    void setBounds(const Point &minPoint, const Point &maxPoint);
+    inline unsigned int maxDepth() const { return fMaxDepth; }
+    void setMaxDepth(unsigned int maxDepth);
+    // Nodes up to minimal depth are always refined, so small isosurface
+    // parts are not lost between samples of coarse nodes.
+    inline unsigned int minDepth() const { return fMinDepth; }
+    void setMinDepth(unsigned int minDepth) { fMinDepth = minDepth; }
+    // Crossed nodes are refined down to maximal depth when tolerance is 0.
+    // Otherwise crossed node where field is nearly linear (its center value
+    // differs from mean of corner values less than tolerance) is a leaf, so
+    // flat parts of isosurface get less of triangles.
+    inline float flatnessTolerance() const { return fFlatnessTolerance; }
+    void setFlatnessTolerance(float tolerance)
+                { fFlatnessTolerance = tolerance; }
+
+    // Values evaluated before are reused unless field has changed (f.e.
+    // only iso level has changed).
+    void rebuild(bool fieldChanged = true);
+
+    inline const QVector<OctreeNode> &nodes() const { return fNodes; }
+    inline int leafCount() const { return fLeafCount; }
+    // Only dual cells crossed by isosurface are kept.
+    inline const QVector<DualCell> &dualCells() const { return fDualCells; }
+    inline int evaluatedPointCount() const { return fValues.count(); }
+
+    Point nodeCenter(int node) const;
+    // Central differences over node size, from values in centers of node
+    // faces.
+    Point nodeGradient(int node);
+
+protected:
+    // Positions are given on the lattice of half cells, so centers of
+    // finest cells are lattice points too.
+    Point samplePoint(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos) const;
+    float sampleValue(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos);
+    inline quint64 sampleKey(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos) const
+    {
+        return (static_cast<quint64>(zPos) << 42) |
+                    (static_cast<quint64>(yPos) << 21) | xPos;
+    }
+
+    // Half cell size is recalculated, evaluated values and nodes are
+    // dropped.
+    void resetLattice();
+    void refineNode(int node, unsigned int depth);
+    bool isRefinementNeeded(const OctreeNode &node, unsigned int depth);
+
+    // Returns node itself for leaves.
+    inline int child(int node, int childIndex) const
+    {
+        int firstChild = fNodes[node].firstChild;
+        return (firstChild < 0) ? node : firstChild + childIndex;
+    }
+    // Dual grid is enumerated recursively: cells inside of a node, between
+    // two nodes sharing a face (given by its normal axis), between four
+    // nodes sharing an edge (given by its axis, nodes go in (u + 2 * v)
+    // order, where u and v are next axises) and around a point.
+    void nodeProc(int node);
+    void faceProc(int node0, int node1, int axis);
+    void edgeProc(const int *nodes, int axis);
+    void vertProc(const int *nodes);
+
+private:
+    FieldObject *fFieldObject;
+
+    Point fMinPoint;
+    Point fMaxPoint;
+    Point fStep; // half of finest cell size on each axis.
+
+    float fIsoLevel;
+    unsigned int fMaxDepth;
+    unsigned int fMinDepth;
+    float fFlatnessTolerance;
+
+    QHash<quint64, float> fValues;
+    QVector<OctreeNode> fNodes;
+    int fLeafCount;
+    QVector<DualCell> fDualCells;
+};
+
+#endif // OCTREE_H
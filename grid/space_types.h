@@ -23,6 +23,10 @@
 
 #include <stdio.h>
 
+// Index or count of grid points or cells, 64-bit so that huge grids do not
+// overflow, signed so that -1 may stand for an invalid index.
+typedef long long GridIndex;
+
 // Represents point in 3D space.
 typedef struct
 {
@@ -31,6 +35,13 @@ typedef struct
     float z;
 } Point;
 
+// Represents affine transform of 3D space given by 3x4 matrix, point p is
+// transformed to m * (p.x, p.y, p.z, 1), so the last column is translation.
+typedef struct
+{
+    float m[3][4];
+} Transform;
+
 // Represents point with normal in 3D space.
 typedef struct // Point in 3d space with normals.
 {
@@ -50,4 +61,16 @@ typedef struct
     PointN p[3];
 } TriangleN;
 
+// Represents axis aligned box of grid points or grid cells given by inclusive
+// position ranges. Box is empty when any min position is greater than max.
+typedef struct
+{
+    int xMin;
+    int xMax;
+    int yMin;
+    int yMax;
+    int zMin;
+    int zMax;
+} GridBox;
+
 #endif // SPACE_TYPES_H
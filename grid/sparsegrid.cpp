@@ -0,0 +1,488 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * sparsegrid.cpp is part of 3D Meta-Object-based Modelling System           *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <string.h>
+#include <math.h>
+
+#include <QDebug>
+
+#include "grid.h"
+#include "sparsegrid.h"
+#include "fieldobject.h"
+
+namespace SparseUtil
+{
+    inline unsigned int tileDimention(unsigned int dim)
+    {
+        return (dim + kTileSide - 1) >> kTileSideBits;
+    }
+
+    // Same ranges as ones of Grid of same dimentions.
+    inline float axisMin(unsigned int dim, float step)
+    {
+        return -floorf(0.5 * dim * step);
+    }
+}
+
+using namespace SparseUtil;
+
+SparseGrid::SparseGrid(unsigned int xDim, unsigned int yDim,
+            unsigned int zDim)
+            : fSource(0), fIsoLevel(2.0), fBandWidth(0.0),
+            fXDim(xDim), fYDim(yDim), fZDim(zDim)
+{
+    calculateSteps();
+    allocateTiles();
+}
+
+SparseGrid::~SparseGrid()
+{
+    freeTiles();
+}
+
+void SparseGrid::setSidesDimention(int dim)
+{
+    fXDim = dim;
+    fYDim = dim;
+    fZDim = dim;
+
+    calculateSteps();
+
+    freeTiles();
+    allocateTiles();
+}
+
+void SparseGrid::setGeometry(const Grid *grid)
+{
+    fXDim = grid->xDimention();
+    fXMin = grid->xMin();
+    fXStep = grid->xStep();
+    fXTileDim = tileDimention(fXDim);
+
+    fYDim = grid->yDimention();
+    fYMin = grid->yMin();
+    fYStep = grid->yStep();
+    fYTileDim = tileDimention(fYDim);
+
+    fZDim = grid->zDimention();
+    fZMin = grid->zMin();
+    fZStep = grid->zStep();
+    fZTileDim = tileDimention(fZDim);
+
+    freeTiles();
+    allocateTiles();
+}
+
+void SparseGrid::setBand(float isoLevel, float bandWidth)
+{
+    fIsoLevel = isoLevel;
+    fBandWidth = qMax(bandWidth, 0.0f);
+}
+
+GridBox SparseGrid::insidePointsBox(float isoLevel) const
+{
+    GridBox box = { (int)fXDim, -1, (int)fYDim, -1, (int)fZDim, -1 };
+
+    int xPos, yPos, zPos;
+    for (unsigned int tile = 0; tile < tileCount(); tile++)
+    {
+        if (fTileMaxValues[tile] < isoLevel)
+        {
+            continue;
+        }
+
+        int xFirst = (tile % fXTileDim) << kTileSideBits;
+        int yFirst = ((tile / fXTileDim) % fYTileDim) << kTileSideBits;
+        int zFirst = (tile / (fXTileDim * fYTileDim)) << kTileSideBits;
+        int xLast = qMin(xFirst + (int)kTileSide, (int)fXDim) - 1;
+        int yLast = qMin(yFirst + (int)kTileSide, (int)fYDim) - 1;
+        int zLast = qMin(zFirst + (int)kTileSide, (int)fZDim) - 1;
+
+        const float *tileValues = fTiles[tile];
+        for (zPos = zFirst; zPos <= zLast; zPos++)
+        {
+            for (yPos = yFirst; yPos <= yLast; yPos++)
+            {
+                for (xPos = xFirst; xPos <= xLast; xPos++)
+                {
+                    if (!tileValues || tileValues[tilePointIndex(xPos, yPos,
+                                zPos)] >= isoLevel)
+                    {
+                        box.xMin = qMin(box.xMin, xPos);
+                        box.xMax = qMax(box.xMax, xPos);
+                        box.yMin = qMin(box.yMin, yPos);
+                        box.yMax = qMax(box.yMax, yPos);
+                        box.zMin = qMin(box.zMin, zPos);
+                        box.zMax = qMax(box.zMax, zPos);
+                    }
+                }
+            }
+        }
+    }
+
+    return box;
+}
+
+Point SparseGrid::gradient(unsigned int xPos, unsigned int yPos,
+            unsigned int zPos) const
+{
+    unsigned int xPrev = (xPos > 0) ? xPos - 1 : xPos;
+    unsigned int xNext = (xPos + 1 < fXDim) ? xPos + 1 : xPos;
+    unsigned int yPrev = (yPos > 0) ? yPos - 1 : yPos;
+    unsigned int yNext = (yPos + 1 < fYDim) ? yPos + 1 : yPos;
+    unsigned int zPrev = (zPos > 0) ? zPos - 1 : zPos;
+    unsigned int zNext = (zPos + 1 < fZDim) ? zPos + 1 : zPos;
+
+    Point result;
+    result.x = (value(xNext, yPos, zPos) - value(xPrev, yPos, zPos)) /
+                ((xNext - xPrev) * fXStep);
+    result.y = (value(xPos, yNext, zPos) - value(xPos, yPrev, zPos)) /
+                ((yNext - yPrev) * fYStep);
+    result.z = (value(xPos, yPos, zNext) - value(xPos, yPos, zPrev)) /
+                ((zNext - zPrev) * fZStep);
+    return result;
+}
+
+unsigned int SparseGrid::storedTileCount() const
+{
+    unsigned int count = 0;
+    for (int i = 0; i < fTiles.count(); i++)
+    {
+        if (fTiles[i])
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+qint64 SparseGrid::memoryUsage() const
+{
+    return static_cast<qint64>(storedTileCount()) * kTilePointCount *
+                sizeof(float) + static_cast<qint64>(fTiles.count()) *
+                (sizeof(float *) + 3 * sizeof(float));
+}
+
+void SparseGrid::fillWithFieldObject(FieldObject *fieldObject)
+{
+    unsigned int count = tileCount();
+    QVector<signed char> sides(count);
+    float tileValues[kTilePointCount];
+
+    freeTiles();
+    allocateTiles();
+    fSource = fieldObject;
+
+    unsigned int tile;
+    for (tile = 0; tile < count; tile++)
+    {
+        evaluateTile(fieldObject, tile, tileValues);
+        valuesRange(tile, tileValues, &fTileMinValues[tile],
+                    &fTileMaxValues[tile], &fTileValues[tile]);
+        sides[tile] = tileSide(tile);
+        if (sides[tile] == 0)
+        {
+            storeTile(tile);
+            memcpy(fTiles[tile], tileValues, sizeof(tileValues));
+        }
+    }
+
+    // Out of band tiles next to tiles which differ from them are needed
+    // too, as their values are vertex values of cells crossing tiles.
+    for (tile = 0; tile < count; tile++)
+    {
+        if (sides[tile] != 0 && hasNeighbourOnOtherSide(tile, sides))
+        {
+            storedTileValues(tile);
+        }
+    }
+
+    qDebug() << "Sparse grid filled, stored tiles:" << storedTileCount()
+                << "of" << count;
+}
+
+void SparseGrid::sumGrids(const QVector<SparseGrid *> &grids)
+{
+    QVector<SparseGrid *> operands;
+    for (int i = 0; i < grids.count(); i++)
+    {
+        const SparseGrid *grid = grids[i];
+        if (fXDim != grid->fXDim || fYDim != grid->fYDim ||
+                    fZDim != grid->fZDim)
+        {
+            qWarning() << "Different sparse grid dimentions, skipping grid"
+                        << "of" << grid->fXDim << "x" << grid->fYDim << "x"
+                        << grid->fZDim << "points";
+            continue;
+        }
+        operands.append(grids[i]);
+    }
+
+    unsigned int count = tileCount();
+    QVector<signed char> sides(count);
+
+    freeTiles();
+    allocateTiles();
+    fSource = 0;
+
+    // constant tiles of sum keep sum of operand means and bounds of sum of
+    // operand ranges
+    unsigned int tile;
+    int i;
+    for (tile = 0; tile < count; tile++)
+    {
+        for (i = 0; i < operands.count(); i++)
+        {
+            fTileValues[tile] += operands[i]->fTileValues[tile];
+            fTileMinValues[tile] += operands[i]->fTileMinValues[tile];
+            fTileMaxValues[tile] += operands[i]->fTileMaxValues[tile];
+        }
+        sides[tile] = tileSide(tile);
+    }
+
+    for (tile = 0; tile < count; tile++)
+    {
+        if (sides[tile] == 0 || hasNeighbourOnOtherSide(tile, sides))
+        {
+            sumTile(tile, operands);
+        }
+    }
+
+    qDebug() << "Sparse grids summed, stored tiles:" << storedTileCount()
+                << "of" << count;
+}
+
+void SparseGrid::prune()
+{
+    unsigned int count = tileCount();
+    QVector<signed char> sides(count);
+
+    unsigned int tile;
+    for (tile = 0; tile < count; tile++)
+    {
+        sides[tile] = tileSide(tile);
+    }
+
+    for (tile = 0; tile < count; tile++)
+    {
+        if (fTiles[tile] && sides[tile] != 0 &&
+                    !hasNeighbourOnOtherSide(tile, sides))
+        {
+            delete[] fTiles[tile];
+            fTiles[tile] = 0;
+        }
+    }
+}
+
+void SparseGrid::calculateSteps()
+{
+    // all sides have the same step, as in Grid
+    float step = (kMax - kMin) / qMax(qMax(fXDim, fYDim), fZDim);
+
+    fXStep = step;
+    fXMin = axisMin(fXDim, step);
+    fXTileDim = tileDimention(fXDim);
+
+    fYStep = step;
+    fYMin = axisMin(fYDim, step);
+    fYTileDim = tileDimention(fYDim);
+
+    fZStep = step;
+    fZMin = axisMin(fZDim, step);
+    fZTileDim = tileDimention(fZDim);
+}
+
+void SparseGrid::allocateTiles()
+{
+    unsigned int count = fXTileDim * fYTileDim * fZTileDim;
+    fTiles.fill(0, count);
+    fTileValues.fill(0.0, count);
+    fTileMinValues.fill(0.0, count);
+    fTileMaxValues.fill(0.0, count);
+}
+
+void SparseGrid::freeTiles()
+{
+    for (int i = 0; i < fTiles.count(); i++)
+    {
+        delete[] fTiles[i];
+    }
+    fTiles.clear();
+    fTileValues.clear();
+    fTileMinValues.clear();
+    fTileMaxValues.clear();
+    fSource = 0;
+}
+
+void SparseGrid::evaluateTile(FieldObject *fieldObject, unsigned int tile,
+            float *tileValues) const
+{
+    unsigned int xFirst = (tile % fXTileDim) << kTileSideBits;
+    unsigned int yFirst = ((tile / fXTileDim) % fYTileDim) << kTileSideBits;
+    unsigned int zFirst = (tile / (fXTileDim * fYTileDim)) << kTileSideBits;
+
+    unsigned int xLast = qMin(xFirst + kTileSide, fXDim);
+    unsigned int yLast = qMin(yFirst + kTileSide, fYDim);
+    unsigned int zLast = qMin(zFirst + kTileSide, fZDim);
+
+    Point p;
+    unsigned int xPos, yPos, zPos;
+    for (zPos = zFirst; zPos < zLast; zPos++)
+    {
+        p.z = zCoord(zPos);
+        for (yPos = yFirst; yPos < yLast; yPos++)
+        {
+            p.y = yCoord(yPos);
+            for (xPos = xFirst; xPos < xLast; xPos++)
+            {
+                p.x = xCoord(xPos);
+                tileValues[tilePointIndex(xPos, yPos, zPos)] =
+                            fieldObject->valueAtPoint(p);
+            }
+        }
+    }
+}
+
+void SparseGrid::valuesRange(unsigned int tile, const float *tileValues,
+            float *minValue, float *maxValue, float *meanValue) const
+{
+    unsigned int xFirst = (tile % fXTileDim) << kTileSideBits;
+    unsigned int yFirst = ((tile / fXTileDim) % fYTileDim) << kTileSideBits;
+    unsigned int zFirst = (tile / (fXTileDim * fYTileDim)) << kTileSideBits;
+
+    // points of border tiles which are out of grid are not used
+    unsigned int xCount = qMin(kTileSide, fXDim - xFirst);
+    unsigned int yCount = qMin(kTileSide, fYDim - yFirst);
+    unsigned int zCount = qMin(kTileSide, fZDim - zFirst);
+
+    *minValue = tileValues[0];
+    *maxValue = tileValues[0];
+    double sum = 0.0;
+
+    unsigned int xPos, yPos, zPos;
+    for (zPos = 0; zPos < zCount; zPos++)
+    {
+        for (yPos = 0; yPos < yCount; yPos++)
+        {
+            const float *row = tileValues + tilePointIndex(0, yPos, zPos);
+            for (xPos = 0; xPos < xCount; xPos++)
+            {
+                *minValue = qMin(*minValue, row[xPos]);
+                *maxValue = qMax(*maxValue, row[xPos]);
+                sum += row[xPos];
+            }
+        }
+    }
+
+    *meanValue = sum / (xCount * yCount * zCount);
+}
+
+void SparseGrid::updateTileRange(unsigned int tile)
+{
+    valuesRange(tile, fTiles[tile], &fTileMinValues[tile],
+                &fTileMaxValues[tile], &fTileValues[tile]);
+}
+
+int SparseGrid::rangeSide(float minValue, float maxValue) const
+{
+    if (maxValue < fIsoLevel - fBandWidth)
+    {
+        return -1;
+    }
+    if (minValue >= fIsoLevel + fBandWidth)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+bool SparseGrid::hasNeighbourOnOtherSide(unsigned int tile,
+            const QVector<signed char> &sides) const
+{
+    int xTile = tile % fXTileDim;
+    int yTile = (tile / fXTileDim) % fYTileDim;
+    int zTile = tile / (fXTileDim * fYTileDim);
+
+    int xPos, yPos, zPos;
+    for (zPos = qMax(zTile - 1, 0);
+                zPos <= qMin(zTile + 1, (int)fZTileDim - 1); zPos++)
+    {
+        for (yPos = qMax(yTile - 1, 0);
+                    yPos <= qMin(yTile + 1, (int)fYTileDim - 1); yPos++)
+        {
+            for (xPos = qMax(xTile - 1, 0);
+                        xPos <= qMin(xTile + 1, (int)fXTileDim - 1); xPos++)
+            {
+                if (sides[tileIndex(xPos, yPos, zPos)] != sides[tile])
+                {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void SparseGrid::storeTile(unsigned int tile)
+{
+    if (fTiles[tile])
+    {
+        return;
+    }
+
+    float *tileValues = new float[kTilePointCount];
+    for (unsigned int i = 0; i < kTilePointCount; i++)
+    {
+        tileValues[i] = fTileValues[tile];
+    }
+    fTiles[tile] = tileValues;
+}
+
+const float *SparseGrid::storedTileValues(unsigned int tile)
+{
+    if (!fTiles[tile])
+    {
+        storeTile(tile);
+        if (fSource)
+        {
+            evaluateTile(fSource, tile, fTiles[tile]);
+        }
+    }
+    return fTiles[tile];
+}
+
+void SparseGrid::sumTile(unsigned int tile, const QVector<SparseGrid *> &grids)
+{
+    storeTile(tile);
+    float *tileValues = fTiles[tile];
+    memset(tileValues, 0, kTilePointCount * sizeof(float));
+
+    for (int i = 0; i < grids.count(); i++)
+    {
+        const float *otherValues = grids[i]->storedTileValues(tile);
+        for (unsigned int j = 0; j < kTilePointCount; j++)
+        {
+            tileValues[j] += otherValues[j];
+        }
+    }
+
+    // exact range instead of bounds
+    updateTileRange(tile);
+}
@@ -0,0 +1,190 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * sparsegrid.h is part of 3D Meta-Object-based Modelling System             *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SPARSEGRID_H
+#define SPARSEGRID_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include "space_types.h"
+
+class FieldObject;
+class Grid;
+
+const unsigned int kTileSideBits = 3;
+const unsigned int kTileSide = 1 << kTileSideBits; // in points.
+const unsigned int kTilePointCount = kTileSide * kTileSide * kTileSide;
+
+// Represents narrow band sparse version of Grid (same point positions for
+// same dimentions). Grid points are split into tiles of kTileSide^3 points
+// and values are stored only in tiles near isosurface (values which differ
+// from isosurface level by less than band width, and tiles next to ones on
+// the other side of isosurface). Every other tile is represented by one
+// constant value (mean of its values) and by range of its values, so memory
+// depends on isosurface area rather than on grid volume. Cells crossed by
+// isosurface always have all of their vertexes in stored tiles, so
+// poligonization of sparse grid gives same triangles as poligonization of
+// dense one. Grid filled with a field-object remembers it, so its constant
+// tiles may be evaluated again when their values are needed.
+class SparseGrid
+{
+public:
+    SparseGrid(unsigned int xDim, unsigned int yDim, unsigned int zDim);
+    ~SparseGrid();
+
+    void setSidesDimention(int dim);
+    // Takes dimentions and point positions (bounds and steps) of given grid,
+    // point values are dropped.
+    void setGeometry(const Grid *grid);
+
+    inline float isoLevel() const { return fIsoLevel; }
+    inline float bandWidth() const { return fBandWidth; }
+    // Changing band takes effect on next fill, sum or prune.
+    void setBand(float isoLevel, float bandWidth);
+    // Isosurface of given level is poligonized exactly (there are no
+    // constant tiles it may cross).
+    inline bool isInBand(float isoLevel) const
+                { return qAbs(isoLevel - fIsoLevel) <= fBandWidth; }
+
+    inline float xMin() const { return fXMin; }
+    inline float xStep() const { return fXStep; }
+    inline unsigned int xDimention() const { return fXDim; } // in points.
+
+    inline float yMin() const { return fYMin; }
+    inline float yStep() const { return fYStep; }
+    inline unsigned int yDimention() const { return fYDim; } // in points.
+
+    inline float zMin() const { return fZMin; }
+    inline float zStep() const { return fZStep; }
+    inline unsigned int zDimention() const { return fZDim; } // in points.
+
+    inline float xCoord(unsigned int xPos) const
+                { return fXMin + (xPos * fXStep); }
+    inline float yCoord(unsigned int yPos) const
+                { return fYMin + (yPos * fYStep); }
+    inline float zCoord(unsigned int zPos) const
+                { return fZMin + (zPos * fZStep); }
+
+    inline float value(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos) const
+    {
+        unsigned int tile = tileIndex(xPos >> kTileSideBits,
+                    yPos >> kTileSideBits, zPos >> kTileSideBits);
+        const float *tileValues = fTiles[tile];
+        if (!tileValues)
+        {
+            return fTileValues[tile];
+        }
+        return tileValues[tilePointIndex(xPos, yPos, zPos)];
+    }
+    // Box of points which values are not below isoLevel, see
+    // Grid::insidePointsBox(). Constant tiles which range includes isoLevel
+    // are taken as a whole.
+    GridBox insidePointsBox(float isoLevel) const;
+    // Central differences inside of the grid, one-sided on its borders.
+    Point gradient(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos) const;
+
+    inline unsigned int xTileDimention() const { return fXTileDim; }
+    inline unsigned int yTileDimention() const { return fYTileDim; }
+    inline unsigned int zTileDimention() const { return fZTileDim; }
+    inline unsigned int tileCount() const { return fTiles.count(); }
+    inline unsigned int tileIndex(unsigned int xTile, unsigned int yTile,
+                unsigned int zTile) const
+                { return (fXTileDim * fYTileDim * zTile) +
+                (fXTileDim * yTile) + xTile; }
+    inline bool isTileStored(unsigned int tile) const
+                { return fTiles[tile] != 0; }
+    unsigned int storedTileCount() const;
+    // Memory used by point values in bytes.
+    qint64 memoryUsage() const;
+
+    // Field-object is kept as source of grid values, it must stay unchanged
+    // as long as grid is used as operand of sumGrids().
+    void fillWithFieldObject(FieldObject *fieldObject);
+    // Sets values to sum of given grids (of the same dimentions). Bounds of
+    // a tile sum are sums of operand tile ranges, tiles which sum may reach
+    // the band get exact values: constant operand tiles are evaluated again
+    // by their sources (and are stored in operands, so they are evaluated
+    // once). Grid has no source afterwards.
+    void sumGrids(const QVector<SparseGrid *> &grids);
+    // Replaces tiles which are out of band with constant ones.
+    void prune();
+
+protected:
+    void calculateSteps();
+    void allocateTiles();
+    void freeTiles();
+
+    inline unsigned int tilePointIndex(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos) const
+    {
+        const unsigned int mask = kTileSide - 1;
+        return ((zPos & mask) << (2 * kTileSideBits)) |
+                    ((yPos & mask) << kTileSideBits) | (xPos & mask);
+    }
+
+    void evaluateTile(FieldObject *fieldObject, unsigned int tile,
+                float *tileValues) const;
+    // Range and mean of values of grid points of a tile.
+    void valuesRange(unsigned int tile, const float *tileValues,
+                float *minValue, float *maxValue, float *meanValue) const;
+    void updateTileRange(unsigned int tile);
+    // -1 if all values of range are below band, 1 if all are above, else 0.
+    int rangeSide(float minValue, float maxValue) const;
+    inline int tileSide(unsigned int tile) const
+                { return rangeSide(fTileMinValues[tile],
+                fTileMaxValues[tile]); }
+    bool hasNeighbourOnOtherSide(unsigned int tile,
+                const QVector<signed char> &sides) const;
+    void storeTile(unsigned int tile);
+    // Stores constant tile, its values are evaluated by source if grid has
+    // one.
+    const float *storedTileValues(unsigned int tile);
+    void sumTile(unsigned int tile, const QVector<SparseGrid *> &grids);
+
+private: // data
+    QVector<float *> fTiles; // 0 for constant tiles.
+    QVector<float> fTileValues; // values of constant tiles.
+    QVector<float> fTileMinValues; // ranges of all tiles.
+    QVector<float> fTileMaxValues;
+    FieldObject *fSource; // grid is filled with, 0 if none.
+
+    float fIsoLevel;
+    float fBandWidth;
+
+    float fXMin;
+    float fXStep;
+    unsigned int fXDim;
+    unsigned int fXTileDim;
+
+    float fYMin;
+    float fYStep;
+    unsigned int fYDim;
+    unsigned int fYTileDim;
+
+    float fZMin;
+    float fZStep;
+    unsigned int fZDim;
+    unsigned int fZTileDim;
+};
+
+#endif // SPARSEGRID_H
@@ -34,11 +34,26 @@
 #include <QFile>
 #include <QIODevice>
 #include <QDebug>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFileInfo>
+#include <QThreadPool>
 
 #include "mainwindow.h"
 #include "postfixexpr.h"
 #include "metaobject.h"
 #include "metaobjectscontroller.h"
+#include "batchjob.h"
+#include "scenegenerator.h"
+
+const char kBatchUsage[] = "Usage: dip2 --batch document.mox... "
+            "--out mesh.ply [--grid dim] [--iso level] "
+            "[--normals flat|smooth|gradient] "
+            "[--extraction cubes|nets|tetrahedrons|octree] "
+            "[--octree-depth depth] [--grid-kind dense|sparse] "
+            "[--sweep variable=first:last:steps] [--threads count]";
+const char kGenerateUsage[] = "Usage: dip2 --generate propeller document.mox "
+            "[bladeCount=5] [bladeTilt=0.55] [axisRadius=1.5] [yzDim=80]";
 
 double getSecondsPassed()
 {
@@ -48,51 +63,245 @@ double getSecondsPassed()
     return 0.000000001 * ts.tv_nsec + ts.tv_sec;
 }
 
-int main(int argc, char *argv[])
+// Runs headless batch jobs given by command line arguments, returns exit
+// status. Every document is a job, output file name gets document name
+// appended if there are several of them.
+int runBatch(const QStringList &arguments)
 {
-    QApplication app(argc, argv);
-    double seconds = getSecondsPassed();
-    MainWindow *window = new MainWindow();
-    window->show();
-    seconds = getSecondsPassed() - seconds;
-    std::cout << "Init duration = " << seconds << std::endl;
-    return app.exec();
+    QStringList inputFileNames;
+    QString outputFileName;
+    unsigned int gridDim = 0;
+    bool isoLevelSet = false;
+    float isoLevel = 0.0;
+    int normalMode = 0;
+    int extractionMode = 0;
+    unsigned int octreeDepth = 0;
+    int gridKind = 0;
+    QString sweepVariableName;
+    double sweepFirstValue = 0.0;
+    double sweepLastValue = 0.0;
+    int sweepStepCount = 0;
+    int threadCount = 0;
 
-    ////////// Performance tests: ///////////
-    /*
-    if (argc == 2)
+    bool ok = true;
+    int argument = 1;
+    while (ok && argument < arguments.count())
+    {
+        QString option = arguments[argument++];
+        QString value = (argument < arguments.count()) ?
+                    arguments[argument++] : QString();
+        ok = !value.isEmpty();
+        if (option == "--batch")
+        {
+            inputFileNames.append(value);
+            while (argument < arguments.count() &&
+                        !arguments[argument].startsWith("--"))
+            {
+                inputFileNames.append(arguments[argument++]);
+            }
+        }
+        else if (option == "--out")
+        {
+            outputFileName = value;
+        }
+        else if (option == "--grid")
+        {
+            gridDim = value.toUInt(&ok);
+            ok = ok && gridDim >= 2;
+        }
+        else if (option == "--iso")
+        {
+            isoLevel = value.toFloat(&ok);
+            isoLevelSet = true;
+        }
+        else if (option == "--normals")
+        {
+            normalMode = (value == "flat") ? FLAT : (value == "smooth") ?
+                        SMOOTH : (value == "gradient") ? GRADIENT : 0;
+            ok = normalMode != 0;
+        }
+        else if (option == "--extraction")
+        {
+            extractionMode = (value == "cubes") ? MARCHING_CUBES :
+                        (value == "nets") ? SURFACE_NETS :
+                        (value == "tetrahedrons") ? MARCHING_TETRAHEDRONS :
+                        (value == "octree") ? DUAL_MARCHING_CUBES : 0;
+            ok = extractionMode != 0;
+        }
+        else if (option == "--octree-depth")
+        {
+            octreeDepth = value.toUInt(&ok);
+            ok = ok && octreeDepth >= 1;
+        }
+        else if (option == "--grid-kind")
+        {
+            gridKind = (value == "dense") ? DENSE_GRID :
+                        (value == "sparse") ? SPARSE_GRID : 0;
+            ok = gridKind != 0;
+        }
+        else if (option == "--sweep")
+        {
+            int equalsPos = value.indexOf('=');
+            QStringList range(value.mid(equalsPos + 1).split(':'));
+            sweepVariableName = value.left(equalsPos);
+            ok = equalsPos > 0 && range.count() == 3;
+            if (ok)
+            {
+                sweepFirstValue = range[0].toDouble(&ok);
+            }
+            if (ok)
+            {
+                sweepLastValue = range[1].toDouble(&ok);
+            }
+            if (ok)
+            {
+                sweepStepCount = range[2].toInt(&ok);
+                ok = ok && sweepStepCount > 0;
+            }
+        }
+        else if (option == "--threads")
+        {
+            threadCount = value.toInt(&ok);
+            ok = ok && threadCount > 0;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+    if (!ok || inputFileNames.isEmpty() || outputFileName.isEmpty())
     {
-        double seconds = getSecondsPassed();
-        QApplication app(argc, argv);
+        std::cerr << kBatchUsage << std::endl;
+        return 1;
+    }
 
-        QFile xmlData(argv[1]);
+    if (threadCount > 0)
+    {
+        QThreadPool::globalInstance()->setMaxThreadCount(threadCount);
+    }
 
-        QByteArray fieldXMLData;
-        QBuffer fieldXMLBuffer(&fieldXMLData);
-        fieldXMLBuffer.open(QIODevice::WriteOnly);
+    QList<BatchJob> jobs;
+    for (int i = 0; i < inputFileNames.count(); i++)
+    {
+        BatchJob job(inputFileNames[i], (inputFileNames.count() > 1) ?
+                    BatchJob::outputFileName(outputFileName,
+                    QFileInfo(inputFileNames[i]).completeBaseName()) :
+                    outputFileName);
+        if (gridDim > 0)
+        {
+            job.setGridSidesDimention(gridDim);
+        }
+        if (isoLevelSet)
+        {
+            job.setIsoLevel(isoLevel);
+        }
+        if (normalMode != 0)
+        {
+            job.setNormalMode(static_cast<NormalMode>(normalMode));
+        }
+        if (extractionMode != 0)
+        {
+            job.setExtractionMode(
+                        static_cast<ExtractionMode>(extractionMode));
+        }
+        if (octreeDepth > 0)
+        {
+            job.setOctreeDepth(octreeDepth);
+        }
+        if (gridKind != 0)
+        {
+            job.setGridKind(static_cast<GridKind>(gridKind));
+        }
+        if (!sweepVariableName.isEmpty())
+        {
+            job.setSweep(sweepVariableName, sweepFirstValue, sweepLastValue,
+                        sweepStepCount);
+        }
+        jobs.append(job);
+    }
 
-        QXmlQuery query;
-        QXmlSerializer fieldSerializer(query, &fieldXMLBuffer);
+    bool result = BatchJob::runConcurrently(&jobs);
+    for (int i = 0; i < jobs.count(); i++)
+    {
+        if (jobs[i].succeeded())
+        {
+            std::cout << inputFileNames[i].toLocal8Bit().constData() <<
+                        ":" << std::endl <<
+                        jobs[i].timingReport().toLocal8Bit().constData();
+        }
+    }
+    return result ? 0 : 1;
+}
 
-        xmlData.open(QIODevice::ReadOnly);
-        query.bindVariable("document", &xmlData);
+// Writes generated document given by command line arguments, returns exit
+// status.
+int runGenerator(const QStringList &arguments)
+{
+    QMap<QString, double> parameters;
+    parameters.insert("bladeCount", 5.0);
+    parameters.insert("bladeTilt", 0.55);
+    parameters.insert("axisRadius", 1.5);
+    parameters.insert("yzDim", 80.0);
 
-        query.setQuery("fn:doc($document)/document/field");
-        query.evaluateTo(&fieldSerializer);
-        xmlData.close();
+    bool ok = arguments.count() >= 4 && arguments[2] == "propeller";
+    for (int i = 4; ok && i < arguments.count(); i++)
+    {
+        int equalsPos = arguments[i].indexOf('=');
+        QString name = arguments[i].left(equalsPos);
+        ok = equalsPos > 0 && parameters.contains(name);
+        if (ok)
+        {
+            parameters[name] = arguments[i].mid(equalsPos + 1).toDouble(&ok);
+        }
+    }
+    ok = ok && parameters["bladeCount"] >= 1.0 && parameters["yzDim"] >= 2.0;
+    if (!ok)
+    {
+        std::cerr << kGenerateUsage << std::endl;
+        return 1;
+    }
 
-        MetaObjectsController controller;
-        controller.initWithXML(&fieldXMLBuffer);
+    SceneGenerator generator = SceneGenerator::propeller(
+                static_cast<int>(parameters["bladeCount"]),
+                parameters["bladeTilt"], parameters["axisRadius"],
+                static_cast<unsigned int>(parameters["yzDim"]));
 
-        seconds = getSecondsPassed() - seconds;
-        std::cout << "Init duration = " << seconds << std::endl;
-    }
-    else
+    QFile documentFile(arguments[3]);
+    if (!documentFile.open(QIODevice::WriteOnly) ||
+                documentFile.write(generator.documentXMLData()) < 0)
     {
-        std::cout << "Usage: ./dip2 benchmark.mox" << std::endl;
+        qWarning() << "Can't write document" << arguments[3];
+        return 1;
     }
+    documentFile.close();
+
+    std::cout << generator.metaObjectCount() << " meta-objects written" <<
+                std::endl;
     return 0;
-    */
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && QString(argv[1]) == "--batch")
+    {
+        // no windows (and no display connection) in batch mode
+        QCoreApplication app(argc, argv);
+        return runBatch(app.arguments());
+    }
+    if (argc > 1 && QString(argv[1]) == "--generate")
+    {
+        QCoreApplication app(argc, argv);
+        return runGenerator(app.arguments());
+    }
+
+    QApplication app(argc, argv);
+    double seconds = getSecondsPassed();
+    MainWindow *window = new MainWindow();
+    window->show();
+    seconds = getSecondsPassed() - seconds;
+    std::cout << "Init duration = " << seconds << std::endl;
+    return app.exec();
+
     ////////// XML tests: ///////////
 
     //QApplication app(argc, argv);
@@ -0,0 +1,203 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * classification.cpp is part of 3D Meta-Object-based Modelling System       *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <QtGlobal>
+
+#include "grid.h"
+#include "classification.h"
+
+namespace SignBits
+{
+    // Returns sign bits of 32 points of given row word together with sign
+    // bits of next word, as the last cell of a word needs the first point of
+    // the next one.
+    inline unsigned long long window(const unsigned int *row,
+                unsigned int word, unsigned int wordCount)
+    {
+        unsigned long long result = row[word];
+        if (word + 1 < wordCount)
+        {
+            result |= static_cast<unsigned long long>(row[word + 1]) << 32;
+        }
+        return result;
+    }
+
+    // Classifies rows [yMin, yMax] of given z plane, row starts at xMin and
+    // holds count points, rowBuffer is used for rows which are not
+    // contiguous in grid memory.
+    void classifyPlane(const Grid *grid, int zPos, int xMin, int yMin,
+                int yMax, unsigned int count, float isoLevel,
+                unsigned int wordCount, unsigned int *plane,
+                float *rowBuffer)
+    {
+        for (int yPos = yMin; yPos <= yMax; yPos++)
+        {
+            Classification::classifyRow(grid->rowValues(xMin, yPos, zPos,
+                        count, rowBuffer), count, isoLevel,
+                        plane + (yPos - yMin) * wordCount);
+        }
+    }
+}
+
+using namespace SignBits;
+
+void Classification::classifyRow(const float *values, unsigned int count,
+            float isoLevel, unsigned int *signs)
+{
+    memset(signs, 0, ((count + 31) / 32) * sizeof(unsigned int));
+
+    unsigned int i = 0;
+#ifdef __SSE__
+    // 4 points per compare, i is always a multiple of 4 here so the 4 mask
+    // bits never cross a word boundary.
+    __m128 iso = _mm_set1_ps(isoLevel);
+    for (; i + 4 <= count; i += 4)
+    {
+        unsigned int mask = _mm_movemask_ps(
+                    _mm_cmplt_ps(_mm_loadu_ps(values + i), iso));
+        signs[i >> 5] |= mask << (i & 31);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if (values[i] < isoLevel)
+        {
+            signs[i >> 5] |= 1u << (i & 31);
+        }
+    }
+}
+
+void Classification::classifyCells(const Grid *grid, float isoLevel,
+            const GridBox &cellsBox, QVector<unsigned char> *cubeIndices,
+            QVector<GridIndex> *activeCells)
+{
+    activeCells->clear();
+
+    if (cellsBox.xMin > cellsBox.xMax || cellsBox.yMin > cellsBox.yMax ||
+                cellsBox.zMin > cellsBox.zMax)
+    {
+        return;
+    }
+
+    int xCellDim = grid->xDimention() - 1;
+    int yCellDim = grid->yDimention() - 1;
+
+    // box rows hold one point more than cells
+    unsigned int boxCellCount = cellsBox.xMax - cellsBox.xMin + 1;
+    unsigned int wordCount = (boxCellCount + 1 + 31) / 32;
+    int planeRowCount = cellsBox.yMax - cellsBox.yMin + 2;
+    unsigned int planeSize = planeRowCount * wordCount;
+
+    QVector<unsigned int> planes(2 * planeSize);
+    QVector<float> rowBuffer(boxCellCount + 1);
+    unsigned int *lowerPlane = planes.data();
+    unsigned int *upperPlane = lowerPlane + planeSize;
+
+    classifyPlane(grid, cellsBox.zMin, cellsBox.xMin, cellsBox.yMin,
+                cellsBox.yMax + 1, boxCellCount + 1, isoLevel, wordCount,
+                lowerPlane, rowBuffer.data());
+
+    unsigned char *cellIndices = cubeIndices->data();
+
+    for (int zPos = cellsBox.zMin; zPos <= cellsBox.zMax; zPos++)
+    {
+        classifyPlane(grid, zPos + 1, cellsBox.xMin, cellsBox.yMin,
+                    cellsBox.yMax + 1, boxCellCount + 1, isoLevel, wordCount,
+                    upperPlane, rowBuffer.data());
+
+        for (int yPos = cellsBox.yMin; yPos <= cellsBox.yMax; yPos++)
+        {
+            const unsigned int *row00 =
+                        lowerPlane + (yPos - cellsBox.yMin) * wordCount;
+            const unsigned int *row10 = row00 + wordCount;
+            const unsigned int *row01 =
+                        upperPlane + (yPos - cellsBox.yMin) * wordCount;
+            const unsigned int *row11 = row01 + wordCount;
+
+            GridIndex rowCellIndex =
+                        (static_cast<GridIndex>(xCellDim) * yCellDim * zPos) +
+                        (static_cast<GridIndex>(xCellDim) * yPos) +
+                        cellsBox.xMin;
+
+            for (unsigned int word = 0; word < wordCount; word++)
+            {
+                unsigned int firstCell = word * 32;
+                if (firstCell >= boxCellCount)
+                {
+                    break;
+                }
+
+                unsigned int wordCellCount =
+                            qMin(32u, boxCellCount - firstCell);
+                unsigned long long mask = (2ULL << wordCellCount) - 1;
+
+                unsigned long long b00 = window(row00, word, wordCount);
+                unsigned long long b10 = window(row10, word, wordCount);
+                unsigned long long b01 = window(row01, word, wordCount);
+                unsigned long long b11 = window(row11, word, wordCount);
+
+                GridIndex wordCellIndex = rowCellIndex + firstCell;
+                unsigned char *wordCellIndices = cellIndices + wordCellIndex;
+
+                // whole word of cells is totally below or above isosurface
+                if ((b00 & b10 & b01 & b11 & mask) == mask)
+                {
+                    memset(wordCellIndices, 255, wordCellCount);
+                    continue;
+                }
+                if (((b00 | b10 | b01 | b11) & mask) == 0)
+                {
+                    memset(wordCellIndices, 0, wordCellCount);
+                    continue;
+                }
+
+                for (unsigned int i = 0; i < wordCellCount; i++)
+                {
+                    // vertex numeration is the same as in GridCell
+                    unsigned int index =
+                                ((b00 >> i) & 1) |
+                                ((b00 >> i) & 2) |
+                                (((b10 >> i) & 2) << 1) |
+                                (((b10 >> i) & 1) << 3) |
+                                (((b01 >> i) & 1) << 4) |
+                                (((b01 >> i) & 2) << 4) |
+                                (((b11 >> i) & 2) << 5) |
+                                (((b11 >> i) & 1) << 7);
+
+                    wordCellIndices[i] = index;
+                    if (index != 0 && index != 255)
+                    {
+                        activeCells->append(wordCellIndex + i);
+                    }
+                }
+            }
+        }
+
+        unsigned int *tmpPlane = lowerPlane;
+        lowerPlane = upperPlane;
+        upperPlane = tmpPlane;
+    }
+}
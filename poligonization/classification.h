@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * classification.h is part of 3D Meta-Object-based Modelling System         *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLASSIFICATION_H
+#define CLASSIFICATION_H
+
+#include <QVector>
+
+#include "space_types.h"
+
+class Grid;
+
+// Represents set of functions for cheap marching cubes pre-pass. Whole X-rows
+// of grid point values are compared against isosurface level at once (with
+// SSE when available) giving packed sign bits, which are then combined into
+// cube indices of all grid cells. Only "active" cells (ones that are crossed
+// by isosurface) need to go through interpolation stage.
+namespace Classification
+{
+    // Sets bit i of signs if values[i] < isoLevel, signs must hold at least
+    // (count + 31) / 32 words.
+    void classifyRow(const float *values, unsigned int count, float isoLevel,
+                unsigned int *signs);
+
+    // Fills cubeIndices with marching cubes index of each grid cell inside
+    // of given box of cells (cells are ordered same way as in Poligonizator,
+    // cubeIndices has to hold cellCount() items) and activeCells with indexes
+    // of those cells which cube index is neither 0 nor 255.
+    void classifyCells(const Grid *grid, float isoLevel,
+                const GridBox &cellsBox, QVector<unsigned char> *cubeIndices,
+                QVector<GridIndex> *activeCells);
+}
+
+#endif // CLASSIFICATION_H
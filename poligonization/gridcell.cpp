@@ -69,7 +69,7 @@ namespace MarchingCubes
 using namespace MarchingCubes;
 
 GridCell::GridCell() : fGridPtr(0), fXPos(0), fYPos(0), fZPos(0),
-            fIsoLevel(2.0), fHasTriangles(false),
+            fIsoLevel(2.0), fCubeIndex(0), fHasTriangles(false),
             fTriangles(QVector<TriangleN>(0))
 {
     for (int i = 0; i < 8; i++)
@@ -78,16 +78,34 @@ GridCell::GridCell() : fGridPtr(0), fXPos(0), fYPos(0), fZPos(0),
         fPoints[i] = p;
         fPointValues[i] = 0.0;
     }
+    fNetVertex.p = fPoints[0];
+    fNetVertex.n = fPoints[0];
 }
 
 GridCell::GridCell(const Grid *gridPtr,
             unsigned int xPos, unsigned int yPos, unsigned int zPos)
             : fGridPtr(gridPtr), fXPos(xPos), fYPos(yPos), fZPos(zPos),
-            fIsoLevel(2.0), fHasTriangles(true),
+            fIsoLevel(2.0), fCubeIndex(0), fHasTriangles(true),
             fTriangles(QVector<TriangleN>(0))
 {
     recalculatePoints();
     recalculatePointValues();
+    fNetVertex.p = fPoints[0];
+    fNetVertex.n = fPoints[0];
+}
+
+GridCell::GridCell(const Point *points, const float *pointValues)
+            : fGridPtr(0), fXPos(0), fYPos(0), fZPos(0),
+            fIsoLevel(2.0), fCubeIndex(0), fHasTriangles(true),
+            fTriangles(QVector<TriangleN>(0))
+{
+    for (int i = 0; i < 8; i++)
+    {
+        fPoints[i] = points[i];
+        fPointValues[i] = pointValues[i];
+    }
+    fNetVertex.p = fPoints[0];
+    fNetVertex.n = fPoints[0];
 }
 
 GridCell::GridCell(const GridCell &copyee)
@@ -99,9 +117,11 @@ GridCell::GridCell(const GridCell &copyee)
     fZPos = copyee.fZPos;
 
     fIsoLevel = copyee.fIsoLevel;
+    fCubeIndex = copyee.fCubeIndex;
 
     fHasTriangles = copyee.fHasTriangles;
     fTriangles = copyee.fTriangles;
+    fNetVertex = copyee.fNetVertex;
 
     for (int i = 0; i < 8; i++)
     {
@@ -110,14 +130,16 @@ GridCell::GridCell(const GridCell &copyee)
     }
 }
 
-void GridCell::recalculateTriangles(bool performPointValuesRecalculation)
+void GridCell::recalculateTriangles(bool performPointValuesRecalculation,
+            int cubeIndex)
 {
     if (performPointValuesRecalculation)
     {
         recalculatePointValues();
     }
 
-    QVector<Triangle> unnormalizedTriangles(trianglesMarchingCubes(fIsoLevel));
+    QVector<Triangle> unnormalizedTriangles(trianglesMarchingCubes(fIsoLevel,
+                cubeIndex));
     int triangleCount = unnormalizedTriangles.count();
 
     fTriangles.clear();
@@ -137,6 +159,177 @@ void GridCell::recalculateTriangles(bool performPointValuesRecalculation)
     }
 }
 
+void GridCell::clearTriangles()
+{
+    fTriangles.clear();
+    fHasTriangles = false;
+}
+
+void GridCell::relerpTriangles(float isoLevel)
+{
+    fIsoLevel = isoLevel;
+
+    if (!fHasTriangles)
+    {
+        return;
+    }
+
+    Point vertexList[12];
+    crossPoints(isoLevel, fCubeIndex, fPoints, vertexList);
+
+    Triangle triangle;
+    int triangleCount = fTriangles.count();
+    for (int i = 0; i < triangleCount; i++)
+    {
+        triangle.p[0] = vertexList[kTriTable[fCubeIndex][3 * i]];
+        triangle.p[1] = vertexList[kTriTable[fCubeIndex][3 * i + 1]];
+        triangle.p[2] = vertexList[kTriTable[fCubeIndex][3 * i + 2]];
+        fTriangles[i] = normalizeTriangle(triangle);
+    }
+}
+
+QVector<TriangleN> GridCell::gradientNormalizedTriangles() const
+{
+    if (!fHasTriangles)
+    {
+        return QVector<TriangleN>(0);
+    }
+
+    Point gradients[8];
+    for (int i = 0; i < 8; i++)
+    {
+        gradients[i] = pointGradient(fXPos + kVertexOffsets[i][0],
+                    fYPos + kVertexOffsets[i][1],
+                    fZPos + kVertexOffsets[i][2]);
+    }
+
+    QVector<TriangleN> resTriangles(fTriangles);
+    setGradientNormals(&resTriangles, gradients, fPoints[0],
+                vector(fPoints[6], fPoints[0]));
+
+    return resTriangles;
+}
+
+QVector<TriangleN> GridCell::gradientNormalizedTriangles(
+            const Point *gradients) const
+{
+    if (!fHasTriangles)
+    {
+        return QVector<TriangleN>(0);
+    }
+
+    // gradients are interpolated along crossed edges like vertexes are
+    Point gradientList[12];
+    crossPoints(fIsoLevel, fCubeIndex, gradients, gradientList);
+
+    QVector<TriangleN> resTriangles(fTriangles);
+    int triangleCount = resTriangles.count();
+    Point gradient;
+    int i, j;
+    for (i = 0; i < triangleCount; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            gradient = gradientList[kTriTable[fCubeIndex][3 * i + j]];
+            // field decreases outwards, so normal is opposite to gradient
+            resTriangles[i].p[j].n.x = -gradient.x;
+            resTriangles[i].p[j].n.y = -gradient.y;
+            resTriangles[i].p[j].n.z = -gradient.z;
+        }
+    }
+
+    return resTriangles;
+}
+
+void GridCell::recalculateTetrahedronTriangles(
+            bool performPointValuesRecalculation, int cubeIndex)
+{
+    if (performPointValuesRecalculation)
+    {
+        recalculatePointValues();
+    }
+
+    if (cubeIndex < 0)
+    {
+        cubeIndex = calculateCubeIndex(fIsoLevel);
+    }
+
+    // at most 2 triangles per each of 6 tetrahedrons
+    Triangle unnormalizedTriangles[12];
+    int triangleCount = trianglesMarchingTetrahedrons(fIsoLevel, cubeIndex,
+                unnormalizedTriangles);
+
+    fCubeIndex = cubeIndex;
+    fHasTriangles = triangleCount > 0;
+    fTriangles.resize(triangleCount);
+    for (int i = 0; i < triangleCount; i++)
+    {
+        fTriangles[i] = normalizeTriangle(unnormalizedTriangles[i]);
+    }
+}
+
+void GridCell::recalculateNetVertex(bool performPointValuesRecalculation,
+            int cubeIndex)
+{
+    if (performPointValuesRecalculation)
+    {
+        recalculatePointValues();
+    }
+
+    if (cubeIndex < 0)
+    {
+        cubeIndex = calculateCubeIndex(fIsoLevel);
+    }
+
+    fTriangles.clear();
+    fCubeIndex = cubeIndex;
+    fHasTriangles = kEdgeTable[cubeIndex] != 0;
+    if (!fHasTriangles)
+    {
+        return;
+    }
+
+    Point gradients[8];
+    for (int i = 0; i < 8; i++)
+    {
+        gradients[i] = pointGradient(fXPos + kVertexOffsets[i][0],
+                    fYPos + kVertexOffsets[i][1],
+                    fZPos + kVertexOffsets[i][2]);
+    }
+
+    Point vertexList[12];
+    Point normalList[12];
+    crossPoints(fIsoLevel, cubeIndex, fPoints, vertexList);
+    crossPoints(fIsoLevel, cubeIndex, gradients, normalList);
+
+    PointN netVertex;
+    Point zero = { 0.0, 0.0, 0.0 };
+    netVertex.p = zero;
+    netVertex.n = zero;
+
+    int crossPointCount = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        if (kEdgeTable[cubeIndex] & (1 << i))
+        {
+            netVertex.p.x += vertexList[i].x;
+            netVertex.p.y += vertexList[i].y;
+            netVertex.p.z += vertexList[i].z;
+            // field decreases outwards, so normal is opposite to gradient
+            netVertex.n.x -= normalList[i].x;
+            netVertex.n.y -= normalList[i].y;
+            netVertex.n.z -= normalList[i].z;
+            crossPointCount++;
+        }
+    }
+
+    netVertex.p.x /= crossPointCount;
+    netVertex.p.y /= crossPointCount;
+    netVertex.p.z /= crossPointCount;
+
+    fNetVertex = netVertex;
+}
+
 /*
     Given a grid cell and an isoLevel, calculate the triangular facets
     required to represent the isosurface through the cell. Return the
@@ -144,19 +337,111 @@ void GridCell::recalculateTriangles(bool performPointValuesRecalculation)
     with the vertices at most 5 triangular facets. 0 will be returned if the
     grid cell is either totally above of totally below the isoLevel.
 */
-QVector<Triangle> GridCell::trianglesMarchingCubes(float isoLevel)
+QVector<Triangle> GridCell::trianglesMarchingCubes(float isoLevel,
+            int cubeIndex)
 {
     QVector<Triangle> resTriangles(6);
 
     int i = 0;
     int resTrianglesCount = 0;
-    int cubeIndex = 0;
     Point vertexList[12];
 
+    if (cubeIndex < 0)
+    {
+        cubeIndex = calculateCubeIndex(isoLevel);
+    }
+
+    fCubeIndex = cubeIndex;
+
+    /* Cube is entirely in/out of the surface */
+    if (kEdgeTable[cubeIndex] == 0)
+    {
+        return QVector<Triangle>();
+    }
+
+    crossPoints(isoLevel, cubeIndex, fPoints, vertexList);
+
+    /* Create the triangle */
+    resTrianglesCount = 0;
+    for (i = 0; kTriTable[cubeIndex][i] != -1; i += 3)
+    {
+        resTriangles[resTrianglesCount].p[0] =
+                    vertexList[kTriTable[cubeIndex][i]];
+        resTriangles[resTrianglesCount].p[1] =
+                    vertexList[kTriTable[cubeIndex][i + 1]];
+        resTriangles[resTrianglesCount].p[2] =
+                    vertexList[kTriTable[cubeIndex][i + 2]];
+        resTrianglesCount++;
+    }
+
+    resTriangles.resize(resTrianglesCount);
+
+    return(resTriangles);
+}
+
+/*
+    Polygonise the cube as 6 tetrahedrons. It results in a smoother surface
+    with no ambiguous cases but more triangular facets. Cube edge cross points
+    are the same as marching cubes ones, face and main diagonal cross points
+    are interpolated once per cell when first tetrahedron needs them.
+*/
+int GridCell::trianglesMarchingTetrahedrons(float isoLevel, int cubeIndex,
+            Triangle *resTriangles) const
+{
+    /* Cube is entirely in/out of the surface, so are tetrahedrons */
+    if (kEdgeTable[cubeIndex] == 0)
+    {
+        return 0;
+    }
+
+    Point vertexList[kTetrahedronEdgeCount];
+    crossPoints(isoLevel, cubeIndex, fPoints, vertexList);
+    unsigned int knownVertexes = kEdgeTable[cubeIndex];
+
+    int resTrianglesCount = 0;
+    int tetrahedron, tetrahedronIndex, i, j, edge, v1, v2;
+    for (tetrahedron = 0; tetrahedron < 6; tetrahedron++)
+    {
+        tetrahedronIndex = 0;
+        for (i = 0; i < 4; i++)
+        {
+            if (cubeIndex & (1 << kTetrahedrons[tetrahedron][i]))
+            {
+                tetrahedronIndex |= 1 << i;
+            }
+        }
+
+        const int *triangleEdges = kTetrahedronTriTable[tetrahedronIndex];
+        for (i = 0; triangleEdges[i] != -1; i += 3)
+        {
+            for (j = 0; j < 3; j++)
+            {
+                edge = kTetrahedronEdges[tetrahedron][triangleEdges[i + j]];
+                if (!(knownVertexes & (1 << edge)))
+                {
+                    v1 = kTetrahedronEdgeVertexes[edge][0];
+                    v2 = kTetrahedronEdgeVertexes[edge][1];
+                    vertexList[edge] = interpolateCrossPoint(isoLevel,
+                                fPoints[v1], fPoints[v2], fPointValues[v1],
+                                fPointValues[v2]);
+                    knownVertexes |= 1 << edge;
+                }
+                resTriangles[resTrianglesCount].p[j] = vertexList[edge];
+            }
+            resTrianglesCount++;
+        }
+    }
+
+    return resTrianglesCount;
+}
+
+int GridCell::calculateCubeIndex(float isoLevel) const
+{
     /*
         Determine the index into the edge table which
         tells us which vertices are inside of the surface
     */
+    int cubeIndex = 0;
     if (fPointValues[0] < isoLevel) cubeIndex |= 1;
     if (fPointValues[1] < isoLevel) cubeIndex |= 2;
     if (fPointValues[2] < isoLevel) cubeIndex |= 4;
@@ -166,110 +451,82 @@ QVector<Triangle> GridCell::trianglesMarchingCubes(float isoLevel)
     if (fPointValues[6] < isoLevel) cubeIndex |= 64;
     if (fPointValues[7] < isoLevel) cubeIndex |= 128;
 
-    /* Cube is entirely in/out of the surface */
-    if (kEdgeTable[cubeIndex] == 0)
-    {
-        return QVector<Triangle>();
-    }
+    return cubeIndex;
+}
 
-    /* Find the vertices where the surface intersects the cube */
+/*
+    Find the vertices where the surface intersects the cube, given points are
+    interpolated along crossed edges (they could be cube vertexes as well as
+    any other per-vertex vectors, f.e. field gradients)
+*/
+void GridCell::crossPoints(float isoLevel, int cubeIndex,
+            const Point *points, Point *vertexList) const
+{
     if (kEdgeTable[cubeIndex] & 1)
     {
-        vertexList[0] = interpolateCrossPoint(isoLevel, fPoints[0],
-                    fPoints[1], fPointValues[0], fPointValues[1]);
+        vertexList[0] = interpolateCrossPoint(isoLevel, points[0],
+                    points[1], fPointValues[0], fPointValues[1]);
     }
     if (kEdgeTable[cubeIndex] & 2)
     {
-        vertexList[1] = interpolateCrossPoint(isoLevel, fPoints[1],
-                    fPoints[2], fPointValues[1], fPointValues[2]);
+        vertexList[1] = interpolateCrossPoint(isoLevel, points[1],
+                    points[2], fPointValues[1], fPointValues[2]);
     }
     if (kEdgeTable[cubeIndex] & 4)
     {
-        vertexList[2] = interpolateCrossPoint(isoLevel, fPoints[2],
-                    fPoints[3], fPointValues[2], fPointValues[3]);
+        vertexList[2] = interpolateCrossPoint(isoLevel, points[2],
+                    points[3], fPointValues[2], fPointValues[3]);
     }
     if (kEdgeTable[cubeIndex] & 8)
     {
-        vertexList[3] = interpolateCrossPoint(isoLevel, fPoints[3],
-                    fPoints[0], fPointValues[3], fPointValues[0]);
+        vertexList[3] = interpolateCrossPoint(isoLevel, points[3],
+                    points[0], fPointValues[3], fPointValues[0]);
     }
     if (kEdgeTable[cubeIndex] & 16)
     {
-        vertexList[4] = interpolateCrossPoint(isoLevel, fPoints[4],
-                    fPoints[5], fPointValues[4], fPointValues[5]);
+        vertexList[4] = interpolateCrossPoint(isoLevel, points[4],
+                    points[5], fPointValues[4], fPointValues[5]);
     }
     if (kEdgeTable[cubeIndex] & 32)
     {
-        vertexList[5] = interpolateCrossPoint(isoLevel, fPoints[5],
-                    fPoints[6], fPointValues[5], fPointValues[6]);
+        vertexList[5] = interpolateCrossPoint(isoLevel, points[5],
+                    points[6], fPointValues[5], fPointValues[6]);
     }
     if (kEdgeTable[cubeIndex] & 64)
     {
-        vertexList[6] = interpolateCrossPoint(isoLevel, fPoints[6],
-                    fPoints[7], fPointValues[6], fPointValues[7]);
+        vertexList[6] = interpolateCrossPoint(isoLevel, points[6],
+                    points[7], fPointValues[6], fPointValues[7]);
     }
     if (kEdgeTable[cubeIndex] & 128)
     {
-        vertexList[7] = interpolateCrossPoint(isoLevel, fPoints[7],
-                    fPoints[4], fPointValues[7], fPointValues[4]);
+        vertexList[7] = interpolateCrossPoint(isoLevel, points[7],
+                    points[4], fPointValues[7], fPointValues[4]);
     }
     if (kEdgeTable[cubeIndex] & 256)
     {
-        vertexList[8] = interpolateCrossPoint(isoLevel, fPoints[0],
-                    fPoints[4], fPointValues[0], fPointValues[4]);
+        vertexList[8] = interpolateCrossPoint(isoLevel, points[0],
+                    points[4], fPointValues[0], fPointValues[4]);
     }
     if (kEdgeTable[cubeIndex] & 512)
     {
-        vertexList[9] = interpolateCrossPoint(isoLevel, fPoints[1],
-                    fPoints[5], fPointValues[1], fPointValues[5]);
+        vertexList[9] = interpolateCrossPoint(isoLevel, points[1],
+                    points[5], fPointValues[1], fPointValues[5]);
     }
     if (kEdgeTable[cubeIndex] & 1024)
     {
-        vertexList[10] = interpolateCrossPoint(isoLevel, fPoints[2],
-                    fPoints[6], fPointValues[2], fPointValues[6]);
+        vertexList[10] = interpolateCrossPoint(isoLevel, points[2],
+                    points[6], fPointValues[2], fPointValues[6]);
     }
     if (kEdgeTable[cubeIndex] & 2048)
     {
-        vertexList[11] = interpolateCrossPoint(isoLevel, fPoints[3],
-                    fPoints[7], fPointValues[3], fPointValues[7]);
-    }
-
-    /* Create the triangle */
-    resTrianglesCount = 0;
-    for (i = 0; kTriTable[cubeIndex][i] != -1; i += 3)
-    {
-        resTriangles[resTrianglesCount].p[0] =
-                    vertexList[kTriTable[cubeIndex][i]];
-        resTriangles[resTrianglesCount].p[1] =
-                    vertexList[kTriTable[cubeIndex][i + 1]];
-        resTriangles[resTrianglesCount].p[2] =
-                    vertexList[kTriTable[cubeIndex][i + 2]];
-        resTrianglesCount++;
+        vertexList[11] = interpolateCrossPoint(isoLevel, points[3],
+                    points[7], fPointValues[3], fPointValues[7]);
     }
-
-    resTriangles.resize(resTrianglesCount);
-
-    return(resTriangles);
-}
-
-QVector<Triangle> GridCell::trianglesMarchingTetrahedrons(float isoLevel)
-{
-    QVector<Triangle> resTriangles;
-    resTriangles.reserve(20);
-
-    resTriangles += tetrahedronTriangles(isoLevel, 0,2,3,7);
-    resTriangles += tetrahedronTriangles(isoLevel, 0,2,6,7);
-    resTriangles += tetrahedronTriangles(isoLevel, 0,4,6,7);
-    resTriangles += tetrahedronTriangles(isoLevel, 0,6,1,2);
-    resTriangles += tetrahedronTriangles(isoLevel, 0,6,1,4);
-    resTriangles += tetrahedronTriangles(isoLevel, 5,6,1,4);
-
-    return resTriangles;
 }
 
 void GridCell::recalculatePointValues()
 {
-    unsigned int pIndex[8];
+    GridIndex pIndex[8];
     pIndex[0] = fGridPtr->pointIndex(fXPos, fYPos, fZPos);
     pIndex[1] = fGridPtr->pointIndex(fXPos + 1, fYPos, fZPos);
     pIndex[2] = fGridPtr->pointIndex(fXPos + 1, fYPos + 1, fZPos);
@@ -290,6 +547,33 @@ void GridCell::recalculatePointValues()
     fHasTriangles = true;
 }
 
+Point GridCell::pointGradient(unsigned int xPos, unsigned int yPos,
+            unsigned int zPos) const
+{
+    const float *values = fGridPtr->pointValues();
+
+    // central differences inside of the grid, one-sided on its borders
+    unsigned int xPrev = (xPos > 0) ? xPos - 1 : xPos;
+    unsigned int xNext = (xPos + 1 < fGridPtr->xDimention()) ? xPos + 1 : xPos;
+    unsigned int yPrev = (yPos > 0) ? yPos - 1 : yPos;
+    unsigned int yNext = (yPos + 1 < fGridPtr->yDimention()) ? yPos + 1 : yPos;
+    unsigned int zPrev = (zPos > 0) ? zPos - 1 : zPos;
+    unsigned int zNext = (zPos + 1 < fGridPtr->zDimention()) ? zPos + 1 : zPos;
+
+    Point gradient;
+    gradient.x = (values[fGridPtr->pointIndex(xNext, yPos, zPos)] -
+                values[fGridPtr->pointIndex(xPrev, yPos, zPos)]) /
+                ((xNext - xPrev) * fGridPtr->xStep());
+    gradient.y = (values[fGridPtr->pointIndex(xPos, yNext, zPos)] -
+                values[fGridPtr->pointIndex(xPos, yPrev, zPos)]) /
+                ((yNext - yPrev) * fGridPtr->yStep());
+    gradient.z = (values[fGridPtr->pointIndex(xPos, yPos, zNext)] -
+                values[fGridPtr->pointIndex(xPos, yPos, zPrev)]) /
+                ((zNext - zPrev) * fGridPtr->zStep());
+
+    return gradient;
+}
+
 void GridCell::recalculatePoints()
 {
     fPoints[0].x = fGridPtr->xCoord(fXPos);
@@ -324,169 +608,3 @@ void GridCell::recalculatePoints()
     fPoints[7].y = fGridPtr->yCoord(fYPos + 1);
     fPoints[7].z = fGridPtr->zCoord(fZPos + 1);
 }
-
-/*
-    Polygonise a tetrahedron given its vertices within a cube. This is an
-    alternative algorithm to polygonisegrid. It results in a smoother surface
-    but more triangular facets. It's main purpose is still to polygonise
-    a gridded dataset and would normally be called 6 times, one for each
-    tetrahedron making up the grid cell.
-*/
-QVector<Triangle> GridCell::tetrahedronTriangles(float isoLevel,
-            int v0, int v1, int v2, int v3)
-{
-    QVector<Triangle> resTriangles(5);
-
-    int resTrianglesCount = 0;
-    int triangleIndex = 0;
-
-    /*
-        Determine which of the 16 cases we have given which vertices
-        are above or below the isosurface
-    */
-    triangleIndex = 0;
-    if (fPointValues[v0] < isoLevel) triangleIndex |= 1;
-    if (fPointValues[v1] < isoLevel) triangleIndex |= 2;
-    if (fPointValues[v2] < isoLevel) triangleIndex |= 4;
-    if (fPointValues[v3] < isoLevel) triangleIndex |= 8;
-
-    /* Form the vertices of the triangles for each case */
-    switch (triangleIndex)
-    {
-        case 0x00:
-        case 0x0F:
-        {
-            break;
-        }
-        case 0x0E: ///
-        case 0x01:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v1],
-                        fPointValues[v0], fPointValues[v1]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v2],
-                        fPointValues[v0], fPointValues[v2]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v3],
-                        fPointValues[v0], fPointValues[v3]);
-            resTrianglesCount++;
-            break;
-        }
-        case 0x0D: ///
-        case 0x02:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v0],
-                        fPointValues[v1], fPointValues[v0]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v3],
-                        fPointValues[v1], fPointValues[v3]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v2],
-                        fPointValues[v1], fPointValues[v2]);
-            resTrianglesCount++;
-            break;
-        }
-        case 0x0C: ///
-        case 0x03:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v3],
-                        fPointValues[v0], fPointValues[v3]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v2],
-                        fPointValues[v0], fPointValues[v2]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v3],
-                        fPointValues[v1], fPointValues[v3]);
-            resTrianglesCount++;
-
-            resTriangles[1].p[0] = resTriangles[0].p[2];
-            resTriangles[1].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v2],
-                        fPointValues[v1], fPointValues[v2]);
-            resTriangles[1].p[2] = resTriangles[0].p[1];
-            resTrianglesCount++;
-            break;
-        }
-        case 0x0B: ///
-        case 0x04:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v2], fPoints[v0],
-                        fPointValues[v2], fPointValues[v0]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v2], fPoints[v1],
-                        fPointValues[v2], fPointValues[v1]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v2], fPoints[v3],
-                        fPointValues[v2], fPointValues[v3]);
-            resTrianglesCount++;
-            break;
-        }
-        case 0x0A: ///
-        case 0x05:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v1],
-                        fPointValues[v0], fPointValues[v1]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v2], fPoints[v3],
-                        fPointValues[v2], fPointValues[v3]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v3],
-                        fPointValues[v0], fPointValues[v3]);
-            resTrianglesCount++;
-
-            resTriangles[1].p[0] = resTriangles[0].p[0];
-            resTriangles[1].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v2],
-                        fPointValues[v1], fPointValues[v2]);
-            resTriangles[1].p[2] = resTriangles[0].p[1];
-            resTrianglesCount++;
-            break;
-        }
-        case 0x09: ///
-        case 0x06:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v1],
-                        fPointValues[v0], fPointValues[v1]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v1], fPoints[v3],
-                        fPointValues[v1], fPointValues[v3]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v2], fPoints[v3],
-                        fPointValues[v2], fPointValues[v3]);
-            resTrianglesCount++;
-
-            resTriangles[1].p[0] = resTriangles[0].p[0];
-            resTriangles[1].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v0], fPoints[v2],
-                        fPointValues[v0], fPointValues[v2]);
-            resTriangles[1].p[2] = resTriangles[0].p[2];
-            resTrianglesCount++;
-            break;
-        }
-        case 0x07: ///
-        case 0x08:
-        {
-            resTriangles[0].p[0] = interpolateCrossPoint(isoLevel,
-                        fPoints[v3], fPoints[v0],
-                        fPointValues[v3], fPointValues[v0]);
-            resTriangles[0].p[1] = interpolateCrossPoint(isoLevel,
-                        fPoints[v3], fPoints[v2],
-                        fPointValues[v3], fPointValues[v2]);
-            resTriangles[0].p[2] = interpolateCrossPoint(isoLevel,
-                        fPoints[v3], fPoints[v1],
-                        fPointValues[v3], fPointValues[v1]);
-            resTrianglesCount++;
-            break;
-        }
-    }
-
-    resTriangles.resize(resTrianglesCount);
-
-    return(resTriangles);
-}
@@ -36,6 +36,9 @@ public:
     GridCell();
     GridCell(const Grid *gridPtr, unsigned int xPos, unsigned int yPos,
                 unsigned int zPos);
+    // Cell which is not bound to any grid, so point values can't be
+    // recalculated and there are no field gradients.
+    GridCell(const Point *points, const float *pointValues);
     GridCell(const GridCell &copyee);
 
     inline unsigned int xPos() const { return fXPos; }
@@ -45,17 +48,52 @@ public:
     QVector<TriangleN> triangles() const { return fTriangles; }
 
     void setIsoLevel(float isoLevel) { fIsoLevel = isoLevel; }
-    void recalculateTriangles(bool performPointValuesRecalculation = true);
+    // Cube index could be given if it is already known (f.e. from
+    // Classification pre-pass), -1 means it has to be calculated.
+    void recalculateTriangles(bool performPointValuesRecalculation = true,
+                int cubeIndex = -1);
+    void clearTriangles();
+    // Moves triangle vertexes along the same cube edges for new isosurface
+    // level, so cube index must not change with the level.
+    void relerpTriangles(float isoLevel);
+    inline int cubeIndex() const { return fCubeIndex; }
+    // Same triangles as triangles() returns, but each vertex normal is
+    // trilinearly interpolated from central difference field gradients in
+    // cell vertexes (which is linear interpolation along crossed cube edge).
+    QVector<TriangleN> gradientNormalizedTriangles() const;
+    // Same as gradientNormalizedTriangles(), but field gradients in cell
+    // vertexes (in kVertexOffsets order) are given, so cells which are not
+    // bound to any grid and are not cubic (f.e. octree dual cells) have
+    // them too.
+    QVector<TriangleN> gradientNormalizedTriangles(
+                const Point *gradients) const;
+
+    // Same as recalculateTriangles(), but marching tetrahedrons are used.
+    void recalculateTetrahedronTriangles(
+                bool performPointValuesRecalculation = true,
+                int cubeIndex = -1);
+
+    // Surface nets: cell holds single vertex placed in the mass center of
+    // its edge cross points, normal is taken from field gradient there.
+    void recalculateNetVertex(bool performPointValuesRecalculation = true,
+                int cubeIndex = -1);
+    inline const PointN &netVertex() const { return fNetVertex; }
 
 protected:
     void recalculatePointValues();
     void recalculatePoints();
 
-    QVector<Triangle> trianglesMarchingCubes(float isoLevel);
-    QVector<Triangle> trianglesMarchingTetrahedrons(float isoLevel);
-
-    QVector<Triangle> tetrahedronTriangles(float isoLevel, int v0, int v1,
-                int v2, int v3);
+    QVector<Triangle> trianglesMarchingCubes(float isoLevel,
+                int cubeIndex = -1);
+    int calculateCubeIndex(float isoLevel) const;
+    void crossPoints(float isoLevel, int cubeIndex, const Point *points,
+                Point *vertexList) const;
+    Point pointGradient(unsigned int xPos, unsigned int yPos,
+                unsigned int zPos) const;
+    // Fills resTriangles (which has to hold 12 items) and returns number of
+    // triangles.
+    int trianglesMarchingTetrahedrons(float isoLevel, int cubeIndex,
+                Triangle *resTriangles) const;
 
 private:
     const Grid *fGridPtr;
@@ -65,9 +103,11 @@ private:
     unsigned int fZPos;
 
     float fIsoLevel;
+    int fCubeIndex;
 
     bool fHasTriangles;
     QVector<TriangleN> fTriangles;
+    PointN fNetVertex;
 
     Point fPoints[8];
     float fPointValues[8]; // field strength in corresponding vertex.
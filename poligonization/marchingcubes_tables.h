@@ -21,6 +21,13 @@
 #ifndef MARCHINGCUBES_TABLES_H
 #define MARCHINGCUBES_TABLES_H
 
+// Grid position offsets of cube vertexes.
+const unsigned int kVertexOffsets[8][3] =
+{
+    {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+    {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+};
+
 const int kEdgeTable[256] =
 {
     0x0  , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
@@ -317,4 +324,54 @@ const int kTriTable[256][16] =
     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
 };
 
+// Marching tetrahedrons: cube is split into 6 tetrahedrons, listed by cube
+// vertexes (all of them have the same orientation). Face diagonals of the
+// split have the same direction in each cell, so neighbouring cells fit.
+const int kTetrahedrons[6][4] =
+{
+    {0, 2, 3, 7}, {0, 2, 7, 6}, {0, 4, 6, 7},
+    {0, 6, 1, 2}, {0, 6, 4, 1}, {5, 6, 1, 4}
+};
+
+// Cube vertexes of edges which are used by tetrahedrons, first 12 edges are
+// the same as in kEdgeTable, then 6 face diagonals and main diagonal follow.
+const int kTetrahedronEdgeCount = 19;
+const int kTetrahedronEdgeVertexes[kTetrahedronEdgeCount][2] =
+{
+    {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6}, {6, 7}, {7, 4},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    {0, 2}, {4, 6}, {0, 7}, {1, 6}, {1, 4}, {2, 7}, {0, 6}
+};
+
+// Cube edges of each tetrahedron, tetrahedron edge order is 0-1, 0-2, 0-3,
+// 1-2, 1-3, 2-3.
+const int kTetrahedronEdges[6][6] =
+{
+    {12, 3, 14, 2, 17, 11}, {12, 14, 18, 17, 10, 6},
+    {8, 18, 14, 13, 7, 6}, {18, 0, 12, 15, 10, 1},
+    {18, 8, 0, 13, 15, 16}, {5, 9, 4, 15, 13, 16}
+};
+
+// Triangles (as tetrahedron edges) for each of 16 tetrahedron indices,
+// index bits are set the same way as for cube index.
+const int kTetrahedronTriTable[16][7] =
+{
+    {-1, -1, -1, -1, -1, -1, -1},
+    {0, 2, 1, -1, -1, -1, -1},
+    {0, 3, 4, -1, -1, -1, -1},
+    {1, 4, 2, 1, 3, 4, -1},
+    {1, 5, 3, -1, -1, -1, -1},
+    {0, 2, 5, 0, 5, 3, -1},
+    {0, 5, 4, 0, 1, 5, -1},
+    {2, 5, 4, -1, -1, -1, -1},
+    {2, 4, 5, -1, -1, -1, -1},
+    {0, 5, 1, 0, 4, 5, -1},
+    {0, 3, 5, 0, 5, 2, -1},
+    {1, 3, 5, -1, -1, -1, -1},
+    {1, 4, 3, 1, 2, 4, -1},
+    {0, 4, 3, -1, -1, -1, -1},
+    {0, 1, 2, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1, -1}
+};
+
 #endif // MARCHINGCUBES_TABLES_H
@@ -0,0 +1,390 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * meshexport.cpp is part of 3D Meta-Object-based Modelling System           *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QtEndian>
+
+#include "meshexport.h"
+#include "normalization.h"
+
+namespace Output
+{
+    const int kBufferSize = 1 << 16; // in bytes.
+    const int kMaxLineSize = 128; // in bytes, of a vertex or face line.
+
+    // Represents output buffer which is written to device when it is full.
+    // Numbers are formatted by hand, as sprintf() per number takes most of
+    // the export time.
+    class Buffer
+    {
+    public:
+        Buffer(QIODevice *device) : fDevice(device), fSize(0), fOk(true) {}
+
+        // Makes room for size bytes (a line by default).
+        inline void reserve(int size = kMaxLineSize)
+        {
+            if (fSize + size > kBufferSize)
+            {
+                flush();
+            }
+        }
+        inline void append(char c) { fData[fSize++] = c; }
+        inline void append(const char *string)
+        {
+            while (*string)
+            {
+                fData[fSize++] = *string++;
+            }
+        }
+        inline void append(const void *data, int size)
+        {
+            memcpy(fData + fSize, data, size);
+            fSize += size;
+        }
+        // Appends 32-bit value (float or integer) in little endian order.
+        inline void appendWord(const void *value)
+        {
+            quint32 word;
+            memcpy(&word, value, sizeof(word));
+            word = qToLittleEndian(word);
+            append(&word, sizeof(word));
+        }
+        void appendInteger(unsigned long long value);
+        // Fixed notation with at most 6 fraction digits (as "%.6f" without
+        // trailing zeros).
+        void appendFloat(float value);
+
+        // Returns false if any write has failed.
+        bool flush();
+
+    private:
+        QIODevice *fDevice;
+        char fData[kBufferSize];
+        int fSize;
+        bool fOk;
+    };
+
+    void Buffer::appendInteger(unsigned long long value)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = '0' + (value % 10);
+            value /= 10;
+        } while (value);
+
+        while (count)
+        {
+            fData[fSize++] = digits[--count];
+        }
+    }
+
+    void Buffer::appendFloat(float value)
+    {
+        double v = value;
+        // values which do not fit the fast path (and not finite ones)
+        if (!(fabs(v) < 1e12))
+        {
+            fSize += snprintf(fData + fSize, kMaxLineSize / 4, "%g", v);
+            return;
+        }
+
+        if (v < 0)
+        {
+            fData[fSize++] = '-';
+            v = -v;
+        }
+        unsigned long long scaled =
+                    static_cast<unsigned long long>(v * 1e6 + 0.5);
+        appendInteger(scaled / 1000000);
+
+        unsigned int fraction = scaled % 1000000;
+        if (fraction == 0)
+        {
+            return;
+        }
+        fData[fSize++] = '.';
+        unsigned int divisor = 100000;
+        while (fraction)
+        {
+            fData[fSize++] = '0' + fraction / divisor;
+            fraction %= divisor;
+            divisor /= 10;
+        }
+    }
+
+    bool Buffer::flush()
+    {
+        if (fSize > 0 && fOk)
+        {
+            fOk = fDevice->write(fData, fSize) == fSize;
+        }
+        fSize = 0;
+        return fOk;
+    }
+
+    // Represents exact (bitwise) position or normal as hash key.
+    typedef struct
+    {
+        Point p;
+    } PointKey;
+
+    inline bool operator==(const PointKey &a, const PointKey &b)
+    {
+        return memcmp(&a.p, &b.p, sizeof(Point)) == 0;
+    }
+
+    inline uint qHash(const PointKey &key)
+    {
+        unsigned int bits[3];
+        memcpy(bits, &key.p, sizeof(bits));
+        return bits[0] ^ (bits[1] * 0x9e3779b1u) ^ (bits[2] * 0x85ebca6bu);
+    }
+
+    // Same for position together with normal.
+    typedef struct
+    {
+        PointN p;
+    } PointNKey;
+
+    inline bool operator==(const PointNKey &a, const PointNKey &b)
+    {
+        return memcmp(&a.p, &b.p, sizeof(PointN)) == 0;
+    }
+
+    inline uint qHash(const PointNKey &key)
+    {
+        PointKey position = { key.p.p };
+        PointKey normal = { key.p.n };
+        return qHash(position) ^ (qHash(normal) * 0xc2b2ae35u);
+    }
+
+    // Returns 1-based index of point, writes point line (with given
+    // prefix) if point is a new one.
+    unsigned int pointIndex(const Point &p, const char *prefix,
+                QHash<PointKey, unsigned int> *indices, Buffer *buffer)
+    {
+        PointKey key = { p };
+        QHash<PointKey, unsigned int>::const_iterator index =
+                    indices->constFind(key);
+        if (index != indices->constEnd())
+        {
+            return index.value();
+        }
+
+        unsigned int result = indices->count() + 1;
+        indices->insert(key, result);
+
+        buffer->reserve();
+        buffer->append(prefix);
+        buffer->appendFloat(p.x);
+        buffer->append(' ');
+        buffer->appendFloat(p.y);
+        buffer->append(' ');
+        buffer->appendFloat(p.z);
+        buffer->append('\n');
+        return result;
+    }
+}
+
+using namespace Output;
+
+const int kStlHeaderSize = 80;
+const int kStlTriangleSize = 50; // normal, 3 vertexes and attribute.
+
+bool MeshExport::writeWavefront(const QVector<TriangleN> &triangles,
+            QIODevice *device)
+{
+    // f.e.:
+    //
+    // v 0 0 0
+    // vn 0 0 1
+    // v 1 2 3
+    // v -1 -2 -3
+    // f 1//1 2//1 3//1
+    //
+    // describes one face defined by three vertexes with the same normal.
+    // Vertexes are written right before the first face which uses them.
+
+    Buffer *buffer = new Buffer(device); // too big for stack.
+    QHash<PointKey, unsigned int> positionIndices;
+    QHash<PointKey, unsigned int> normalIndices;
+
+    unsigned int positions[3];
+    unsigned int normals[3];
+
+    int triangleCount = triangles.count();
+    for (int i = 0; i < triangleCount; i++)
+    {
+        const TriangleN &triangle = triangles.at(i);
+        for (int j = 0; j < 3; j++)
+        {
+            positions[j] = pointIndex(triangle.p[j].p, "v ",
+                        &positionIndices, buffer);
+            normals[j] = pointIndex(triangle.p[j].n, "vn ", &normalIndices,
+                        buffer);
+        }
+
+        buffer->reserve();
+        buffer->append('f');
+        for (int j = 0; j < 3; j++)
+        {
+            buffer->append(' ');
+            buffer->appendInteger(positions[j]);
+            buffer->append("//");
+            buffer->appendInteger(normals[j]);
+        }
+        buffer->append('\n');
+    }
+
+    bool result = buffer->flush();
+    delete buffer;
+    return result;
+}
+
+bool MeshExport::writePly(const QVector<TriangleN> &triangles,
+            QIODevice *device)
+{
+    // vertexes are counted before header, so they are shared first
+    QHash<PointNKey, unsigned int> vertexIndices;
+    QVector<PointN> vertexes;
+    int triangleCount = triangles.count();
+    QVector<quint32> faces(3 * triangleCount);
+    for (int i = 0; i < triangleCount; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            PointNKey key = { triangles.at(i).p[j] };
+            QHash<PointNKey, unsigned int>::const_iterator index =
+                        vertexIndices.constFind(key);
+            if (index != vertexIndices.constEnd())
+            {
+                faces[3 * i + j] = index.value();
+            }
+            else
+            {
+                faces[3 * i + j] = vertexes.count();
+                vertexIndices.insert(key, vertexes.count());
+                vertexes.append(key.p);
+            }
+        }
+    }
+    vertexIndices.clear();
+
+    QByteArray header;
+    header += "ply\n"
+                "format binary_little_endian 1.0\n"
+                "element vertex ";
+    header += QByteArray::number(vertexes.count());
+    header += "\n"
+                "property float x\n"
+                "property float y\n"
+                "property float z\n"
+                "property float nx\n"
+                "property float ny\n"
+                "property float nz\n"
+                "element face ";
+    header += QByteArray::number(triangleCount);
+    header += "\n"
+                "property list uchar int vertex_indices\n"
+                "end_header\n";
+    if (device->write(header) != header.size())
+    {
+        return false;
+    }
+
+    Buffer *buffer = new Buffer(device); // too big for stack.
+
+    // PointN is x, y, z, nx, ny, nz already
+    const float *values = reinterpret_cast<const float *>(
+                vertexes.constData());
+    int valueCount = vertexes.count() * sizeof(PointN) / sizeof(float);
+    for (int i = 0; i < valueCount; i++)
+    {
+        buffer->reserve(sizeof(float));
+        buffer->appendWord(values + i);
+    }
+
+    const unsigned char vertexCount = 3;
+    for (int i = 0; i < 3 * triangleCount; i += 3)
+    {
+        buffer->reserve(1 + 3 * sizeof(quint32));
+        buffer->append(&vertexCount, 1);
+        buffer->appendWord(&faces[i]);
+        buffer->appendWord(&faces[i + 1]);
+        buffer->appendWord(&faces[i + 2]);
+    }
+
+    bool result = buffer->flush();
+    delete buffer;
+    return result;
+}
+
+bool MeshExport::writeStl(const QVector<TriangleN> &triangles,
+            QIODevice *device)
+{
+    Buffer *buffer = new Buffer(device); // too big for stack.
+
+    // binary header must not start with "solid" (ASCII STL)
+    char header[kStlHeaderSize];
+    memset(header, 0, sizeof(header));
+    strcpy(header, "dip2 binary STL");
+    quint32 triangleCount = triangles.count();
+    buffer->reserve(kStlHeaderSize + sizeof(quint32));
+    buffer->append(header, kStlHeaderSize);
+    buffer->appendWord(&triangleCount);
+
+    const quint16 attribute = 0;
+    for (quint32 i = 0; i < triangleCount; i++)
+    {
+        const TriangleN &triangle = triangles.at(i);
+
+        Point normal = Normalization::normal(
+                    Normalization::vector(triangle.p[1].p, triangle.p[0].p),
+                    Normalization::vector(triangle.p[2].p, triangle.p[0].p));
+        if (normal.x != 0 || normal.y != 0 || normal.z != 0)
+        {
+            normal = Normalization::normalizeVector(normal);
+        }
+
+        buffer->reserve(kStlTriangleSize);
+        buffer->appendWord(&normal.x);
+        buffer->appendWord(&normal.y);
+        buffer->appendWord(&normal.z);
+        for (int j = 0; j < 3; j++)
+        {
+            buffer->appendWord(&triangle.p[j].p.x);
+            buffer->appendWord(&triangle.p[j].p.y);
+            buffer->appendWord(&triangle.p[j].p.z);
+        }
+        buffer->append(&attribute, sizeof(attribute));
+    }
+
+    bool result = buffer->flush();
+    delete buffer;
+    return result;
+}
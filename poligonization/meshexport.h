@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * meshexport.h is part of 3D Meta-Object-based Modelling System             *
+ *                                                                           *
+ * Copyright (c) 2010 Alexey Ivchenko aka fifajan <fifajan@ukr.net>          *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify it   *
+ * under the terms of the GNU General Public License as published by the     *
+ * Free Software Foundation; either version 2 of the License, or (at your    *
+ * option) any later version.                                                *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General  *
+ * Public License for more details.                                          *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License along   *
+ * with this program; if not, write to the Free Software Foundation, Inc.,   *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.              *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MESHEXPORT_H
+#define MESHEXPORT_H
+
+#include <QVector>
+
+#include "space_types.h"
+
+class QIODevice;
+
+// Represents set of functions which write poligonized surface to mesh files.
+// Output is written to device through a fixed size buffer, so memory needed
+// does not depend on file size.
+namespace MeshExport
+{
+    typedef bool (*Writer)(const QVector<TriangleN> &triangles,
+                QIODevice *device);
+
+    // Wavefront OBJ with shared vertexes and vertex normals: every distinct
+    // position (and normal) is written once, faces refer to them by index.
+    // Returns false if device can not be written.
+    bool writeWavefront(const QVector<TriangleN> &triangles,
+                QIODevice *device);
+    // Binary little endian PLY: shared vertexes with normals and faces as
+    // lists of vertex indexes.
+    bool writePly(const QVector<TriangleN> &triangles, QIODevice *device);
+    // Binary STL: triangles with facet normals, vertexes are not shared by
+    // this format.
+    bool writeStl(const QVector<TriangleN> &triangles, QIODevice *device);
+}
+
+#endif // MESHEXPORT_H
@@ -120,6 +120,50 @@ PointN Normalization::normalizeVertex(const Point &v,
     return resVertex;
 }
 
+Point Normalization::interpolateTrilinear(const Point *values, float u,
+            float v, float w)
+{
+    float weights[8] = {
+        (1 - u) * (1 - v) * (1 - w), u * (1 - v) * (1 - w),
+        u * v * (1 - w), (1 - u) * v * (1 - w),
+        (1 - u) * (1 - v) * w, u * (1 - v) * w,
+        u * v * w, (1 - u) * v * w };
+
+    Point p = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 8; i++)
+    {
+        p.x += weights[i] * values[i].x;
+        p.y += weights[i] * values[i].y;
+        p.z += weights[i] * values[i].z;
+    }
+
+    return p;
+}
+
+void Normalization::setGradientNormals(QVector<TriangleN> *triangles,
+            const Point *gradients, const Point &origin, const Point &size)
+{
+    int triangleCount = triangles->count();
+    Point p, gradient;
+    int i, j;
+    for (i = 0; i < triangleCount; i++)
+    {
+        TriangleN &triangle = (*triangles)[i];
+        for (j = 0; j < 3; j++)
+        {
+            p = triangle.p[j].p;
+            gradient = interpolateTrilinear(gradients,
+                        (p.x - origin.x) / size.x,
+                        (p.y - origin.y) / size.y,
+                        (p.z - origin.z) / size.z);
+            // field decreases outwards, so normal is opposite to gradient
+            triangle.p[j].n.x = -gradient.x;
+            triangle.p[j].n.y = -gradient.y;
+            triangle.p[j].n.z = -gradient.z;
+        }
+    }
+}
+
 bool Normalization::equalFloat(float a, float b)
 {
     return fabs(a - b) < kPrecision;
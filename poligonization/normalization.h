@@ -37,6 +37,16 @@ namespace Normalization
                 const QVector<Triangle> &adjacentTriangles);
     PointN normalizeVertex(const Point &v,
                 const QVector<TriangleN> &adjacentTriangles);
+    // Interpolates vectors given in cube vertexes (in GridCell vertex order)
+    // to a point with given relative cube coordinates.
+    Point interpolateTrilinear(const Point *values, float u, float v,
+                float w);
+    // Sets vertex normals of triangles extracted from a cube to field
+    // gradient interpolated from gradients in cube vertexes (in GridCell
+    // vertex order). Cube spans from origin by size.
+    void setGradientNormals(QVector<TriangleN> *triangles,
+                const Point *gradients, const Point &origin,
+                const Point &size);
     bool equalFloat(float a, float b);
     bool equalPoints(const Point &p1, const Point &p2);
     bool isVertex(const Point &p, const Triangle &triangle);
@@ -19,26 +19,42 @@
 \* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <math.h>
+#include <limits.h>
 
 #include <QDebug>
 
 #include "fieldobject.h"
 #include "grid.h"
+#include "sparsegrid.h"
+#include "octree.h"
 #include "poligonizator.h"
 #include "normalization.h"
+#include "classification.h"
+#include "marchingcubes_tables.h"
 
 using namespace Normalization;
+using namespace Classification;
 
-Poligonizator::Poligonizator(const FieldObject *fieldObject)
-            : fNormalMode(FLAT), fIsoLevel(2.0), fFieldObject(fieldObject),
-            fGridCells(fFieldObject->grid()->data()->cellCount())
+const int kBlockSize = 16; // in cells.
+// QVector of Qt4 allocates its items in a block of int size in bytes
+const GridIndex kMaxCellCount = INT_MAX / sizeof(GridCell);
+
+Poligonizator::Poligonizator(FieldObject *fieldObject, float isoLevel,
+            NormalMode normalMode, ExtractionMode extractionMode,
+            unsigned int octreeDepth)
+            : fNormalMode(normalMode), fExtractionMode(extractionMode),
+            fIsoLevel(isoLevel), fFieldObject(fieldObject),
+            fXBlockDim(0), fYBlockDim(0), fZBlockDim(0),
+            fOctreeDepth(octreeDepth)
 {
-    recalculateGridCells();
-    recalculateTriangles(true);
+    // output of other normal modes stays empty until the mode is set
     fFlatNormalizedTrianglesPtr = QSharedPointer<QVector<TriangleN> >(
                 new QVector<TriangleN>(0));
     fSmoothNormalizedTrianglesPtr = QSharedPointer<QVector<TriangleN> >(
                 new QVector<TriangleN>(0));
+    fGradientNormalizedTrianglesPtr = QSharedPointer<QVector<TriangleN> >(
+                new QVector<TriangleN>(0));
+    recalculateTriangles(true);
 }
 
 void Poligonizator::setNormalMode(NormalMode normalMode)
@@ -46,14 +62,77 @@ void Poligonizator::setNormalMode(NormalMode normalMode)
     if (fNormalMode != normalMode)
     {
         fNormalMode = normalMode;
-        recalculateNormalizedTriangles();
+        if (fExtractionMode == DUAL_MARCHING_CUBES)
+        {
+            recalculateOctreeNormalizedTriangles();
+            return;
+        }
+        if (fFieldObject->gridKind() == SPARSE_GRID)
+        {
+            recalculateSparseTriangles();
+            return;
+        }
+        recalculateNormalizedTriangles(allBlocksBox());
+        assembleTriangles();
+    }
+}
+
+void Poligonizator::setExtractionMode(ExtractionMode extractionMode)
+{
+    if (fExtractionMode != extractionMode)
+    {
+        bool isOctreeUsed = (fExtractionMode == DUAL_MARCHING_CUBES ||
+                    extractionMode == DUAL_MARCHING_CUBES);
+        fExtractionMode = extractionMode;
+        if (isOctreeUsed)
+        {
+            // octree evaluated for another field is not reused, grid cells
+            // are not held for dual marching cubes
+            fOctree.clear();
+            recalculateTriangles(true);
+            return;
+        }
+        if (fFieldObject->gridKind() == SPARSE_GRID)
+        {
+            qWarning() << "Poligonizator: sparse grid is extracted by"
+                        << "marching cubes or dual marching cubes only";
+            return;
+        }
+        recalculateTrianglesInBlocks(allBlocksBox());
+        recalculateNormalizedTriangles(allBlocksBox());
+        assembleTriangles();
+    }
+}
+
+void Poligonizator::setOctreeDepth(unsigned int depth)
+{
+    if (fOctreeDepth != depth)
+    {
+        fOctreeDepth = depth;
+        if (fExtractionMode == DUAL_MARCHING_CUBES)
+        {
+            recalculateOctreeTriangles(false);
+        }
     }
 }
 
 QSharedPointer<const QVector<TriangleN> > Poligonizator::trianglesPtr() const
 {
-    return fNormalMode == FLAT ? fFlatNormalizedTrianglesPtr
-                : fSmoothNormalizedTrianglesPtr;
+    switch (fNormalMode)
+    {
+        case SMOOTH:
+        {
+            return fSmoothNormalizedTrianglesPtr;
+        }
+        case GRADIENT:
+        {
+            return fGradientNormalizedTrianglesPtr;
+        }
+        default:
+        {
+            return fFlatNormalizedTrianglesPtr;
+        }
+    }
 }
 
 void Poligonizator::recalculateGridCells()
@@ -66,7 +145,33 @@ void Poligonizator::recalculateGridCells()
     unsigned int yCellDim = grid->yDimention() - 1;
     unsigned int zCellDim = grid->zDimention() - 1;
 
-    fGridCells.resize(grid->cellCount());
+    // cells are held in a QVector (see kMaxCellCount), bigger grids have to
+    // be of sparse grid kind
+    if (fFieldObject->gridKind() == SPARSE_GRID ||
+                fExtractionMode == DUAL_MARCHING_CUBES)
+    {
+        xCellDim = 0;
+        yCellDim = 0;
+        zCellDim = 0;
+    }
+    else if (grid->cellCount() > kMaxCellCount)
+    {
+        qWarning() << "Poligonizator: grid of" << grid->cellCount() <<
+                    "cells is too big, it is not poligonized";
+        xCellDim = 0;
+        yCellDim = 0;
+        zCellDim = 0;
+    }
+
+    fGridCells.resize(xCellDim * yCellDim * zCellDim);
+
+    // old blocks are gone together with old cells
+    fXBlockDim = (xCellDim + kBlockSize - 1) / kBlockSize;
+    fYBlockDim = (yCellDim + kBlockSize - 1) / kBlockSize;
+    fZBlockDim = (zCellDim + kBlockSize - 1) / kBlockSize;
+    fBlocks.clear();
+    fBlocks.resize(fXBlockDim * fYBlockDim * fZBlockDim);
+    fCubeIndices.resize(xCellDim * yCellDim * zCellDim);
 
     unsigned int i = 0;
     for (zPos = 0; zPos <  zCellDim; zPos++)
@@ -82,74 +187,476 @@ void Poligonizator::recalculateGridCells()
     }
 }
 
-void Poligonizator::recalculateTrianglesInGridCells(
-            bool performPointValuesRecalculation)
+GridBox Poligonizator::allBlocksBox() const
+{
+    GridBox box = { 0, fXBlockDim - 1, 0, fYBlockDim - 1, 0, fZBlockDim - 1 };
+    return box;
+}
+
+GridBox Poligonizator::blocksBox(const GridBox &cellsBox) const
+{
+    GridBox box = {
+        qMax(cellsBox.xMin, 0) / kBlockSize,
+        qMin(cellsBox.xMax / kBlockSize, fXBlockDim - 1),
+        qMax(cellsBox.yMin, 0) / kBlockSize,
+        qMin(cellsBox.yMax / kBlockSize, fYBlockDim - 1),
+        qMax(cellsBox.zMin, 0) / kBlockSize,
+        qMin(cellsBox.zMax / kBlockSize, fZBlockDim - 1) };
+
+    if (cellsBox.xMin > cellsBox.xMax || cellsBox.yMin > cellsBox.yMax ||
+                cellsBox.zMin > cellsBox.zMax || cellsBox.xMax < 0 ||
+                cellsBox.yMax < 0 || cellsBox.zMax < 0)
+    {
+        box.xMin = 0;
+        box.xMax = -1; // empty
+    }
+
+    return box;
+}
+
+GridBox Poligonizator::blockCellsBox(int xBlock, int yBlock, int zBlock) const
+{
+    const Grid *grid = fFieldObject->grid()->data();
+    GridBox cellsBox = grid->cellsBox();
+
+    GridBox box = {
+        xBlock * kBlockSize,
+        qMin((xBlock + 1) * kBlockSize - 1, cellsBox.xMax),
+        yBlock * kBlockSize,
+        qMin((yBlock + 1) * kBlockSize - 1, cellsBox.yMax),
+        zBlock * kBlockSize,
+        qMin((zBlock + 1) * kBlockSize - 1, cellsBox.zMax) };
+    return box;
+}
+
+CellBlock *Poligonizator::block(int xBlock, int yBlock, int zBlock)
+{
+    return &(fBlocks[(fXBlockDim * fYBlockDim * zBlock) +
+                (fXBlockDim * yBlock) + xBlock]);
+}
+
+void Poligonizator::recalculateTrianglesInBlocks(const GridBox &blocksBox)
 {
-    int cellCount = fGridCells.count();
-    for (int i = 0; i <  cellCount; i++)
+    int xBlock, yBlock, zBlock;
+    for (zBlock = blocksBox.zMin; zBlock <= blocksBox.zMax; zBlock++)
+    {
+        for (yBlock = blocksBox.yMin; yBlock <= blocksBox.yMax; yBlock++)
+        {
+            for (xBlock = blocksBox.xMin; xBlock <= blocksBox.xMax; xBlock++)
+            {
+                recalculateTrianglesInBlock(xBlock, yBlock, zBlock);
+            }
+        }
+    }
+}
+
+void Poligonizator::recalculateTrianglesInBlock(int xBlock, int yBlock,
+            int zBlock)
+{
+    const Grid *grid = fFieldObject->grid()->data();
+
+    CellBlock *cellBlock = block(xBlock, yBlock, zBlock);
+    QVector<GridIndex> &activeCellIndices = cellBlock->activeCellIndices;
+    GridBox cellsBox = blockCellsBox(xBlock, yBlock, zBlock);
+
+    int i;
+    int activeCellCount = activeCellIndices.count();
+    for (i = 0; i < activeCellCount; i++)
     {
-        fGridCells[i].setIsoLevel(fIsoLevel);
-        fGridCells[i].recalculateTriangles(performPointValuesRecalculation);
+        fGridCells[activeCellIndices[i]].clearTriangles();
+    }
+
+    recalculateBlockValueRange(cellBlock, cellsBox);
+    classifyCells(grid, fIsoLevel, cellsBox, &fCubeIndices,
+                &activeCellIndices);
+
+    // Inactive cells are never touched, so their point values could be
+    // outdated, that's why point values are always reloaded here.
+    activeCellCount = activeCellIndices.count();
+    for (i = 0; i < activeCellCount; i++)
+    {
+        recalculateCell(activeCellIndices[i], true);
     }
 }
 
-void Poligonizator::recalculateTriangles(bool gridDimentionsChanged,
+void Poligonizator::recalculateCell(GridIndex cellIndex,
             bool performPointValuesRecalculation)
+{
+    GridCell &cell = fGridCells[cellIndex];
+    cell.setIsoLevel(fIsoLevel);
+
+    switch (fExtractionMode)
+    {
+        case SURFACE_NETS:
+        {
+            cell.recalculateNetVertex(performPointValuesRecalculation,
+                        fCubeIndices[cellIndex]);
+            break;
+        }
+        case MARCHING_TETRAHEDRONS:
+        {
+            cell.recalculateTetrahedronTriangles(
+                        performPointValuesRecalculation,
+                        fCubeIndices[cellIndex]);
+            break;
+        }
+        default:
+        {
+            cell.recalculateTriangles(performPointValuesRecalculation,
+                        fCubeIndices[cellIndex]);
+        }
+    }
+}
+
+void Poligonizator::recalculateBlockValueRange(CellBlock *cellBlock,
+            const GridBox &cellsBox)
+{
+    const Grid *grid = fFieldObject->grid()->data();
+
+    // block's points box is one point wider than its cells box
+    unsigned int rowCount = cellsBox.xMax - cellsBox.xMin + 2;
+    float rowBuffer[kBlockSize + 1];
+    const float *rowValues = grid->rowValues(cellsBox.xMin, cellsBox.yMin,
+                cellsBox.zMin, rowCount, rowBuffer);
+    float minValue = rowValues[0];
+    float maxValue = minValue;
+
+    unsigned int i;
+    int yPos, zPos;
+    for (zPos = cellsBox.zMin; zPos <= cellsBox.zMax + 1; zPos++)
+    {
+        for (yPos = cellsBox.yMin; yPos <= cellsBox.yMax + 1; yPos++)
+        {
+            rowValues = grid->rowValues(cellsBox.xMin, yPos, zPos, rowCount,
+                        rowBuffer);
+            for (i = 0; i < rowCount; i++)
+            {
+                minValue = qMin(minValue, rowValues[i]);
+                maxValue = qMax(maxValue, rowValues[i]);
+            }
+        }
+    }
+
+    cellBlock->minValue = minValue;
+    cellBlock->maxValue = maxValue;
+}
+
+bool Poligonizator::isBlockCrossed(const CellBlock *cellBlock,
+            float isoLevel) const
+{
+    // cube index of a cell is neither 0 nor 255 only if some of its
+    // points are below isoLevel and some are not
+    return cellBlock->minValue < isoLevel && cellBlock->maxValue >= isoLevel;
+}
+
+void Poligonizator::recalculateTriangles(bool gridDimentionsChanged)
 {
     if (gridDimentionsChanged)
     {
         recalculateGridCells();
     }
 
-    recalculateTrianglesInGridCells(performPointValuesRecalculation);
-    recalculateNormalizedTriangles();
+    if (fExtractionMode == DUAL_MARCHING_CUBES)
+    {
+        recalculateOctreeTriangles(!gridDimentionsChanged);
+        return;
+    }
+
+    if (fFieldObject->gridKind() == SPARSE_GRID)
+    {
+        recalculateSparseTriangles();
+        return;
+    }
+
+    GridBox box = allBlocksBox();
+    recalculateTrianglesInBlocks(box);
+    recalculateNormalizedTriangles(box);
+    assembleTriangles();
     qDebug() << "Performed tirangles recalculation";
 }
 
-void Poligonizator::recalculateNormalizedTriangles()
+void Poligonizator::recalculateTriangles(const GridBox &cellsBox)
 {
-    if (fNormalMode == FLAT)
+    if (fExtractionMode == DUAL_MARCHING_CUBES)
     {
-        recalculateFlatNormalizedTriangles();
+        recalculateOctreeTriangles(true);
+        return;
     }
-    else
+
+    if (fFieldObject->gridKind() == SPARSE_GRID)
+    {
+        recalculateSparseTriangles();
+        return;
+    }
+
+    GridBox changedCellsBox = cellsBox;
+    if (fExtractionMode == SURFACE_NETS)
+    {
+        // net vertex normals keep gradients which are calculated from
+        // points next to the cell, so only this mode re-extracts cells
+        // around the box. Smooth and gradient normals of other modes are
+        // fixed by renormalizing neighbouring blocks below (see
+        // hasNeighbourDependence())
+        changedCellsBox.xMin--;
+        changedCellsBox.xMax++;
+        changedCellsBox.yMin--;
+        changedCellsBox.yMax++;
+        changedCellsBox.zMin--;
+        changedCellsBox.zMax++;
+    }
+
+    GridBox changedBlocksBox = blocksBox(changedCellsBox);
+    if (changedBlocksBox.xMin > changedBlocksBox.xMax ||
+                changedBlocksBox.yMin > changedBlocksBox.yMax ||
+                changedBlocksBox.zMin > changedBlocksBox.zMax)
+    {
+        return;
+    }
+
+    recalculateTrianglesInBlocks(changedBlocksBox);
+
+    GridBox normalizedBlocksBox = changedBlocksBox;
+    if (hasNeighbourDependence())
     {
-        recalculateSmoothNormalizedTriangles();
+        GridBox grownCellsBox = {
+            changedBlocksBox.xMin * kBlockSize - 1,
+            (changedBlocksBox.xMax + 1) * kBlockSize,
+            changedBlocksBox.yMin * kBlockSize - 1,
+            (changedBlocksBox.yMax + 1) * kBlockSize,
+            changedBlocksBox.zMin * kBlockSize - 1,
+            (changedBlocksBox.zMax + 1) * kBlockSize };
+        normalizedBlocksBox = blocksBox(grownCellsBox);
     }
+
+    recalculateNormalizedTriangles(normalizedBlocksBox);
+    assembleTriangles();
+    qDebug() << "Performed tirangles recalculation in blocks box";
 }
 
-void Poligonizator::recalculateFlatNormalizedTriangles()
+void Poligonizator::recalculateTrianglesForIsoLevel(float isoLevel)
 {
-    int cellCount = fGridCells.count();
+    float oldIsoLevel = fIsoLevel;
+    fIsoLevel = isoLevel;
 
-    QVector<TriangleN> *normalizedTriangles = new QVector<TriangleN>(0);
+    if (fExtractionMode == DUAL_MARCHING_CUBES)
+    {
+        recalculateOctreeTriangles(false);
+        return;
+    }
+
+    if (fFieldObject->gridKind() == SPARSE_GRID)
+    {
+        recalculateSparseTriangles();
+        return;
+    }
+
+    const Grid *grid = fFieldObject->grid()->data();
+
+    QVector<bool> changedBlocks(fBlocks.count(), false);
+    bool hasChangedBlocks = false;
+
+    QVector<GridIndex> oldActiveCellIndices;
+    QVector<unsigned char> oldCubeIndices;
+
+    int xBlock, yBlock, zBlock, i;
+    int blockIndex = 0;
+    for (zBlock = 0; zBlock < fZBlockDim; zBlock++)
+    {
+        for (yBlock = 0; yBlock < fYBlockDim; yBlock++)
+        {
+            for (xBlock = 0; xBlock < fXBlockDim; xBlock++, blockIndex++)
+            {
+                CellBlock *cellBlock = &(fBlocks[blockIndex]);
+                if (!isBlockCrossed(cellBlock, oldIsoLevel) &&
+                            !isBlockCrossed(cellBlock, isoLevel))
+                {
+                    continue; // no active cells before and after
+                }
+
+                QVector<GridIndex> &activeCellIndices =
+                            cellBlock->activeCellIndices;
+                int activeCellCount = activeCellIndices.count();
+
+                oldActiveCellIndices = activeCellIndices;
+                oldCubeIndices.resize(activeCellCount);
+                for (i = 0; i < activeCellCount; i++)
+                {
+                    oldCubeIndices[i] = fCubeIndices[activeCellIndices[i]];
+                }
+
+                classifyCells(grid, isoLevel,
+                            blockCellsBox(xBlock, yBlock, zBlock),
+                            &fCubeIndices, &activeCellIndices);
+
+                bool isTopologyKept =
+                            activeCellIndices == oldActiveCellIndices;
+                for (i = 0; isTopologyKept && i < activeCellCount; i++)
+                {
+                    isTopologyKept = oldCubeIndices[i] ==
+                                fCubeIndices[activeCellIndices[i]];
+                }
+
+                if (isTopologyKept && fExtractionMode == MARCHING_CUBES)
+                {
+                    for (i = 0; i < activeCellCount; i++)
+                    {
+                        fGridCells[activeCellIndices[i]].relerpTriangles(
+                                    isoLevel);
+                    }
+                }
+                else if (isTopologyKept)
+                {
+                    // point values of active cells are up to date
+                    for (i = 0; i < activeCellCount; i++)
+                    {
+                        recalculateCell(activeCellIndices[i], false);
+                    }
+                }
+                else
+                {
+                    // classification has to start from old active cells
+                    activeCellIndices = oldActiveCellIndices;
+                    recalculateTrianglesInBlock(xBlock, yBlock, zBlock);
+                }
+
+                changedBlocks[blockIndex] = true;
+                hasChangedBlocks = true;
+            }
+        }
+    }
+
+    if (!hasChangedBlocks)
+    {
+        return;
+    }
+
+    QVector<bool> normalizedBlocks = changedBlocks;
+    if (hasNeighbourDependence())
+    {
+        blockIndex = 0;
+        for (zBlock = 0; zBlock < fZBlockDim; zBlock++)
+        {
+            for (yBlock = 0; yBlock < fYBlockDim; yBlock++)
+            {
+                for (xBlock = 0; xBlock < fXBlockDim; xBlock++, blockIndex++)
+                {
+                    if (!changedBlocks[blockIndex])
+                    {
+                        continue;
+                    }
+
+                    GridBox neighboursBox = {
+                        qMax(xBlock - 1, 0), qMin(xBlock + 1, fXBlockDim - 1),
+                        qMax(yBlock - 1, 0), qMin(yBlock + 1, fYBlockDim - 1),
+                        qMax(zBlock - 1, 0), qMin(zBlock + 1, fZBlockDim - 1) };
+                    int x, y, z;
+                    for (z = neighboursBox.zMin; z <= neighboursBox.zMax; z++)
+                    {
+                        for (y = neighboursBox.yMin; y <= neighboursBox.yMax;
+                                    y++)
+                        {
+                            for (x = neighboursBox.xMin;
+                                        x <= neighboursBox.xMax; x++)
+                            {
+                                normalizedBlocks[(fXBlockDim * fYBlockDim *
+                                            z) + (fXBlockDim * y) + x] = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    blockIndex = 0;
+    for (zBlock = 0; zBlock < fZBlockDim; zBlock++)
+    {
+        for (yBlock = 0; yBlock < fYBlockDim; yBlock++)
+        {
+            for (xBlock = 0; xBlock < fXBlockDim; xBlock++, blockIndex++)
+            {
+                if (normalizedBlocks[blockIndex])
+                {
+                    GridBox box = { xBlock, xBlock, yBlock, yBlock,
+                                zBlock, zBlock };
+                    recalculateNormalizedTriangles(box);
+                }
+            }
+        }
+    }
+
+    assembleTriangles();
+    qDebug() << "Performed tirangles recalculation for new isosurface level";
+}
+
+void Poligonizator::recalculateNormalizedTriangles(const GridBox &blocksBox)
+{
+    int xBlock, yBlock, zBlock;
+    for (zBlock = blocksBox.zMin; zBlock <= blocksBox.zMax; zBlock++)
+    {
+        for (yBlock = blocksBox.yMin; yBlock <= blocksBox.yMax; yBlock++)
+        {
+            for (xBlock = blocksBox.xMin; xBlock <= blocksBox.xMax; xBlock++)
+            {
+                if (fExtractionMode == SURFACE_NETS)
+                {
+                    recalculateNetNormalizedTriangles(
+                                block(xBlock, yBlock, zBlock));
+                    continue;
+                }
+
+                switch (fNormalMode)
+                {
+                    case SMOOTH:
+                    {
+                        recalculateSmoothNormalizedTriangles(
+                                    block(xBlock, yBlock, zBlock));
+                        break;
+                    }
+                    case GRADIENT:
+                    {
+                        recalculateGradientNormalizedTriangles(
+                                    block(xBlock, yBlock, zBlock));
+                        break;
+                    }
+                    default:
+                    {
+                        recalculateFlatNormalizedTriangles(
+                                    block(xBlock, yBlock, zBlock));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Poligonizator::recalculateFlatNormalizedTriangles(CellBlock *cellBlock)
+{
+    const QVector<GridIndex> &activeCellIndices = cellBlock->activeCellIndices;
+    int activeCellCount = activeCellIndices.count();
+
+    QVector<TriangleN> &normalizedTriangles = cellBlock->triangles;
+    normalizedTriangles.clear();
     // Reserving memory for estimated maximal number of trinagles per
-    // field object
-    normalizedTriangles->reserve(4 * cellCount);
+    // block
+    normalizedTriangles.reserve(4 * activeCellCount);
 
     QVector<TriangleN> cellTriangles;
     int cellTriangleCount = 0;
-    int triangleCount = 0;
     int i, j;
-    for (i = 0; i < cellCount; i++)
+    for (i = 0; i < activeCellCount; i++)
     {
-        cellTriangles = fGridCells[i].triangles();
+        cellTriangles = fGridCells[activeCellIndices[i]].triangles();
         cellTriangleCount = cellTriangles.count();
         for (j = 0; j < cellTriangleCount; j++)
         {
-            normalizedTriangles->append(cellTriangles[j]);
+            normalizedTriangles.append(cellTriangles[j]);
         }
-        triangleCount += cellTriangleCount;
     }
-    normalizedTriangles->squeeze();
-
-    fFlatNormalizedTrianglesPtr =
-                QSharedPointer<QVector<TriangleN> >(normalizedTriangles);
-
-    // qDebug() << "TRIANGLES COUNT = " << triangleCount;
+    normalizedTriangles.squeeze();
 }
 
-void Poligonizator::recalculateSmoothNormalizedTriangles()
+void Poligonizator::recalculateSmoothNormalizedTriangles(CellBlock *cellBlock)
 {
     GridCell *cell = 0;
 
@@ -162,16 +669,19 @@ void Poligonizator::recalculateSmoothNormalizedTriangles()
     TriangleN triangle;
     TriangleN normalizedTriangle;
 
-    int cellCount = fGridCells.count();
-    QVector<TriangleN> *normalizedTriangles = new QVector<TriangleN>(0);
+    const QVector<GridIndex> &activeCellIndices = cellBlock->activeCellIndices;
+    int activeCellCount = activeCellIndices.count();
+
+    QVector<TriangleN> &normalizedTriangles = cellBlock->triangles;
+    normalizedTriangles.clear();
     // Reserving memory for estimated maximal number of trinagles per
-    // field object
-    normalizedTriangles->reserve(4 * cellCount);
+    // block
+    normalizedTriangles.reserve(4 * activeCellCount);
 
     int i, j, k;
-    for (i = 0; i < cellCount; i++)
+    for (i = 0; i < activeCellCount; i++)
     {
-        cell = &(fGridCells[i]);
+        cell = &(fGridCells[activeCellIndices[i]]);
         cellTriangles = cell->triangles();
         cellTriangleCount = cellTriangles.count();
         for (j = 0; j < cellTriangleCount; j++)
@@ -184,18 +694,360 @@ void Poligonizator::recalculateSmoothNormalizedTriangles()
                 normalizedTriangle.p[k] =
                             normalizeVertex(triangle.p[k].p, adjacentTriangles);
             }
-            normalizedTriangles->append(normalizedTriangle);
+            normalizedTriangles.append(normalizedTriangle);
+        }
+    }
+    normalizedTriangles.squeeze();
+}
+
+void Poligonizator::recalculateGradientNormalizedTriangles(
+            CellBlock *cellBlock)
+{
+    const QVector<GridIndex> &activeCellIndices = cellBlock->activeCellIndices;
+    int activeCellCount = activeCellIndices.count();
+
+    QVector<TriangleN> &normalizedTriangles = cellBlock->triangles;
+    normalizedTriangles.clear();
+    // Reserving memory for estimated maximal number of trinagles per
+    // block
+    normalizedTriangles.reserve(4 * activeCellCount);
+
+    for (int i = 0; i < activeCellCount; i++)
+    {
+        normalizedTriangles += fGridCells[activeCellIndices[i]].
+                    gradientNormalizedTriangles();
+    }
+    normalizedTriangles.squeeze();
+}
+
+void Poligonizator::recalculateNetNormalizedTriangles(CellBlock *cellBlock)
+{
+    const QVector<GridIndex> &activeCellIndices = cellBlock->activeCellIndices;
+    int activeCellCount = activeCellIndices.count();
+
+    QVector<TriangleN> &normalizedTriangles = cellBlock->triangles;
+    normalizedTriangles.clear();
+    // Reserving memory for estimated maximal number of trinagles per
+    // block
+    normalizedTriangles.reserve(2 * activeCellCount);
+
+    // Each cell owns three grid edges going from its vertex 0 (edges 0, 3
+    // and 8), quad of crossed edge joins net vertexes of four cells around
+    // the edge. Cells are listed counterclockwise around edge direction.
+    const int kEdgeCells[3][4][3] = {
+        { { 0, 0, 0 }, { 0, -1, 0 }, { 0, -1, -1 }, { 0, 0, -1 } },
+        { { 0, 0, 0 }, { 0, 0, -1 }, { -1, 0, -1 }, { -1, 0, 0 } },
+        { { 0, 0, 0 }, { -1, 0, 0 }, { -1, -1, 0 }, { 0, -1, 0 } } };
+    // cube index bit of other edge's end (vertexes 1, 3 and 4)
+    const int kEdgeEndBits[3] = { 2, 8, 16 };
+
+    const GridCell *cell = 0;
+    const GridCell *quadCells[4];
+    TriangleN triangle;
+    int cubeIndex = 0;
+    int i, edge, j;
+    GridIndex index;
+    for (i = 0; i < activeCellCount; i++)
+    {
+        cell = &(fGridCells[activeCellIndices[i]]);
+        cubeIndex = cell->cubeIndex();
+        for (edge = 0; edge < 3; edge++)
+        {
+            bool isBelowBegin = (cubeIndex & 1) != 0;
+            bool isBelowEnd = (cubeIndex & kEdgeEndBits[edge]) != 0;
+            if (isBelowBegin == isBelowEnd)
+            {
+                continue;
+            }
+
+            for (j = 0; j < 4; j++)
+            {
+                index = gridCellIndex(cell->xPos() + kEdgeCells[edge][j][0],
+                            cell->yPos() + kEdgeCells[edge][j][1],
+                            cell->zPos() + kEdgeCells[edge][j][2]);
+                if (index < 0)
+                {
+                    break; // edge lies on the grid border
+                }
+                quadCells[j] = &(fGridCells[index]);
+            }
+            if (j < 4)
+            {
+                continue;
+            }
+
+            // quad faces from vertex 0 if it is below iso level (outside)
+            int order[4] = { 0, 1, 2, 3 };
+            if (isBelowBegin)
+            {
+                order[1] = 3;
+                order[3] = 1;
+            }
+
+            triangle.p[0] = quadCells[order[0]]->netVertex();
+            triangle.p[1] = quadCells[order[1]]->netVertex();
+            triangle.p[2] = quadCells[order[2]]->netVertex();
+            normalizedTriangles.append(triangle);
+            triangle.p[1] = triangle.p[2];
+            triangle.p[2] = quadCells[order[3]]->netVertex();
+            normalizedTriangles.append(triangle);
+        }
+    }
+
+    if (fNormalMode == FLAT)
+    {
+        int triangleCount = normalizedTriangles.count();
+        Triangle flatTriangle;
+        for (i = 0; i < triangleCount; i++)
+        {
+            for (j = 0; j < 3; j++)
+            {
+                flatTriangle.p[j] = normalizedTriangles[i].p[j].p;
+            }
+            normalizedTriangles[i] = normalizeTriangle(flatTriangle);
+        }
+    }
+    normalizedTriangles.squeeze();
+}
+
+bool Poligonizator::hasNeighbourDependence() const
+{
+    // smooth and gradient normals near block borders depend on
+    // neighbouring cells, quads of surface nets join cells of neighbouring
+    // blocks too
+    return fNormalMode != FLAT || fExtractionMode == SURFACE_NETS;
+}
+
+void Poligonizator::assembleTriangles()
+{
+    int blockCount = fBlocks.count();
+    int triangleCount = 0;
+    int i;
+    for (i = 0; i < blockCount; i++)
+    {
+        triangleCount += fBlocks[i].triangles.count();
+    }
+
+    QVector<TriangleN> *normalizedTriangles = new QVector<TriangleN>(0);
+    normalizedTriangles->reserve(triangleCount);
+    for (i = 0; i < blockCount; i++)
+    {
+        *normalizedTriangles += fBlocks[i].triangles;
+    }
+
+    setNormalizedTriangles(normalizedTriangles);
+
+    // qDebug() << "TRIANGLES COUNT = " << triangleCount;
+}
+
+void Poligonizator::setNormalizedTriangles(
+            QVector<TriangleN> *normalizedTriangles)
+{
+    QSharedPointer<QVector<TriangleN> > resTrianglesPtr(normalizedTriangles);
+    switch (fNormalMode)
+    {
+        case SMOOTH:
+        {
+            fSmoothNormalizedTrianglesPtr = resTrianglesPtr;
+            break;
+        }
+        case GRADIENT:
+        {
+            fGradientNormalizedTrianglesPtr = resTrianglesPtr;
+            break;
+        }
+        default:
+        {
+            fFlatNormalizedTrianglesPtr = resTrianglesPtr;
+        }
+    }
+}
+
+void Poligonizator::recalculateSparseTriangles()
+{
+    const SparseGrid *grid = fFieldObject->sparseGrid()->data();
+    if (!grid->isInBand(fIsoLevel))
+    {
+        qWarning() << "Poligonizator: iso level" << fIsoLevel <<
+                    "is out of sparse grid band, isosurface may be incomplete";
+    }
+
+    QVector<TriangleN> *normalizedTriangles = new QVector<TriangleN>(0);
+
+    unsigned int tileCount = grid->tileCount();
+    for (unsigned int tile = 0; tile < tileCount; tile++)
+    {
+        if (grid->isTileStored(tile))
+        {
+            recalculateTrianglesInTile(tile, normalizedTriangles);
         }
     }
     normalizedTriangles->squeeze();
 
-    fSmoothNormalizedTrianglesPtr =
-                QSharedPointer<QVector<TriangleN> >(normalizedTriangles);
+    setNormalizedTriangles(normalizedTriangles);
+    qDebug() << "Performed sparse grid triangles recalculation";
+}
+
+void Poligonizator::recalculateTrianglesInTile(unsigned int tile,
+            QVector<TriangleN> *normalizedTriangles)
+{
+    const SparseGrid *grid = fFieldObject->sparseGrid()->data();
+
+    unsigned int xTileDim = grid->xTileDimention();
+    unsigned int yTileDim = grid->yTileDimention();
+
+    unsigned int xFirst = (tile % xTileDim) << kTileSideBits;
+    unsigned int yFirst = ((tile / xTileDim) % yTileDim) << kTileSideBits;
+    unsigned int zFirst = (tile / (xTileDim * yTileDim)) << kTileSideBits;
+
+    // cells of a tile are ones which first vertex is in the tile
+    unsigned int xLast = qMin(xFirst + kTileSide, grid->xDimention() - 1);
+    unsigned int yLast = qMin(yFirst + kTileSide, grid->yDimention() - 1);
+    unsigned int zLast = qMin(zFirst + kTileSide, grid->zDimention() - 1);
+
+    Point points[8];
+    float pointValues[8];
+    Point gradients[8];
+
+    Point steps = { grid->xStep(), grid->yStep(), grid->zStep() };
+
+    QVector<TriangleN> cellTriangles;
+    unsigned int xPos, yPos, zPos;
+    unsigned int xVertex, yVertex, zVertex;
+    int cubeIndex;
+    int i;
+    for (zPos = zFirst; zPos < zLast; zPos++)
+    {
+        for (yPos = yFirst; yPos < yLast; yPos++)
+        {
+            for (xPos = xFirst; xPos < xLast; xPos++)
+            {
+                cubeIndex = 0;
+                for (i = 0; i < 8; i++)
+                {
+                    pointValues[i] = grid->value(xPos + kVertexOffsets[i][0],
+                                yPos + kVertexOffsets[i][1],
+                                zPos + kVertexOffsets[i][2]);
+                    if (pointValues[i] < fIsoLevel)
+                    {
+                        cubeIndex |= 1 << i;
+                    }
+                }
+
+                if (cubeIndex == 0 || cubeIndex == 255)
+                {
+                    continue;
+                }
+
+                for (i = 0; i < 8; i++)
+                {
+                    xVertex = xPos + kVertexOffsets[i][0];
+                    yVertex = yPos + kVertexOffsets[i][1];
+                    zVertex = zPos + kVertexOffsets[i][2];
+                    points[i].x = grid->xCoord(xVertex);
+                    points[i].y = grid->yCoord(yVertex);
+                    points[i].z = grid->zCoord(zVertex);
+                    if (fNormalMode != FLAT)
+                    {
+                        gradients[i] = grid->gradient(xVertex, yVertex,
+                                    zVertex);
+                    }
+                }
+
+                GridCell cell(points, pointValues);
+                cell.setIsoLevel(fIsoLevel);
+                cell.recalculateTriangles(false);
+                cellTriangles = cell.triangles();
+
+                if (fNormalMode != FLAT)
+                {
+                    setGradientNormals(&cellTriangles, gradients, points[0],
+                                steps);
+                }
+
+                *normalizedTriangles += cellTriangles;
+            }
+        }
+    }
+}
+
+void Poligonizator::recalculateOctreeTriangles(bool fieldChanged)
+{
+    const Grid *grid = fFieldObject->grid()->data();
+    Point minPoint = { grid->xMin(), grid->yMin(), grid->zMin() };
+    Point maxPoint = { grid->xMax(), grid->yMax(), grid->zMax() };
+
+    if (fOctree.isNull())
+    {
+        fOctree = QSharedPointer<Octree>(new Octree(fFieldObject, minPoint,
+                    maxPoint, fOctreeDepth));
+    }
+    fOctree->setBounds(minPoint, maxPoint);
+    fOctree->setMaxDepth(fOctreeDepth);
+    fOctree->setIsoLevel(fIsoLevel);
+    fOctree->rebuild(fieldChanged);
+
+    recalculateOctreeNormalizedTriangles();
+}
+
+void Poligonizator::recalculateOctreeNormalizedTriangles()
+{
+    const QVector<OctreeNode> &nodes = fOctree->nodes();
+    const QVector<DualCell> &dualCells = fOctree->dualCells();
+    int dualCellCount = dualCells.count();
+
+    QVector<TriangleN> *normalizedTriangles = new QVector<TriangleN>(0);
+    normalizedTriangles->reserve(2 * dualCellCount);
+
+    Point points[8];
+    float pointValues[8];
+    Point gradients[8];
+
+    QVector<TriangleN> cellTriangles;
+    int cellTriangleCount;
+    int node;
+    int i, j;
+    for (i = 0; i < dualCellCount; i++)
+    {
+        for (j = 0; j < 8; j++)
+        {
+            // dual cell nodes go in (x + 2 * y + 4 * z) order
+            node = dualCells[i].nodes[kVertexOffsets[j][0] +
+                        2 * kVertexOffsets[j][1] + 4 * kVertexOffsets[j][2]];
+            points[j] = fOctree->nodeCenter(node);
+            pointValues[j] = nodes[node].value;
+            if (fNormalMode != FLAT)
+            {
+                gradients[j] = fOctree->nodeGradient(node);
+            }
+        }
+
+        GridCell cell(points, pointValues);
+        cell.setIsoLevel(fIsoLevel);
+        cell.recalculateTriangles(false);
+        cellTriangles = (fNormalMode == FLAT) ? cell.triangles() :
+                    cell.gradientNormalizedTriangles(gradients);
+
+        cellTriangleCount = cellTriangles.count();
+        for (j = 0; j < cellTriangleCount; j++)
+        {
+            // leaves repeated in a dual cell give degenerate triangles
+            const TriangleN &triangle = cellTriangles[j];
+            if (!equalPoints(triangle.p[0].p, triangle.p[1].p) &&
+                        !equalPoints(triangle.p[1].p, triangle.p[2].p) &&
+                        !equalPoints(triangle.p[2].p, triangle.p[0].p))
+            {
+                normalizedTriangles->append(triangle);
+            }
+        }
+    }
+    normalizedTriangles->squeeze();
 
-    //qDebug() << "TRIANGLES COUNT = " << triangleCount;
+    setNormalizedTriangles(normalizedTriangles);
+    qDebug() << "Performed octree triangles recalculation";
 }
 
-int Poligonizator::gridCellIndex(int xPos, int yPos, int zPos) const
+GridIndex Poligonizator::gridCellIndex(int xPos, int yPos, int zPos) const
 {
     const Grid *grid = fFieldObject->grid()->data();
     int xCellDim = grid->xDimention() - 1;
@@ -209,7 +1061,8 @@ int Poligonizator::gridCellIndex(int xPos, int yPos, int zPos) const
     }
     else
     {
-        return (xCellDim * yCellDim * zPos) + (xCellDim * yPos) + xPos;
+        return (static_cast<GridIndex>(xCellDim) * yCellDim * zPos) +
+                    (static_cast<GridIndex>(xCellDim) * yPos) + xPos;
     }
 }
 
@@ -228,7 +1081,7 @@ QVector<TriangleN> Poligonizator::adjacentTrianglesForVertex(const Point &point,
     QVector<TriangleN> cellTriangles(0);
     cellTriangles.reserve(5);
 
-    int index = 0;
+    GridIndex index = 0;
     int xPos, yPos, zPos, i;
     for(zPos = -1; zPos < 2; zPos++)
     {
@@ -30,18 +30,52 @@
 typedef enum
 {
     FLAT = 1,
-    SMOOTH
+    SMOOTH,
+    GRADIENT
 } NormalMode;
 
+typedef enum
+{
+    MARCHING_CUBES = 1,
+    SURFACE_NETS,
+    MARCHING_TETRAHEDRONS,
+    DUAL_MARCHING_CUBES // on adaptive octree, see Octree.
+} ExtractionMode;
+
+// Represents block of grid cells which holds its own part of poligonizator's
+// output, so only blocks touched by a change have to be rebuilt.
+typedef struct
+{
+    QVector<GridIndex> activeCellIndices;
+    QVector<TriangleN> triangles;
+    float minValue; // of block's grid points.
+    float maxValue;
+} CellBlock;
+
 class FieldObject;
+class Octree;
 
 // Represents tool for poligonization (giving triangular isosurface
 // representation) of any field object. Poligonozator's output are normalized
-// triangles. Flat and smooth triangles normalization are supported.
+// triangles. Flat, smooth and field gradient triangles normalization are
+// supported. Triangles are extracted either by marching cubes, by surface
+// nets (one vertex per crossed cell, one quad per crossed grid edge, so
+// surface has much less of sliver triangles) or by marching tetrahedrons
+// (no ambiguous cases, but more triangles). Field object of sparse grid kind
+// is poligonized by marching cubes performed only in cells of stored tiles
+// (see SparseGrid), smooth normal mode gives gradient normals then. Dual
+// marching cubes do not use the grid at all: field is sampled by adaptive
+// octree over grid bounds, which is much finer than the grid near the
+// surface; smooth normal mode gives gradient normals too.
 class Poligonizator
 {
 public:
-    Poligonizator(const FieldObject *fieldObject);
+    // Triangles are extracted once here with given level and modes, so
+    // they are better given than set afterwards (setters extract again).
+    Poligonizator(FieldObject *fieldObject, float isoLevel = 2.0,
+                NormalMode normalMode = FLAT,
+                ExtractionMode extractionMode = MARCHING_CUBES,
+                unsigned int octreeDepth = 7);
 
     inline float isoLevel() const { return fIsoLevel; }
     void setIsoLevel(float isoLevel) { fIsoLevel = isoLevel; }
@@ -49,34 +83,95 @@ public:
     NormalMode normalMode() const { return fNormalMode; }
     void setNormalMode(NormalMode normalMode);
 
+    ExtractionMode extractionMode() const { return fExtractionMode; }
+    void setExtractionMode(ExtractionMode extractionMode);
+
+    // Octree of dual marching cubes has 2^depth finest cells per side.
+    unsigned int octreeDepth() const { return fOctreeDepth; }
+    void setOctreeDepth(unsigned int depth);
+
     QSharedPointer<const QVector<TriangleN> > trianglesPtr() const;
-    void recalculateTriangles(bool gridDimentionsChanged = false,
-                bool performPointValuesRecalculation = true);
+    // Octree samples the field itself, so it is kept when only grid
+    // dimentions have changed (grid bounds are octree bounds though).
+    void recalculateTriangles(bool gridDimentionsChanged = false);
+    // Rebuilds only blocks which intersect given box of cells (f.e. one
+    // returned by Field::updateMetaObject()), other blocks keep their
+    // triangles.
+    void recalculateTriangles(const GridBox &cellsBox);
+    // Field is unchanged, so blocks which value range does not include
+    // neither old nor new level are skipped, and cells which stay active
+    // with the same cube index only move their vertexes along cube edges.
+    void recalculateTrianglesForIsoLevel(float isoLevel);
 
 protected:
-    // Performs complete grid repartitioning into cells and computes field
-    // values in each cell's vertex
+    // Performs complete grid repartitioning into cells and blocks and
+    // computes field values in each cell's vertex
     void recalculateGridCells();
 
-    void recalculateTrianglesInGridCells(
-                bool performPointValuesRecalculation = true);
+    GridBox allBlocksBox() const;
+    // Box of blocks which intersect given box of cells.
+    GridBox blocksBox(const GridBox &cellsBox) const;
+    GridBox blockCellsBox(int xBlock, int yBlock, int zBlock) const;
+    CellBlock *block(int xBlock, int yBlock, int zBlock);
+
+    // Only cells found active by Classification pre-pass are processed.
+    void recalculateTrianglesInBlocks(const GridBox &blocksBox);
+    void recalculateTrianglesInBlock(int xBlock, int yBlock, int zBlock);
+    // Recalculates cell with current extraction mode, cell's cube index has
+    // to be already classified.
+    void recalculateCell(GridIndex cellIndex,
+                bool performPointValuesRecalculation);
+    void recalculateBlockValueRange(CellBlock *cellBlock,
+                const GridBox &cellsBox);
+    // Returns true if isosurface of given level may cross the block.
+    bool isBlockCrossed(const CellBlock *cellBlock, float isoLevel) const;
+
+    void recalculateNormalizedTriangles(const GridBox &blocksBox);
+    void recalculateFlatNormalizedTriangles(CellBlock *block);
+    void recalculateSmoothNormalizedTriangles(CellBlock *block);
+    void recalculateGradientNormalizedTriangles(CellBlock *block);
+    // Builds quads (as triangle pairs) of surface nets, flat normal mode
+    // gives face normals, other modes give net vertex gradient normals.
+    void recalculateNetNormalizedTriangles(CellBlock *block);
+    // Returns true if normalized triangles of a block depend on cells of
+    // neighbouring blocks.
+    bool hasNeighbourDependence() const;
+    // Joins triangles of all blocks into poligonizator's output.
+    void assembleTriangles();
+    // Takes ownership of triangles normalized with current normal mode.
+    void setNormalizedTriangles(QVector<TriangleN> *normalizedTriangles);
+
+    // Sparse grid is poligonized as a whole, there are no cells and blocks.
+    void recalculateSparseTriangles();
+    void recalculateTrianglesInTile(unsigned int tile,
+                QVector<TriangleN> *normalizedTriangles);
 
-    void recalculateNormalizedTriangles();
-    void recalculateFlatNormalizedTriangles();
-    void recalculateSmoothNormalizedTriangles();
+    // Octree is rebuilt over current grid bounds, values it has evaluated
+    // are reused if field is not changed.
+    void recalculateOctreeTriangles(bool fieldChanged);
+    void recalculateOctreeNormalizedTriangles();
 
     // Returns -1 if invalid cell position is given
-    int gridCellIndex(int xPos, int yPos, int zPos) const;
+    GridIndex gridCellIndex(int xPos, int yPos, int zPos) const;
     QVector<TriangleN> adjacentTrianglesForVertex(const Point &point,
                 const GridCell *cell);
 
 private:
     NormalMode fNormalMode;
+    ExtractionMode fExtractionMode;
     float fIsoLevel;
-    const FieldObject *fFieldObject;
+    FieldObject *fFieldObject;
     QVector<GridCell> fGridCells;
+    QVector<unsigned char> fCubeIndices;
+    QVector<CellBlock> fBlocks;
+    int fXBlockDim; // in blocks.
+    int fYBlockDim;
+    int fZBlockDim;
+    unsigned int fOctreeDepth;
+    QSharedPointer<Octree> fOctree;
     QSharedPointer<QVector<TriangleN> > fFlatNormalizedTrianglesPtr;
     QSharedPointer<QVector<TriangleN> > fSmoothNormalizedTrianglesPtr;
+    QSharedPointer<QVector<TriangleN> > fGradientNormalizedTrianglesPtr;
 };
 
 #endif // POLIGONIZATOR_H
@@ -20,9 +20,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits>
 
 #include <QRegExp>
+#include <QStringList>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QDebug>
 
 #include "infixlex_types.h"
@@ -42,6 +46,10 @@ const char kFunctionAbs[] = "abs";
 namespace Infix
 {
     extern "C" int parse(char *string, Token **outTokens, char **errString);
+
+    // Parser keeps its state and results in globals, so expressions which
+    // are created in different threads are parsed one at a time.
+    QMutex parserMutex;
 }
 
 PostfixExpr::PostfixExpr(const QString &infixString)
@@ -53,6 +61,28 @@ PostfixExpr::PostfixExpr(const QString &infixString)
     parse(infixString);
 }
 
+PostfixExpr::PostfixExpr(const PostfixExpr &copyee)
+            : fSuccessfullyParsed(copyee.fSuccessfullyParsed),
+            fInfixString(copyee.fInfixString),
+            fParsedTokens(copyee.fParsedTokens)
+{
+    fCalculationStack.reserve(kExecutionStackSize);
+
+    if (fSuccessfullyParsed)
+    {
+        makePostfix(fParsedTokens.data(), fParsedTokens.count());
+
+        VariablesManager copyeeVariablesManager(copyee.fVariablesManager);
+        QStringList variableNames(fVariablesManager.variableNames());
+        for (int i = 0; i < variableNames.count(); i++)
+        {
+            fVariablesManager.setVariableValue(variableNames[i],
+                        copyeeVariablesManager.variableValue(
+                        variableNames[i]));
+        }
+    }
+}
+
 PostfixExpr::~PostfixExpr()
 {
     int tokenCount = fInfixOrderedTokens.count();
@@ -114,13 +144,17 @@ double PostfixExpr::execute()
 
 void PostfixExpr::parse(const QString &infixString)
 {
+    QMutexLocker locker(&Infix::parserMutex);
+
     Token *tokens = 0;
     char *errorString = 0;
     int tokenCount = Infix::parse(infixString.toAscii().data(),
                 &tokens, &errorString);
     if (tokenCount > 0)
     {
-        makePostfix(tokens, tokenCount);
+        fParsedTokens = QVector<Token>(tokenCount);
+        memcpy(fParsedTokens.data(), tokens, tokenCount * sizeof(Token));
+        makePostfix(fParsedTokens.data(), tokenCount);
         fSuccessfullyParsed = true;
     }
     else // error, writting message to fInfixString
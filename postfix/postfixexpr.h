@@ -23,6 +23,7 @@
 
 #include <QStack>
 #include <QList>
+#include <QVector>
 #include <QString>
 #include <QSharedPointer>
 
@@ -40,6 +41,10 @@ class PostfixExpr
 {
 public:
     PostfixExpr(const QString &infixString);
+    // Copy is built of tokens copyee was parsed to, so expression is not
+    // parsed again. It has its own variables (with values of copyee ones),
+    // so copies may be executed concurrently.
+    PostfixExpr(const PostfixExpr &copyee);
     ~PostfixExpr();
 
     bool successfullyParsed() { return fSuccessfullyParsed; }
@@ -65,6 +70,7 @@ private: // data
     bool fSuccessfullyParsed;
 
     QString fInfixString;
+    QVector<Token> fParsedTokens; // parser output, copies are built of it.
 
     QList<PostfixToken *> fInfixOrderedTokens;
     QList<PostfixToken *> fTokens;
@@ -26,7 +26,6 @@
 
 #include <QtOpenGL>
 #include <QDebug>
-#include <QByteArray>
 #include <QInputDialog>
 #include <QStringList>
 #include <QColorDialog>
@@ -68,44 +67,6 @@ GLArea::GLArea(QWidget *parent) : QGLWidget(parent),
     updateGL();
 }
 
-QByteArray GLArea::wavefrontSurfaceRepresentation()
-{
-    QByteArray result;
-
-    // f.e.:
-    //
-    // v  0.00  0.00  0.00
-    // v  1.00  2.00  3.00
-    // v -1.00 -2.00 -3.00
-    // f 1 2 3
-    //
-    // describes one face defined by three vertexes
-
-    const char vertexEntryFormat[] = "v %6.6f %6.6f %6.6f\n";
-    const char faceEntryFormat[] = "f %i %i %i\n";
-
-    TriangleN triangle;
-    Point p;
-    int vertexIndex = 0;
-
-    int triangleCount = fTrianglesPtr->count();
-    int i, j;
-    for (i = 0; i < triangleCount; i++)
-    {
-        triangle = fTrianglesPtr->at(i);
-        for (j = 0; j < 3; j++)
-        {
-            p = triangle.p[j].p;
-            result += QString().sprintf(vertexEntryFormat, p.x, p.y, p.z);
-        }
-        vertexIndex = 3 * i;
-        result += QString().sprintf(faceEntryFormat,
-                    vertexIndex + 1, vertexIndex + 2, vertexIndex + 3);
-    }
-
-    return result;
-}
-
 void GLArea::shineSurface()
 {
     int steps = 100;
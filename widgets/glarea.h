@@ -38,7 +38,6 @@
     updateGL(); \
 }
 
-class QByteArray;
 class QColor;
 
 // Represents widget with OpenGL area which shows the result poligonized
@@ -49,7 +48,8 @@ class GLArea : public QGLWidget
 
 public:
     GLArea(QWidget *parent);
-    QByteArray wavefrontSurfaceRepresentation();
+    QSharedPointer<const QVector<TriangleN> > trianglesPtr() const
+                { return fTrianglesPtr; }
 
 signals:
     void rotationXChanged(int);
@@ -26,6 +26,7 @@
 #include <QInputDialog>
 #include <QFileDialog>
 #include <QFile>
+#include <QMessageBox>
 #include <QApplication>
 #include <QDebug>
 #include <QXmlQuery>
@@ -38,8 +39,14 @@
 #include "glarea.h"
 #include "viewcontroller.h"
 #include "metaobjectscontroller.h"
+#include "documentfile.h"
 
-MainWindow::MainWindow(QMainWindow *parent) : QMainWindow(parent)
+const char kBinaryDocumentSuffix[] = ".mob";
+const int kAutosaveInterval = 30000; // ms.
+
+MainWindow::MainWindow(QMainWindow *parent) : QMainWindow(parent),
+            fJournal(DocumentJournal::newDirectory(
+            DocumentJournal::defaultLocation()))
 {
     fUI.setupUi(this);
 
@@ -47,20 +54,33 @@ MainWindow::MainWindow(QMainWindow *parent) : QMainWindow(parent)
     initConnections();
 
     fUI.wMetaObjectsController->initField();
+    initJournal();
 
     // documentXMLData();
 }
 
 MainWindow::~MainWindow()
 {
+    // nothing to recover after normal exit
+    fUI.wMetaObjectsController->setJournal(0);
+    fJournal.discard();
 }
 
 void MainWindow::openDocument()
 {
     QString filename = QFileDialog::getOpenFileName(this,
-                trUtf8("Открыть документ"), "", tr("Meta Objects XML (*.mox)"));
+                trUtf8("Открыть документ"), "",
+                tr("Meta Objects XML (*.mox);;Meta Objects Binary (*.mob)"));
 
-    if (!filename.isEmpty())
+    if (filename.endsWith(kBinaryDocumentSuffix))
+    {
+        DocumentFile document;
+        if (document.open(filename))
+        {
+            initDocumentWithFile(document);
+        }
+    }
+    else if (!filename.isEmpty())
     {
         QFile file(filename);
         file.open(QIODevice::ReadOnly);
@@ -76,30 +96,91 @@ void MainWindow::saveDocument()
 {
     QString filename = QFileDialog::getSaveFileName(this,
                 trUtf8("Сохранить документ"), "",
-                tr("Meta Objects XML (*.mox)"));
+                tr("Meta Objects XML (*.mox);;Meta Objects Binary (*.mob)"));
 
-    if (!filename.isEmpty())
+    if (filename.endsWith(kBinaryDocumentSuffix))
+    {
+        DocumentFile document;
+        document.addSection(VIEW_SECTION,
+                    fUI.wViewController->XMLRepresentation(),
+                    ZLIB_COMPRESSION);
+        fUI.wMetaObjectsController->saveToDocument(&document);
+        document.save(filename);
+    }
+    else if (!filename.isEmpty())
     {
         QFile file(filename);
         file.open(QIODevice::WriteOnly);
         file.write(documentXMLData());
         file.close();
+        // meta-objects of saved document are not evaluated when it is opened
+        fUI.wMetaObjectsController->storeFieldInCache();
     }
 }
 
 void MainWindow::exportSurfaceToWavefront()
 {
-    QString filename = QFileDialog::getSaveFileName(this,
-                trUtf8("Экспортировать поверхность в Wavefront Object"), "",
-                tr("Wavefront Object (*.obj)"));
+    exportSurface(trUtf8("Экспортировать поверхность в Wavefront Object"),
+                tr("Wavefront Object (*.obj)"), MeshExport::writeWavefront);
+}
 
-    if (!filename.isEmpty())
+void MainWindow::exportSurfaceToPly()
+{
+    exportSurface(trUtf8("Экспортировать поверхность в PLY"),
+                tr("Polygon File Format (*.ply)"), MeshExport::writePly);
+}
+
+void MainWindow::exportSurfaceToStl()
+{
+    exportSurface(trUtf8("Экспортировать поверхность в STL"),
+                tr("Stereolithography (*.stl)"), MeshExport::writeStl);
+}
+
+void MainWindow::autosave()
+{
+    fJournal.setViewXMLData(fUI.wViewController->XMLRepresentation());
+    fJournal.compact();
+}
+
+void MainWindow::initJournal()
+{
+    // documents of instances which were not closed normally are offered
+    // from the most recent one, declined ones are dropped. Documents left
+    // after the recovered one are offered on next start.
+    QStringList directories(DocumentJournal::recoverableDirectories(
+                DocumentJournal::defaultLocation()));
+    QStringList handledDirectories;
+    for (int i = directories.count() - 1; i >= 0; i--)
     {
-        QFile file(filename);
-        file.open(QIODevice::WriteOnly);
-        file.write(fUI.wGLArea->wavefrontSurfaceRepresentation());
-        file.close();
+        bool recover = QMessageBox::question(this,
+                    trUtf8("Восстановление"), trUtf8("Восстановить "
+                    "документ, не сохранённый в прошлый раз?"),
+                    QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes;
+        if (recover)
+        {
+            QByteArray xmlData(DocumentJournal::recoveredDocumentXMLData(
+                        directories[i]));
+            QBuffer xmlBuffer(&xmlData);
+            if (xmlData.count() > 0)
+            {
+                initDocumentWithXML(&xmlBuffer);
+            }
+        }
+        handledDirectories.append(directories[i]);
+        if (recover)
+        {
+            break;
+        }
+    }
+
+    fJournal.setViewXMLData(fUI.wViewController->XMLRepresentation());
+    fUI.wMetaObjectsController->setJournal(&fJournal);
+    // recovered document is journaled in directory of this instance now
+    for (int i = 0; i < handledDirectories.count(); i++)
+    {
+        DocumentJournal::removeDirectory(handledDirectories[i]);
     }
+    fAutosaveTimer.start(kAutosaveInterval);
 }
 
 void MainWindow::initConnections()
@@ -149,6 +230,8 @@ void MainWindow::initConnections()
                 SLOT(enterFieldExpression(bool)));
     connect(fUI.aRemove, SIGNAL(triggered(bool)), fUI.wMetaObjectsController,
                 SLOT(removeSelectedMetaObject(bool)));
+    connect(fUI.aFieldCache, SIGNAL(toggled(bool)),
+                fUI.wMetaObjectsController, SLOT(setFieldCacheEnabled(bool)));
 
     // ViewController <-> MetaObjectsController
     connect(fUI.wViewController, SIGNAL(isoLevelChanged(float)),
@@ -163,8 +246,16 @@ void MainWindow::initConnections()
                 fUI.wMetaObjectsController, SLOT(setGridZDimention(int)));
     connect(fUI.wViewController, SIGNAL(gridZDimentionChanged(int)),
                 fUI.wMetaObjectsController, SLOT(setGridZDimention(int)));
-    connect(fUI.wViewController, SIGNAL(facesNormalModeChanged(bool)),
-                fUI.wMetaObjectsController, SLOT(setFacesNormalMode(bool)));
+    connect(fUI.wViewController, SIGNAL(gridFittedChanged(bool)),
+                fUI.wMetaObjectsController, SLOT(setGridFitted(bool)));
+    connect(fUI.wViewController, SIGNAL(gridKindChanged(int)),
+                fUI.wMetaObjectsController, SLOT(setGridKind(int)));
+    connect(fUI.wViewController, SIGNAL(normalModeChanged(int)),
+                fUI.wMetaObjectsController, SLOT(setNormalMode(int)));
+    connect(fUI.wViewController, SIGNAL(extractionModeChanged(int)),
+                fUI.wMetaObjectsController, SLOT(setExtractionMode(int)));
+    connect(fUI.wViewController, SIGNAL(octreeDepthChanged(int)),
+                fUI.wMetaObjectsController, SLOT(setOctreeDepth(int)));
 
     // MetaObjectsController <-> GLArea
     connect(fUI.wMetaObjectsController, SIGNAL(trianglesChanged(
@@ -178,6 +269,12 @@ void MainWindow::initConnections()
     connect(fUI.aSave, SIGNAL(triggered()), this, SLOT(saveDocument()));
     connect(fUI.aExportToOpj, SIGNAL(triggered()),
                 this, SLOT(exportSurfaceToWavefront()));
+    connect(fUI.aExportToPly, SIGNAL(triggered()),
+                this, SLOT(exportSurfaceToPly()));
+    connect(fUI.aExportToStl, SIGNAL(triggered()),
+                this, SLOT(exportSurfaceToStl()));
+
+    connect(&fAutosaveTimer, SIGNAL(timeout()), this, SLOT(autosave()));
 }
 
 void MainWindow::configurePanelsMenu()
@@ -250,6 +347,8 @@ void MainWindow::initDocumentWithXML(QBuffer *xmlData)
         //            << QString(viewXMLData);
         fUI.wViewController->initWithXML(&viewXMLBuffer);
     }
+    // journal snapshot of loaded document gets its view
+    fJournal.setViewXMLData(fUI.wViewController->XMLRepresentation());
     if (fieldXMLData.count() > 0)
     {
         //qDebug() << "Initializing MetaObjectsController with XML: "
@@ -257,3 +356,33 @@ void MainWindow::initDocumentWithXML(QBuffer *xmlData)
         fUI.wMetaObjectsController->initWithXML(&fieldXMLBuffer);
     }
 }
+
+void MainWindow::initDocumentWithFile(const DocumentFile &document)
+{
+    QByteArray viewXMLData(document.section(VIEW_SECTION));
+    QBuffer viewXMLBuffer(&viewXMLData);
+    if (viewXMLData.count() > 0)
+    {
+        fUI.wViewController->initWithXML(&viewXMLBuffer);
+    }
+    fJournal.setViewXMLData(fUI.wViewController->XMLRepresentation());
+    fUI.wMetaObjectsController->initWithDocument(document);
+}
+
+void MainWindow::exportSurface(const QString &caption, const QString &filter,
+            MeshExport::Writer write)
+{
+    QString filename = QFileDialog::getSaveFileName(this, caption, "",
+                filter);
+
+    if (!filename.isEmpty())
+    {
+        QFile file(filename);
+        if (!file.open(QIODevice::WriteOnly) ||
+                    !write(*fUI.wGLArea->trianglesPtr(), &file))
+        {
+            qWarning() << "Can not export surface to" << filename;
+        }
+        file.close();
+    }
+}
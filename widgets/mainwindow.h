@@ -21,10 +21,15 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QTimer>
+
 #include "ui_mainwindow.h"
+#include "meshexport.h"
+#include "documentjournal.h"
 
 class QBuffer;
 class QByteArray;
+class DocumentFile;
 
 // Represents th main window widget. Inits most of inter-widget connections.
 // Handles main menu.
@@ -40,15 +45,31 @@ public slots:
     void openDocument();
     void saveDocument();
     void exportSurfaceToWavefront();
+    void exportSurfaceToPly();
+    void exportSurfaceToStl();
+
+private slots:
+    // Compacts document journal into a snapshot, edits themselves are
+    // journaled at once.
+    void autosave();
 
 protected:
+    // Offers to restore document of previous session if it was not closed
+    // normally, then starts journal of current document.
+    void initJournal();
     void initConnections();
     void configurePanelsMenu();
     QByteArray documentXMLData();
     void initDocumentWithXML(QBuffer *xmlData);
+    void initDocumentWithFile(const DocumentFile &document);
+    void exportSurface(const QString &caption, const QString &filter,
+                MeshExport::Writer write);
 
 private:
     Ui::MainWindow fUI;
+
+    DocumentJournal fJournal;
+    QTimer fAutosaveTimer;
 };
 
 #endif // MAINWINDOW_H
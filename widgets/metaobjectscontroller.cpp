@@ -20,6 +20,7 @@
 \* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <math.h>
+#include <string.h>
 
 #include <QMessageBox>
 #include <QInputDialog>
@@ -38,6 +39,7 @@
 #include <QBuffer>
 #include <QIODevice>
 #include <QVariant>
+#include <QTimer>
 
 #include "metaobjectscontroller.h"
 #include "glarea.h"
@@ -45,11 +47,14 @@
 #include "grid.h"
 #include "postfixexpr.h"
 #include "metaobject.h"
+#include "documentjournal.h"
 
 // pictures
 #include "fast.xpm"
 #include "expression.xpm"
 
+const int kExactRecalculationDelay = 300; // ms after last dimention change.
+
 MetaObjectItem::MetaObjectItem(
             const QSharedPointer<MetaObject> &metaObjectPtr) : QListWidgetItem()
 {
@@ -102,11 +107,15 @@ QVariant MetaObjectItem::data(int role)
 }
 
 MetaObjectsController::MetaObjectsController(QWidget *parent) : QWidget(parent),
-            fField(kDim, kDim, kDim), fPoligonizator(&fField)
+            fField(kDim, kDim, kDim), fPoligonizator(&fField),
+            fGridFitted(false), fJournal(0)
 {
     fUI.setupUi(this);
     fUI.saVariables->setHidden(true);
 
+    fExactRecalculationTimer.setSingleShot(true);
+    fRefinementTimer.setSingleShot(true);
+
     initConnections();
 
     // TEMPORARY -->
@@ -117,20 +126,88 @@ MetaObjectsController::MetaObjectsController(QWidget *parent) : QWidget(parent),
 }
 
 void MetaObjectsController::initWithXML(QBuffer *xmlData)
+{
+    loadField(xmlData);
+}
+
+void MetaObjectsController::initWithDocument(const DocumentFile &document)
+{
+    QByteArray meshData(document.section(MESH_SECTION));
+    if (!meshData.isEmpty())
+    {
+        QSharedPointer<QVector<TriangleN> > trianglesPtr(
+                    new QVector<TriangleN>(meshData.size() /
+                    sizeof(TriangleN)));
+        memcpy(trianglesPtr->data(), meshData.constData(),
+                    trianglesPtr->count() * sizeof(TriangleN));
+        emit trianglesChanged(trianglesPtr);
+    }
+
+    fDocument = document;
+    QTimer::singleShot(0, this, SLOT(loadDocumentField()));
+}
+
+void MetaObjectsController::saveToDocument(DocumentFile *document)
+{
+    document->addSection(FIELD_SECTION, fField.XMLRepresentation(),
+                ZLIB_COMPRESSION);
+
+    // grid sections have to go in order of all meta-objects
+    QList<QSharedPointer<MetaObject> > metaObjects(fField.metaObjects());
+    int metaObjectCount = metaObjects.count();
+    bool evaluated = (fField.gridKind() == DENSE_GRID);
+    for (int i = 0; i < metaObjectCount; i++)
+    {
+        evaluated = evaluated && metaObjects[i]->evaluatedStride() == 1;
+    }
+    for (int i = 0; evaluated && i < metaObjectCount; i++)
+    {
+        document->addGridSection(metaObjects[i]->grid()->data());
+    }
+
+    QSharedPointer<const QVector<TriangleN> > trianglesPtr(
+                fPoligonizator.trianglesPtr());
+    document->addSection(MESH_SECTION, QByteArray(
+                reinterpret_cast<const char *>(trianglesPtr->constData()),
+                trianglesPtr->count() * sizeof(TriangleN)),
+                ZLIB_COMPRESSION);
+}
+
+void MetaObjectsController::loadDocumentField()
+{
+    QByteArray fieldXMLData(fDocument.section(FIELD_SECTION));
+    QBuffer fieldXMLBuffer(&fieldXMLData);
+    loadField(&fieldXMLBuffer, &fDocument);
+    // grids stay mapped without the document
+    fDocument = DocumentFile();
+}
+
+void MetaObjectsController::loadField(QBuffer *xmlData,
+            const DocumentFile *document)
 {
     const Grid *grid = fField.grid()->data();
     unsigned int xDim = grid->xDimention();
     unsigned int yDim = grid->yDimention();
     unsigned int zDim = grid->zDimention();
-    fField = Field(xDim, yDim, zDim, xmlData);
+    fResampledMetaObjects.clear();
+    // coarse field is shown at once and refined afterwards
+    fField = Field(xDim, yDim, zDim, xmlData, true, fFieldCache, document,
+                fField.gridKind());
 
     float isoLevel = fPoligonizator.isoLevel();
-    NormalMode normalMode = fPoligonizator.normalMode();
-    fPoligonizator = Poligonizator(&fField);
-    fPoligonizator.setIsoLevel(isoLevel);
-    fPoligonizator.setNormalMode(normalMode);
+    fField.setSparseBand(isoLevel);
+    // bounds document was saved with are kept, as its grids are evaluated
+    // there
+    if (fGridFitted && !fField.grid()->data()->hasExplicitBounds())
+    {
+        fField.fitGridBounds(isoLevel);
+    }
 
-    fPoligonizator.recalculateTriangles(true);
+    NormalMode normalMode = fPoligonizator.normalMode();
+    ExtractionMode extractionMode = fPoligonizator.extractionMode();
+    unsigned int octreeDepth = fPoligonizator.octreeDepth();
+    fPoligonizator = Poligonizator(&fField, isoLevel, normalMode,
+                extractionMode, octreeDepth);
     emit trianglesChanged(fPoligonizator.trianglesPtr());
 
     QList<QSharedPointer<MetaObject> > metaObjects(fField.metaObjects());
@@ -139,6 +216,22 @@ void MetaObjectsController::initWithXML(QBuffer *xmlData)
     {
         addMetaObjectItem(metaObjects[i]);
     }
+
+    if (fJournal)
+    {
+        fJournal->reset(metaObjects);
+    }
+
+    fRefinementTimer.start(0);
+}
+
+void MetaObjectsController::setJournal(DocumentJournal *journal)
+{
+    fJournal = journal;
+    if (fJournal)
+    {
+        fJournal->reset(fField.metaObjects());
+    }
 }
 
 void MetaObjectsController::initField()
@@ -221,6 +314,10 @@ void MetaObjectsController::initConnections()
                 SLOT(removeSelectedMetaObject(bool)));
     connect(fUI.lwMetaObjectsList, SIGNAL(itemSelectionChanged()), this,
                 SLOT(updateVariableControls()));
+    connect(&fExactRecalculationTimer, SIGNAL(timeout()), this,
+                SLOT(recalculateResampledMetaObject()));
+    connect(&fRefinementTimer, SIGNAL(timeout()), this,
+                SLOT(refineField()));
 }
 
 void MetaObjectsController::clearVariableControls()
@@ -241,9 +338,16 @@ void MetaObjectsController::variablesChanged(double)
     QSharedPointer<MetaObject> currentMetaObjectPtr =
                 currentItem->metaObjectPtr();
 
-    fField.updateMetaObject(currentMetaObjectPtr);
-    fPoligonizator.recalculateTriangles();
+    GridBox changedCellsBox = fField.updateMetaObject(currentMetaObjectPtr);
+    fPoligonizator.recalculateTriangles(changedCellsBox);
     emit trianglesChanged(fPoligonizator.trianglesPtr());
+
+    if (fJournal)
+    {
+        fJournal->setVariables(
+                    fField.metaObjects().indexOf(currentMetaObjectPtr),
+                    currentMetaObjectPtr.data());
+    }
 }
 
 void MetaObjectsController::updateVariableControls()
@@ -335,43 +439,161 @@ void MetaObjectsController::removeSelectedMetaObject(bool)
 
 void MetaObjectsController::setIsoLevel(float value)
 {
-    fPoligonizator.setIsoLevel(value);
-    fPoligonizator.recalculateTriangles(false, false);
+    if (fField.gridKind() == SPARSE_GRID &&
+                !fField.sparseGrid()->data()->isInBand(value))
+    {
+        fField.setSparseBand(value);
+    }
+    fPoligonizator.recalculateTrianglesForIsoLevel(value);
     emit trianglesChanged(fPoligonizator.trianglesPtr());
 }
 
 void MetaObjectsController::setGridSidesDimention(int value)
 {
-
-    fField.setGridSidesDimention(value);
-    fPoligonizator.recalculateTriangles(true);
-    emit trianglesChanged(fPoligonizator.trianglesPtr());
+    resampleGrid(value, value, value);
 }
 
 void MetaObjectsController::setGridXDimention(int value)
 {
-    fField.setGridXDimention(value);
+    const Grid *grid = fField.grid()->data();
+    resampleGrid(value, grid->yDimention(), grid->zDimention());
+}
+
+void MetaObjectsController::setGridYDimention(int value)
+{
+    const Grid *grid = fField.grid()->data();
+    resampleGrid(grid->xDimention(), value, grid->zDimention());
+}
+
+void MetaObjectsController::setGridZDimention(int value)
+{
+    const Grid *grid = fField.grid()->data();
+    resampleGrid(grid->xDimention(), grid->yDimention(), value);
+}
+
+void MetaObjectsController::setGridFitted(bool value)
+{
+    fGridFitted = value;
+    if (fGridFitted)
+    {
+        if (!fField.fitGridBounds(fPoligonizator.isoLevel()))
+        {
+            return;
+        }
+    }
+    else
+    {
+        if (!fField.grid()->data()->hasExplicitBounds())
+        {
+            return;
+        }
+        fField.resetGridBounds();
+    }
+
+    // all meta-objects are reevaluated by refinement
+    fResampledMetaObjects.clear();
     fPoligonizator.recalculateTriangles(true);
     emit trianglesChanged(fPoligonizator.trianglesPtr());
+    fRefinementTimer.start(0);
 }
 
-void MetaObjectsController::setGridYDimention(int value)
+void MetaObjectsController::setGridKind(int value)
 {
-    fField.setGridYDimention(value);
+    GridKind kind = static_cast<GridKind>(value);
+    if (fField.gridKind() == kind)
+    {
+        return;
+    }
+
+    // meta-objects are recalculated exactly in grids of new kind
+    fResampledMetaObjects.clear();
+    fField.setSparseBand(fPoligonizator.isoLevel());
+    fField.setGridKind(kind);
     fPoligonizator.recalculateTriangles(true);
     emit trianglesChanged(fPoligonizator.trianglesPtr());
 }
 
-void MetaObjectsController::setGridZDimention(int value)
+void MetaObjectsController::setFieldCacheEnabled(bool value)
 {
-    fField.setGridZDimention(value);
+    fFieldCache = FieldCache(value ? FieldCache::defaultDirectory() :
+                QString());
+    fField.setCache(fFieldCache);
+    fField.storeInCache();
+}
+
+void MetaObjectsController::resampleGrid(unsigned int xDim,
+            unsigned int yDim, unsigned int zDim)
+{
+    const Grid *grid = fField.grid()->data();
+    if (grid->xDimention() == xDim && grid->yDimention() == yDim &&
+                grid->zDimention() == zDim)
+    {
+        return;
+    }
+
+    fField.resampleGrids(xDim, yDim, zDim);
     fPoligonizator.recalculateTriangles(true);
     emit trianglesChanged(fPoligonizator.trianglesPtr());
+
+    if (fField.gridKind() == SPARSE_GRID)
+    {
+        // sparse grids are recalculated exactly by resampling
+        return;
+    }
+
+    // exact recalculation waits until dimentions stop changing (slider is
+    // released)
+    fResampledMetaObjects = fField.metaObjects();
+    fExactRecalculationTimer.start(kExactRecalculationDelay);
+}
+
+void MetaObjectsController::refineField()
+{
+    if (!fField.refine())
+    {
+        return;
+    }
+
+    // octree samples the field itself, so refined grid changes no triangles
+    if (fPoligonizator.extractionMode() != DUAL_MARCHING_CUBES)
+    {
+        fPoligonizator.recalculateTriangles();
+        emit trianglesChanged(fPoligonizator.trianglesPtr());
+    }
+
+    if (fField.refinementStride() > 1)
+    {
+        // let events in between levels
+        fRefinementTimer.start(0);
+    }
+}
+
+void MetaObjectsController::recalculateResampledMetaObject()
+{
+    if (fResampledMetaObjects.isEmpty())
+    {
+        return;
+    }
+
+    GridBox changedCellsBox =
+                fField.updateMetaObject(fResampledMetaObjects.takeFirst());
+    // field itself is not changed by resampling, which octree samples
+    if (fPoligonizator.extractionMode() != DUAL_MARCHING_CUBES)
+    {
+        fPoligonizator.recalculateTriangles(changedCellsBox);
+        emit trianglesChanged(fPoligonizator.trianglesPtr());
+    }
+
+    if (!fResampledMetaObjects.isEmpty())
+    {
+        // let events in between meta-objects
+        fExactRecalculationTimer.start(0);
+    }
 }
 
-void MetaObjectsController::setFacesNormalMode(bool value)
+void MetaObjectsController::setNormalMode(int value)
 {
-    NormalMode mode = value ? FLAT : SMOOTH;
+    NormalMode mode = static_cast<NormalMode>(value);
     if (fPoligonizator.normalMode() != mode)
     {
         fPoligonizator.setNormalMode(mode);
@@ -379,6 +601,26 @@ void MetaObjectsController::setFacesNormalMode(bool value)
     }
 }
 
+void MetaObjectsController::setExtractionMode(int value)
+{
+    ExtractionMode mode = static_cast<ExtractionMode>(value);
+    if (fPoligonizator.extractionMode() != mode)
+    {
+        fPoligonizator.setExtractionMode(mode);
+        emit trianglesChanged(fPoligonizator.trianglesPtr());
+    }
+}
+
+void MetaObjectsController::setOctreeDepth(int value)
+{
+    unsigned int depth = static_cast<unsigned int>(value);
+    if (fPoligonizator.octreeDepth() != depth)
+    {
+        fPoligonizator.setOctreeDepth(depth);
+        emit trianglesChanged(fPoligonizator.trianglesPtr());
+    }
+}
+
 void MetaObjectsController::addMetaObject(const QSharedPointer<MetaObject>
             &metaObjectPtr)
 {
@@ -387,11 +629,22 @@ void MetaObjectsController::addMetaObject(const QSharedPointer<MetaObject>
     fField.addMetaObject(metaObjectPtr);
     fPoligonizator.recalculateTriangles();
     emit trianglesChanged(fPoligonizator.trianglesPtr());
+
+    if (fJournal)
+    {
+        fJournal->addMetaObject(metaObjectPtr.data());
+    }
 }
 void MetaObjectsController::removeMetaObject(const QSharedPointer<MetaObject>
             &metaObjectPtr)
 {
+    int index = fField.metaObjects().indexOf(metaObjectPtr);
+    fResampledMetaObjects.removeOne(metaObjectPtr);
     fField.removeMetaObject(metaObjectPtr);
+    if (fJournal && index >= 0)
+    {
+        fJournal->removeMetaObject(index);
+    }
     fPoligonizator.recalculateTriangles();
     emit trianglesChanged(fPoligonizator.trianglesPtr());
     qDebug() << "MetaObjectsList count = " << fUI.lwMetaObjectsList->count();
@@ -25,13 +25,16 @@
 #include <QListWidget>
 #include <QListWidgetItem>
 #include <QSharedPointer>
+#include <QTimer>
 
 #include "ui_metaobjectscontroller.h"
 #include "field.h"
+#include "documentfile.h"
 #include "poligonizator.h"
 
 class QByteArray;
 class MetaObject;
+class DocumentJournal;
 
 class MetaObjectItem : public QListWidgetItem
 {
@@ -59,8 +62,19 @@ class MetaObjectsController : public QWidget
 public:
     MetaObjectsController(QWidget *parent = 0);
     void initWithXML(QBuffer *xmlData);
+    // Saved mesh is shown at once, field is loaded on next event loop pass
+    // taking evaluated grids of meta-objects from the document.
+    void initWithDocument(const DocumentFile &document);
+    // Adds field, grids of meta-objects (if all of them are evaluated
+    // exactly in dense grids) and mesh sections, document has to be saved
+    // before field is changed.
+    void saveToDocument(DocumentFile *document);
 
     QByteArray fieldXMLRepresentation() { return fField.XMLRepresentation(); }
+    void storeFieldInCache() { fField.storeInCache(); }
+    // Meta-object edits are journaled from now on (0 stops it), journal is
+    // reset with current field and whenever a document field is loaded.
+    void setJournal(DocumentJournal *journal);
 
     void initField();
 
@@ -74,8 +88,19 @@ public slots:
     void setGridXDimention(int value);
     void setGridYDimention(int value);
     void setGridZDimention(int value);
-
-    void setFacesNormalMode(bool value);
+    // Fitted grid is bounded by the model instead of default ranges, it is
+    // fitted when mode is turned on and when a document is loaded.
+    void setGridFitted(bool value);
+    // Meta-objects are recalculated in grids of given GridKind, sparse ones
+    // are exact near current isosurface only (band follows iso level).
+    void setGridKind(int value);
+    // Evaluated meta-objects are kept in FieldCache::defaultDirectory(), so
+    // unchanged ones are not evaluated again when a document is reopened.
+    void setFieldCacheEnabled(bool value);
+
+    void setNormalMode(int value);
+    void setExtractionMode(int value);
+    void setOctreeDepth(int value);
 
     void enterFieldExpression(bool);
     void removeSelectedMetaObject(bool);
@@ -85,18 +110,34 @@ private slots:
     void updateVariableControls();
     void addMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
     void removeMetaObject(const QSharedPointer<MetaObject> &metaObjectPtr);
+    void refineField();
+    void recalculateResampledMetaObject();
+    void loadDocumentField();
 
 protected:
+    void loadField(QBuffer *xmlData, const DocumentFile *document = 0);
     void addMetaObjectItem(const QSharedPointer<MetaObject> &metaObjectPtr);
 
     void initConnections();
     void clearVariableControls();
+    // Shows resampled field at once and schedules exact recalculation of
+    // meta-objects, which are recalculated one per event loop pass.
+    void resampleGrid(unsigned int xDim, unsigned int yDim,
+                unsigned int zDim);
 
 private:
     Ui::MetaObjectsController fUI;
 
     Field fField;
     Poligonizator fPoligonizator;
+
+    QTimer fRefinementTimer;
+    QTimer fExactRecalculationTimer;
+    QList<QSharedPointer<MetaObject> > fResampledMetaObjects;
+    bool fGridFitted;
+    FieldCache fFieldCache;
+    DocumentFile fDocument; // which field is to be loaded from.
+    DocumentJournal *fJournal;
 };
 
 #endif // METAOBJECTSCONTROLLER_H
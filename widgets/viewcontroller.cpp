@@ -29,6 +29,8 @@
 #include <QDebug>
 
 #include "viewcontroller.h"
+#include "poligonizator.h"
+#include "fieldobject.h"
 
 ViewController::ViewController(QWidget *parent) : QWidget(parent)
 {
@@ -128,6 +130,24 @@ void ViewController::initWithXML(QBuffer *xmlData)
         fUI.slGridZDim->setValue(item.toAtomicValue().toInt());
     }
 
+    query.setQuery("fn:doc($view)/view/grid/fn:data(@fit)");
+    query.evaluateTo(&resultItems);
+    item = resultItems.next();
+    if (!item.isNull())
+    {
+        fUI.chFitGrid->setCheckState((item.toAtomicValue().toBool())
+                    ? Qt::Checked : Qt::Unchecked);
+    }
+
+    query.setQuery("fn:doc($view)/view/grid/fn:data(@kind)");
+    query.evaluateTo(&resultItems);
+    item = resultItems.next();
+    if (!item.isNull())
+    {
+        fUI.chSparseGrid->setCheckState((item.toAtomicValue().toString() ==
+                    "sparse") ? Qt::Checked : Qt::Unchecked);
+    }
+
     query.setQuery("fn:doc($view)/view/display/fn:data(@axises)");
     query.evaluateTo(&resultItems);
     item = resultItems.next();
@@ -157,6 +177,41 @@ void ViewController::initWithXML(QBuffer *xmlData)
         {
             fUI.rbNormalVertexes->setChecked(true);
         }
+        else if ((item.toAtomicValue().toString()) == "gradient")
+        {
+            fUI.rbNormalGradient->setChecked(true);
+        }
+    }
+
+    query.setQuery("fn:doc($view)/view/display/fn:data(@extractionMode)");
+    query.evaluateTo(&resultItems);
+    item = resultItems.next();
+    if (!item.isNull())
+    {
+        if ((item.toAtomicValue().toString()) == "nets")
+        {
+            fUI.cbExtractionMode->setCurrentIndex(SURFACE_NETS - 1);
+        }
+        else if ((item.toAtomicValue().toString()) == "tetrahedrons")
+        {
+            fUI.cbExtractionMode->setCurrentIndex(MARCHING_TETRAHEDRONS - 1);
+        }
+        else if ((item.toAtomicValue().toString()) == "octree")
+        {
+            fUI.cbExtractionMode->setCurrentIndex(DUAL_MARCHING_CUBES - 1);
+        }
+        else
+        {
+            fUI.cbExtractionMode->setCurrentIndex(MARCHING_CUBES - 1);
+        }
+    }
+
+    query.setQuery("fn:doc($view)/view/display/fn:data(@octreeDepth)");
+    query.evaluateTo(&resultItems);
+    item = resultItems.next();
+    if (!item.isNull())
+    {
+        fUI.sbOctreeDepth->setValue(item.toAtomicValue().toInt());
     }
 
     query.setQuery("fn:doc($view)/view/colors/fn:data(@background)");
@@ -192,24 +247,33 @@ void ViewController::initWithXML(QBuffer *xmlData)
 QByteArray ViewController::XMLRepresentation()
 {
     char gridFormat[] = "<grid dimX=\"%i\" dimY=\"%i\" dimZ=\"%i\" "
-                "isoMult=\"%4.4f\" iso=\"%i\"/>";
+                "isoMult=\"%4.4f\" iso=\"%i\" fit=\"%s\" kind=\"%s\"/>";
     char cameraFormat[] = "<camera rotX=\"%i\" rotY=\"%i\" rotZ=\"%i\" "
                 "scaleMult=\"%4.4f\" scale=\"%i\"/>";
     char displayFormat[] = "<display axises=\"%s\" "
-                "polygonMode=\"%s\" normalMode=\"%s\"/>";
+                "polygonMode=\"%s\" normalMode=\"%s\" "
+                "extractionMode=\"%s\" octreeDepth=\"%i\"/>";
     char colorsFormat[] = "<colors background=\"%s\" "
                 "light1=\"%s\" light2=\"%s\"/>";
 
     QString gridXMLData(QString().sprintf(gridFormat, fUI.slGridXDim->value(),
                 fUI.slGridYDim->value(), fUI.slGridZDim->value(),
-                fUI.sbIsoLevelMult->value(), fUI.slIsoLevel->value()));
+                fUI.sbIsoLevelMult->value(), fUI.slIsoLevel->value(),
+                (fUI.chFitGrid->isChecked()) ? "true" : "false",
+                (fUI.chSparseGrid->isChecked()) ? "sparse" : "dense"));
     QString cameraXMLData(QString().sprintf(cameraFormat, fUI.slRotX->value(),
                 fUI.slRotY->value(), fUI.slRotZ->value(),
                 fUI.sbScaleMult->value(), fUI.slScale->value()));
+    const char *extractionModes[] = { "cubes", "nets", "tetrahedrons",
+                "octree" };
+    const char *extractionMode =
+                extractionModes[fUI.cbExtractionMode->currentIndex()];
     QString displayXMLData(QString().sprintf(displayFormat,
                 (fUI.chAxisesShow->isChecked()) ? "true" : "false",
                 (fUI.rbFaces->isChecked()) ? "faces" : "edges",
-                (fUI.rbNormalFaces->isChecked()) ? "flat" : "smooth"));
+                (fUI.rbNormalFaces->isChecked()) ? "flat" :
+                (fUI.rbNormalVertexes->isChecked()) ? "smooth" : "gradient",
+                extractionMode, fUI.sbOctreeDepth->value()));
     QString colorsXMLData(QString().sprintf(colorsFormat,
                 fGLAreaBackgroundColor.name().toAscii().data(),
                 fGLAreaLight1Color.name().toAscii().data(),
@@ -232,6 +296,7 @@ void ViewController::groupRadioButtons()
 
     fNormalModeGroup.addButton(fUI.rbNormalFaces);
     fNormalModeGroup.addButton(fUI.rbNormalVertexes);
+    fNormalModeGroup.addButton(fUI.rbNormalGradient);
 }
 
 void ViewController::initConnections()
@@ -290,6 +355,10 @@ void ViewController::initConnections()
     initStandaloneGridDimentionConnections();
     connect(fUI.chSyncGridDim, SIGNAL(stateChanged(int)),
                 this, SLOT(changeGridDimentionsSynchronized(int)));
+    connect(fUI.chFitGrid, SIGNAL(stateChanged(int)),
+                this, SLOT(changeGridFitted(int)));
+    connect(fUI.chSparseGrid, SIGNAL(stateChanged(int)),
+                this, SLOT(changeGridKind(int)));
 
     // Axises & Edges/Faces
     connect(fUI.chAxisesShow, SIGNAL(stateChanged(int)),
@@ -299,7 +368,17 @@ void ViewController::initConnections()
 
     // Normal mode
     connect(fUI.rbNormalFaces, SIGNAL(toggled(bool)),
-                this, SLOT(changeFacesNormalMode(bool)));
+                this, SLOT(changeNormalMode(bool)));
+    connect(fUI.rbNormalVertexes, SIGNAL(toggled(bool)),
+                this, SLOT(changeNormalMode(bool)));
+    connect(fUI.rbNormalGradient, SIGNAL(toggled(bool)),
+                this, SLOT(changeNormalMode(bool)));
+
+    // Extraction mode
+    connect(fUI.cbExtractionMode, SIGNAL(currentIndexChanged(int)),
+                this, SLOT(changeExtractionMode(int)));
+    connect(fUI.sbOctreeDepth, SIGNAL(valueChanged(int)),
+                this, SLOT(changeOctreeDepth(int)));
 
     // Shine button
     connect(fUI.bShine, SIGNAL(clicked()), this, SIGNAL(shineButtonPressed()));
@@ -455,6 +534,19 @@ void ViewController::changeDrawFaces(bool value)
     emit drawFacesChanged(value);
 }
 
+void ViewController::changeGridFitted(int value)
+{
+    qDebug() << QString().sprintf("New GridFitted value = %i", value);
+    emit gridFittedChanged((bool)value);
+}
+
+void ViewController::changeGridKind(int value)
+{
+    GridKind kind = (Qt::Checked == value) ? SPARSE_GRID : DENSE_GRID;
+    qDebug() << QString().sprintf("New GridKind value = %i", kind);
+    emit gridKindChanged(kind);
+}
+
 void ViewController::changeGridDimentionsSynchronized(int value)
 {
     qDebug() << QString().sprintf("New GridDimentionsSynchronized value = %i",
@@ -470,8 +562,38 @@ void ViewController::changeGridDimentionsSynchronized(int value)
     }
 }
 
-void ViewController::changeFacesNormalMode(bool value)
+void ViewController::changeNormalMode(bool value)
+{
+    // unchecked button of the group is of no interest
+    if (!value)
+    {
+        return;
+    }
+
+    NormalMode mode = GRADIENT;
+    if (fUI.rbNormalFaces->isChecked())
+    {
+        mode = FLAT;
+    }
+    else if (fUI.rbNormalVertexes->isChecked())
+    {
+        mode = SMOOTH;
+    }
+
+    qDebug() << QString().sprintf("New NormalMode value = %i", mode);
+    emit normalModeChanged(mode);
+}
+
+void ViewController::changeExtractionMode(int value)
+{
+    // combo box items are listed in ExtractionMode order
+    ExtractionMode mode = static_cast<ExtractionMode>(value + 1);
+    qDebug() << QString().sprintf("New ExtractionMode value = %i", mode);
+    emit extractionModeChanged(mode);
+}
+
+void ViewController::changeOctreeDepth(int value)
 {
-    qDebug() << QString().sprintf("New NormalFacesMode value = %i", value);
-    emit facesNormalModeChanged(value);
+    qDebug() << QString().sprintf("New octree depth value = %i", value);
+    emit octreeDepthChanged(value);
 }
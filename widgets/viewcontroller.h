@@ -65,7 +65,11 @@ signals:
     void gridXDimentionChanged(int);
     void gridYDimentionChanged(int);
     void gridZDimentionChanged(int);
-    void facesNormalModeChanged(bool);
+    void gridFittedChanged(bool);
+    void gridKindChanged(int);
+    void normalModeChanged(int);
+    void extractionModeChanged(int);
+    void octreeDepthChanged(int);
     void shineButtonPressed();
     void GLAreaBackgroundColorChanged(QColor);
     void GLAreaLigth1ColorChanged(QColor);
@@ -95,7 +99,11 @@ private slots:
     void changeDrawAxises(int value);
     void changeDrawFaces(bool value);
     void changeGridDimentionsSynchronized(int value);
-    void changeFacesNormalMode(bool value);
+    void changeGridFitted(int value);
+    void changeGridKind(int value);
+    void changeNormalMode(bool value);
+    void changeExtractionMode(int value);
+    void changeOctreeDepth(int value);
 
 private:
     Ui::ViewController fUI;